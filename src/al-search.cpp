@@ -13,14 +13,15 @@
 #include <unordered_set>
 #include <vector>
 
+#include "archive.h"
+#include "byml.h"
 #include "clipp/clipp.h"
 #include "config.h"
 #include "mini/ini.h"
-#include "mizuna/byml/reader.h"
 #include "mizuna/results.h"
-#include "mizuna/sarc/reader.h"
 #include "mizuna/util.h"
-#include "mizuna/yaz0.h"
+#include "stage.h"
+#include "vfs.h"
 
 namespace fs = std::filesystem;
 
@@ -37,9 +38,9 @@ struct Query {
 
 struct Value {
 	byml::NodeType type;
+	std::string val_string;
 
 	union {
-		std::string_view val_string;
 		bool val_bool;
 		u32 val_u32;
 		s32 val_s32;
@@ -51,7 +52,7 @@ struct Value {
 
 	Value() { setNull(); }
 
-	void setString(const std::string& val) {
+	void setString(std::string_view val) {
 		type = byml::NodeType::String;
 		val_string = val;
 	}
@@ -96,58 +97,18 @@ struct Value {
 		val_u32 = 0;
 	}
 
-	hk::Result setByKey(const byml::Reader& container, const std::string& key) {
-		byml::NodeType queryType = HK_TRY(container.getTypeByKey(key));
+	hk::Result setByKey(const byml::FlatDocument& document, u32 container, const std::string& key) {
+		const u32 node = HK_TRY(document.getEntryByKey(container, key));
 
-		switch (queryType) {
-		case byml::NodeType::String: {
-			std::string valString;
-			HK_TRY(container.getStringByKey(&valString, key));
-			setString(valString);
-			break;
-		}
-		case byml::NodeType::Bool: {
-			bool valBool;
-			HK_TRY(container.getBoolByKey(&valBool, key));
-			setBool(valBool);
-			break;
-		}
-		case byml::NodeType::U32: {
-			u32 valU32;
-			HK_TRY(container.getU32ByKey(&valU32, key));
-			setU32(valU32);
-			break;
-		}
-		case byml::NodeType::S32: {
-			s32 valS32;
-			HK_TRY(container.getS32ByKey(&valS32, key));
-			setS32(valS32);
-			break;
-		}
-		case byml::NodeType::F32: {
-			f32 valF32;
-			HK_TRY(container.getF32ByKey(&valF32, key));
-			setF32(valF32);
-			break;
-		}
-		case byml::NodeType::U64: {
-			u64 valU64;
-			HK_TRY(container.getU64ByKey(&valU64, key));
-			setU64(valU64);
-			break;
-		}
-		case byml::NodeType::S64: {
-			s64 valS64;
-			HK_TRY(container.getS64ByKey(&valS64, key));
-			setS64(valS64);
-			break;
-		}
-		case byml::NodeType::F64: {
-			f64 valF64;
-			HK_TRY(container.getF64ByKey(&valF64, key));
-			setF64(valF64);
-			break;
-		}
+		switch (document.getType(node)) {
+		case byml::NodeType::String: setString(HK_TRY(document.getString(node))); break;
+		case byml::NodeType::Bool: setBool(HK_TRY(document.getBool(node))); break;
+		case byml::NodeType::U32: setU32(HK_TRY(document.getU32(node))); break;
+		case byml::NodeType::S32: setS32(HK_TRY(document.getS32(node))); break;
+		case byml::NodeType::F32: setF32(HK_TRY(document.getF32(node))); break;
+		case byml::NodeType::U64: setU64(HK_TRY(document.getU64(node))); break;
+		case byml::NodeType::S64: setS64(HK_TRY(document.getS64(node))); break;
+		case byml::NodeType::F64: setF64(HK_TRY(document.getF64(node))); break;
 
 		case byml::NodeType::Array:
 		case byml::NodeType::Hash:
@@ -236,10 +197,10 @@ struct SearchEngine {
 		mGame(game), mQuery(query), mIsVerbose(isVerbose) {}
 
 	hk::Result searchAllStages(const fs::path& romfsPath);
-	hk::Result searchBYML(const std::vector<u8> bymlContents);
-	hk::Result searchStage(const fs::path& stagePath);
-	hk::Result searchScenario(const byml::Reader& scenario);
-	hk::Result searchItem(const byml::Reader& item, std::string_view baseName = "", u32 level = 0);
+	hk::Result searchBYML(std::span<const u8> bymlContents);
+	hk::Result searchStage(vfs::FileSystem& romfs, const std::string& stageFilename);
+	hk::Result searchScenario(u32 scenario);
+	hk::Result searchItem(u32 item, std::string_view baseName = "", u32 level = 0);
 	hk::Result saveResults(const fs::path& outPath) const;
 
 	const Game mGame;
@@ -249,47 +210,34 @@ struct SearchEngine {
 	u32 mCurScenarioIdx;
 	std::string mCurItemList;
 	bool mIsVerbose;
-};
-
-hk::Result readVec3f(hk::util::Vector3f* out, const byml::Reader& reader, const std::string& name) {
-	byml::Reader vec;
-	HK_TRY(reader.getContainerByKey(&vec, name));
 
-	HK_TRY(vec.getF32ByKey(&out->x, "X"));
-	HK_TRY(vec.getF32ByKey(&out->y, "Y"));
-	HK_TRY(vec.getF32ByKey(&out->z, "Z"));
+	// the BYML being searched. it's decoded once and then walked by index, and its memory is reused for every file
+	byml::FlatDocument mDocument;
+	stage::KeyIds mKeys;
+};
 
-	return hk::ResultSuccess();
-}
+hk::Result SearchEngine::searchItem(u32 item, std::string_view baseName, u32 level) {
+	stage::StageObjectView object;
+	HK_TRY(object.bind(mDocument, mKeys, item));
 
-hk::Result SearchEngine::searchItem(const byml::Reader& item, std::string_view baseName, u32 level) {
-	std::string unitConfigName;
-	HK_TRY(item.getStringByKey(&unitConfigName, "UnitConfigName"));
+	const std::string_view unitConfigName = HK_TRY(object.getUnitConfigName());
 
 	if (level == 0) baseName = unitConfigName;
 
-	byml::Reader unitConfig;
-	HK_TRY(item.getContainerByKey(&unitConfig, "UnitConfig"));
-
-	std::string paramConfigName;
-	HK_TRY(unitConfig.getStringByKey(&paramConfigName, "ParameterConfigName"));
+	const std::string_view paramConfigName = HK_TRY(object.getParameterConfigName());
 
-	std::string modelName;
-	bool hasModelName = item.tryGetStringByKey(&modelName, "ModelName");
+	std::string_view modelName;
+	const bool hasModelName = object.hasModelName();
+	if (hasModelName) modelName = HK_TRY(object.getModelName());
 
-	if (util::isEqual(unitConfigName, mQuery.name) || util::isEqual(paramConfigName, mQuery.name) ||
-	    (hasModelName && util::isEqual(modelName, mQuery.name))) {
-		hk::util::Vector3f trans;
-		HK_TRY(readVec3f(&trans, item, "Translate"));
-		hk::util::Vector3f rotate;
-		HK_TRY(readVec3f(&rotate, item, "Rotate"));
-		hk::util::Vector3f scale;
-		HK_TRY(readVec3f(&scale, item, "Scale"));
+	if (HK_TRY(object.matchesName(mQuery.name))) {
+		const hk::util::Vector3f trans = HK_TRY(object.getTranslate());
+		const hk::util::Vector3f rotate = HK_TRY(object.getRotate());
+		const hk::util::Vector3f scale = HK_TRY(object.getScale());
 
-		std::string objId;
-		HK_TRY(item.getStringByKey(&objId, "Id"));
+		const std::string_view objId = HK_TRY(object.getId());
 
-		std::string optModelName = hasModelName ? modelName : "";
+		std::string optModelName = hasModelName ? std::string(modelName) : "";
 		std::array<bool, 15> scenarioFlag = { false };
 
 		if (mGame == Game::SMO) scenarioFlag[mCurScenarioIdx] = true;
@@ -297,17 +245,17 @@ hk::Result SearchEngine::searchItem(const byml::Reader& item, std::string_view b
 		if (level == 0) baseName = "";
 
 		Value queryValue;
-		if (!mQuery.keyQueryName.empty()) HK_TRY(queryValue.setByKey(item, mQuery.keyQueryName));
+		if (!mQuery.keyQueryName.empty()) HK_TRY(queryValue.setByKey(mDocument, item, mQuery.keyQueryName));
 
 		Result result = { .stageName = mCurStageName,
 			              .scenarioFlag = scenarioFlag,
 			              .scenarioIdx = mCurScenarioIdx,
 			              .itemList = mCurItemList,
-			              .baseName = baseName.data(),
-			              .unitConfigName = unitConfigName,
+			              .baseName = std::string(baseName),
+			              .unitConfigName = std::string(unitConfigName),
 			              .modelName = optModelName,
-			              .paramConfigName = paramConfigName,
-			              .objId = objId,
+			              .paramConfigName = std::string(paramConfigName),
+			              .objId = std::string(objId),
 			              .trans = trans,
 			              .rotate = rotate,
 			              .scale = scale,
@@ -318,111 +266,82 @@ hk::Result SearchEngine::searchItem(const byml::Reader& item, std::string_view b
 	}
 
 	if (mQuery.isRecurse) {
-		byml::Reader linkGroups;
-		HK_TRY(item.getContainerByKey(&linkGroups, "Links"));
+		const u32 linkGroups = HK_TRY(object.getLinks());
 
-		for (u32 groupIdx = 0; groupIdx < linkGroups.getSize(); groupIdx++) {
-			byml::Reader group;
-			HK_TRY(linkGroups.getContainerByIdx(&group, groupIdx));
+		for (u32 groupIdx = 0; groupIdx < mDocument.getSize(linkGroups); groupIdx++) {
+			const u32 group = mDocument.getEntry(linkGroups, groupIdx);
 
-			for (u32 linkIdx = 0; linkIdx < group.getSize(); linkIdx++) {
-				byml::Reader item;
-				HK_TRY(group.getContainerByIdx(&item, linkIdx));
-
-				HK_TRY(searchItem(item, baseName, level + 1));
-			}
+			for (u32 linkIdx = 0; linkIdx < mDocument.getSize(group); linkIdx++)
+				HK_TRY(searchItem(mDocument.getEntry(group, linkIdx), baseName, level + 1));
 		}
 	}
 
 	return hk::ResultSuccess();
 }
 
-hk::Result SearchEngine::searchScenario(const byml::Reader& scenario) {
-	for (u32 listIdx = 0; listIdx < scenario.getSize(); listIdx++) {
-		std::string listName;
-		HK_TRY(scenario.getKeyByIdx(&listName, listIdx));
-		mCurItemList = listName;
-
-		if (util::isEqual(listName, "FilePath") || util::isEqual(listName, "Objs")) continue;
+hk::Result SearchEngine::searchScenario(u32 scenario) {
+	if (mDocument.getType(scenario) != byml::NodeType::Hash) return hk::ResultSuccess();
 
-		byml::Reader itemList;
-		HK_TRY(scenario.getContainerByIdx(&itemList, listIdx));
+	for (u32 listIdx = 0; listIdx < mDocument.getSize(scenario); listIdx++) {
+		const std::string_view listName = mDocument.getKey(mDocument.getEntryKey(scenario, listIdx));
+		mCurItemList = listName;
 
-		for (u32 itemIdx = 0; itemIdx < itemList.getSize(); itemIdx++) {
-			byml::Reader item;
-			HK_TRY(itemList.getContainerByIdx(&item, itemIdx));
+		if (listName == "FilePath" || listName == "Objs") continue;
 
-			HK_TRY(searchItem(item));
-		}
+		const u32 itemList = mDocument.getEntry(scenario, listIdx);
+		for (u32 itemIdx = 0; itemIdx < mDocument.getSize(itemList); itemIdx++)
+			HK_TRY(searchItem(mDocument.getEntry(itemList, itemIdx)));
 	}
 
 	return hk::ResultSuccess();
 }
 
-hk::Result SearchEngine::searchBYML(const std::vector<u8> bymlContents) {
-	byml::Reader reader;
-	HK_TRY(reader.init(bymlContents.data(), bymlContents.size()));
+hk::Result SearchEngine::searchBYML(std::span<const u8> bymlContents) {
+	byml::Document document;
+	HK_TRY(document.init(bymlContents));
 
-	if (!reader.isExistStringValue(mQuery.name)) return hk::ResultSuccess();
+	// most stages don't mention the object at all, and those aren't decoded
+	if (HK_TRY(document.findString(mQuery.name)) < 0) return hk::ResultSuccess();
 
 	if (mIsVerbose) {
 		printf("%s - found string\n", mCurStageName.c_str());
 	}
 
+	HK_TRY(mDocument.init(document));
+	mKeys.init(mDocument);
+	const u32 root = byml::FlatDocument::cRoot;
+
 	if (mGame == Game::SMO) {
-		for (u32 scenarioIdx = 0; scenarioIdx < reader.getSize(); scenarioIdx++) {
+		for (u32 scenarioIdx = 0; scenarioIdx < mDocument.getSize(root); scenarioIdx++) {
 			mCurScenarioIdx = scenarioIdx;
-
-			byml::Reader scenario;
-			HK_TRY(reader.getContainerByIdx(&scenario, scenarioIdx));
-
-			HK_TRY(searchScenario(scenario));
+			HK_TRY(searchScenario(mDocument.getEntry(root, scenarioIdx)));
 		}
 	} else if (mGame == Game::SM3DW) {
-		HK_TRY(searchScenario(reader));
+		HK_TRY(searchScenario(root));
 	}
 
 	return hk::ResultSuccess();
 }
 
-hk::Result SearchEngine::searchStage(const fs::path& stagePath) {
-	std::string stageName = stagePath.filename().stem().string();
+hk::Result SearchEngine::searchStage(vfs::FileSystem& romfs, const std::string& stageFilename) {
+	std::string stageName = archive::getStem(stageFilename);
+	const std::string stagePath = "StageData/" + stageFilename;
 
 	if (mGame == Game::SMO) {
-		std::vector<u8> szsContents;
-		HK_TRY(util::readFile(szsContents, stagePath));
-
-		std::vector<u8> sarcContents;
-		HK_TRY(yaz0::decompress(sarcContents, szsContents));
+		vfs::FileHandle byml;
+		HK_TRY(romfs.open(byml, stagePath + "/" + stageName + ".byml"));
 
-		sarc::Reader sarc(sarcContents);
-		HK_TRY(sarc.init());
-
-		std::vector<u8> bymlContents;
-		HK_TRY(sarc.getFileData(bymlContents, stageName + ".byml"));
-
-		HK_TRY(searchBYML(bymlContents));
+		HK_TRY(searchBYML(byml.getData()));
 	} else if (mGame == Game::SM3DW) {
-		std::vector<u8> szsContents;
-		HK_TRY(util::readFile(szsContents, stagePath));
-
-		std::vector<u8> sarcContents;
-		HK_TRY(yaz0::decompress(sarcContents, szsContents));
-
-		sarc::Reader sarc(sarcContents);
-		HK_TRY(sarc.init());
-
 		const std::array<std::string, 3> suffixes = { "Map", "Design", "Sound" };
-		const auto& filenames = sarc.getFilenames();
 
 		for (const auto& suffix : suffixes) {
-			const std::string bymlName = stageName + suffix + ".byml";
-			if (!filenames.contains(bymlName)) continue;
-
-			std::vector<u8> bymlContents;
-			HK_TRY(sarc.getFileData(bymlContents, bymlName));
+			const std::string bymlPath = stagePath + "/" + stageName + suffix + ".byml";
+			if (!HK_TRY(romfs.exists(bymlPath))) continue;
 
-			HK_TRY(searchBYML(bymlContents));
+			vfs::FileHandle byml;
+			HK_TRY(romfs.open(byml, bymlPath));
+			HK_TRY(searchBYML(byml.getData()));
 		}
 	}
 
@@ -435,16 +354,19 @@ hk::Result SearchEngine::searchAllStages(const fs::path& romfsPath) {
 
 	printf("searching...\n");
 
+	// each stage archive is decoded once, however many files are read from it
+	vfs::FileSystem romfs(romfsPath);
+
 	// sort stage paths
 	std::set<fs::path> stagePaths;
 	for (const auto& entry : fs::directory_iterator(stageDataPath))
 		stagePaths.insert(entry.path());
 
 	for (const auto& stagePath : stagePaths) {
-		std::string stageName = stagePath.filename().stem().string();
+		std::string stageName = archive::getStem(stagePath);
 		mCurStageName = stageName;
 
-		HK_TRY(searchStage(stagePath));
+		HK_TRY(searchStage(romfs, stagePath.filename().string()));
 	}
 
 	return hk::ResultSuccess();
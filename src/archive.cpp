@@ -0,0 +1,232 @@
+#include "archive.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+#include "binary.h"
+#include "mizuna/results.h"
+#include "mizuna/util.h"
+#include "results.h"
+#include "sarc.h"
+#include "stream.h"
+#include "yaz0.h"
+
+namespace archive {
+
+namespace {
+
+// enough for every magic below
+constexpr size_t cSniffSize = 4;
+
+constexpr u32 cZstdSkippableMagic = 0x184d2a50;
+constexpr u32 cZstdSkippableMask = 0xfffffff0;
+
+// a zstd frame inside a Yaz0 stream inside a zstd frame is already absurd; anything deeper is a corrupt file
+constexpr size_t cMaxLayers = 4;
+
+constexpr std::array cStemExtensions = { ".zs", ".szs", ".yaz0", ".sarc" };
+
+bool hasMagic(std::span<const u8> data, std::string_view magic) {
+	return data.size() >= magic.size() && std::memcmp(data.data(), magic.data(), magic.size()) == 0;
+}
+
+} // namespace
+
+const char* getFormatName(Format format) {
+	switch (format) {
+	case Format::Yaz0: return "Yaz0";
+	case Format::Zstd: return "zstd";
+	case Format::Sarc: return "SARC";
+	case Format::Byml: return "BYML";
+	case Format::Bntx: return "BNTX";
+	case Format::Bfres: return "BFRES";
+	case Format::Bffnt: return "BFFNT";
+	default: return "unknown";
+	}
+}
+
+Format detectFormat(std::span<const u8> data) {
+	if (hasMagic(data, "Yaz0")) return Format::Yaz0;
+	if (hasMagic(data, "SARC")) return Format::Sarc;
+	if (hasMagic(data, "BNTX")) return Format::Bntx;
+	if (hasMagic(data, "FRES")) return Format::Bfres;
+	if (hasMagic(data, "FFNT")) return Format::Bffnt;
+	// big- and little-endian respectively
+	if (hasMagic(data, "BY") || hasMagic(data, "YB")) return Format::Byml;
+
+	if (data.size() >= 4) {
+		u32 magic = bin::readLE<u32>(data.data());
+		if (magic == ZSTD_MAGICNUMBER || (magic & cZstdSkippableMask) == cZstdSkippableMagic) return Format::Zstd;
+	}
+
+	return Format::Unknown;
+}
+
+hk::ValueOrResult<Format> detectFileFormat(const std::filesystem::path& path) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file) return ResultFileError();
+
+	std::array<u8, cSniffSize> magic = {};
+	file.read(reinterpret_cast<char*>(magic.data()), magic.size());
+
+	return detectFormat(std::span(magic).first(file.gcount()));
+}
+
+std::string getStem(const std::filesystem::path& path) {
+	std::filesystem::path stem = path.filename();
+	while (std::find(cStemExtensions.begin(), cStemExtensions.end(), stem.extension()) != cStemExtensions.end())
+		stem = stem.stem();
+
+	return stem.string();
+}
+
+hk::Result File::open(const std::filesystem::path& path, const zs::DictionarySet* dictionaries) {
+	mLayers.clear();
+
+	// the outer layer is decoded straight from the file
+	Format format = HK_TRY(detectFileFormat(path));
+	u32 alignment = 0;
+	if (format == Format::Yaz0)
+		HK_TRY(yaz0::decompressFileInPlace(mBuffer, path, &alignment));
+	else if (format == Format::Zstd)
+		HK_TRY(zs::decompressFile(mBuffer, path, dictionaries));
+	else
+		HK_TRY(util::readFile(mBuffer, path));
+
+	if (isCompression(format)) mLayers.push_back({ format, alignment });
+
+	return unwrap(dictionaries);
+}
+
+hk::Result File::open(std::vector<u8>&& data, const zs::DictionarySet* dictionaries) {
+	mLayers.clear();
+	mBuffer = std::move(data);
+
+	return unwrap(dictionaries);
+}
+
+hk::Result File::openAs(const std::filesystem::path& path, Format format, const zs::DictionarySet* dictionaries) {
+	HK_TRY(open(path, dictionaries));
+	if (mFormat != format) return utils::ResultUnexpectedFormat();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result File::unwrap(const zs::DictionarySet* dictionaries) {
+	mFormat = detectFormat(mBuffer);
+
+	while (isCompression(mFormat)) {
+		if (mLayers.size() >= cMaxLayers) return utils::ResultUnexpectedFormat();
+
+		std::vector<u8> decoded;
+		u32 alignment = 0;
+		if (mFormat == Format::Yaz0) {
+			HK_TRY(yaz0::decompressFast(decoded, mBuffer));
+			alignment = HK_TRY(yaz0::readAlignment(mBuffer));
+		} else {
+			HK_TRY(zs::decompress(decoded, mBuffer, dictionaries));
+		}
+
+		mLayers.push_back({ mFormat, alignment });
+		mBuffer = std::move(decoded);
+		mFormat = detectFormat(mBuffer);
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result readSarcMetadata(
+	std::vector<u8>& out, const std::filesystem::path& path, const zs::DictionarySet* dictionaries
+) {
+	Format format = HK_TRY(detectFileFormat(path));
+
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file) return ResultFileError();
+
+	if (format == Format::Sarc) {
+		out.resize(sarc::cArchiveHeaderSize);
+		if (!file.read(reinterpret_cast<char*>(out.data()), out.size())) return utils::ResultSarcInvalidHeader();
+
+		const u32 dataOffset = HK_TRY(sarc::EntryTable::readDataOffset(out));
+		if (dataOffset < sarc::cArchiveHeaderSize) return utils::ResultSarcInvalidHeader();
+		const size_t tableSize = dataOffset - sarc::cArchiveHeaderSize;
+		out.resize(dataOffset);
+		file.read(reinterpret_cast<char*>(out.data() + sarc::cArchiveHeaderSize), tableSize);
+		if (size_t(file.gcount()) != tableSize) return utils::ResultSarcInvalidHeader();
+
+		return hk::ResultSuccess();
+	}
+
+	if (isCompression(format)) {
+		out.clear();
+		size_t needed = sarc::cArchiveHeaderSize;
+		bool isStopped = false;
+		bool isSarc = true;
+
+		const Sink sink = [&](std::span<const u8> chunk) -> hk::Result {
+			const bool hadHeader = out.size() >= sarc::cArchiveHeaderSize;
+			out.insert(out.end(), chunk.begin(), chunk.end());
+
+			if (!hadHeader && out.size() >= sarc::cArchiveHeaderSize) {
+				isSarc = detectFormat(out) == Format::Sarc;
+				if (isSarc) needed = HK_TRY(sarc::EntryTable::readDataOffset(out));
+			}
+			if (isSarc && out.size() < needed) return hk::ResultSuccess();
+
+			// failing stops the decoder, since nothing past here is needed
+			isStopped = true;
+			return utils::ResultInvalidArgument();
+		};
+
+		hk::Result result = format == Format::Yaz0 ? yaz0::decompressStream(file, sink)
+		                                           : zs::decompressStream(file, sink, dictionaries);
+		if (!isStopped) {
+			HK_TRY(result);
+			return utils::ResultSarcInvalidHeader();
+		}
+
+		if (isSarc) {
+			out.resize(needed);
+			return hk::ResultSuccess();
+		}
+	}
+
+	// something more deeply nested, which is rare enough to just decode in full
+	File archive;
+	HK_TRY(archive.openAs(path, Format::Sarc, dictionaries));
+
+	const u32 dataOffset = HK_TRY(sarc::EntryTable::readDataOffset(archive.getData()));
+	if (dataOffset > archive.getData().size()) return utils::ResultSarcInvalidHeader();
+	out.assign(archive.getData().begin(), archive.getData().begin() + dataOffset);
+
+	return hk::ResultSuccess();
+}
+
+hk::Result compressLayers(
+	std::vector<u8>& data, std::span<const Layer> layers, const std::string& filename, zs::DictionarySet* dictionaries
+) {
+	for (auto layer = layers.rbegin(); layer != layers.rend(); layer++) {
+		std::vector<u8> compressed;
+		if (layer->format == Format::Yaz0) {
+			yaz0::Encoder encoder(makeVectorSink(compressed), data.size(), layer->alignment);
+			HK_TRY(encoder.write(data));
+			HK_TRY(encoder.finish());
+		} else if (layer->format == Format::Zstd) {
+			const zs::CompressOptions options = {
+				.pledgedSize = data.size(),
+				.dictionary = dictionaries ? dictionaries->findCDict(filename, zs::cDefaultLevel) : nullptr,
+			};
+			HK_TRY(zs::compress(data, makeVectorSink(compressed), options));
+		} else {
+			return utils::ResultInvalidArgument();
+		}
+		data = std::move(compressed);
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace archive
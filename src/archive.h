@@ -0,0 +1,93 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "zs.h"
+
+namespace archive {
+
+enum class Format {
+	Unknown,
+	Yaz0,
+	Zstd,
+	Sarc,
+	Byml,
+	Bntx,
+	Bfres,
+	Bffnt,
+};
+
+const char* getFormatName(Format format);
+
+// identifies `data` by its magic bytes. only the first few bytes are looked at
+Format detectFormat(std::span<const u8> data);
+
+// the same for the start of the file at `path`, without reading the rest of it
+hk::ValueOrResult<Format> detectFileFormat(const std::filesystem::path& path);
+
+inline bool isCompression(Format format) {
+	return format == Format::Yaz0 || format == Format::Zstd;
+}
+
+// strips compression and container extensions, e.g. `FooStageMap.szs` and `FooStageMap.sarc.zs` both become
+// `FooStageMap`
+std::string getStem(const std::filesystem::path& path);
+
+// a layer of compression, with what it takes to compress data the same way again
+struct Layer {
+	Format format;
+	u32 alignment = 0; // for Yaz0, the one in its header, which SZS archives use for the alignment of their files
+};
+
+// a file with every layer of compression peeled off, however many there were
+class File {
+public:
+	// reads `path` and decodes whatever compression it has. an outer Yaz0 layer is decoded in place and zstd is
+	// streamed straight from the file, so the compressed data is never held next to the decoded data
+	hk::Result open(const std::filesystem::path& path, const zs::DictionarySet* dictionaries = nullptr);
+
+	// the same for data that is already in memory, e.g. a file pulled out of another archive
+	hk::Result open(std::vector<u8>&& data, const zs::DictionarySet* dictionaries = nullptr);
+
+	// opens `path` and checks that it decodes to `format`
+	hk::Result openAs(
+		const std::filesystem::path& path, Format format, const zs::DictionarySet* dictionaries = nullptr
+	);
+
+	std::span<const u8> getData() const { return mBuffer; }
+
+	// for mizuna readers, which take the whole buffer. the file owns it, so no copy is made
+	const std::vector<u8>& getBuffer() const { return mBuffer; }
+
+	// the format of the decoded data
+	Format getFormat() const { return mFormat; }
+
+	// the compression layers that were removed, outermost first
+	const std::vector<Layer>& getLayers() const { return mLayers; }
+
+private:
+	hk::Result unwrap(const zs::DictionarySet* dictionaries);
+
+	std::vector<u8> mBuffer;
+	Format mFormat = Format::Unknown;
+	std::vector<Layer> mLayers;
+};
+
+// reads only the header, SFAT and SFNT of the SARC at `path`, whatever compression it is under. an uncompressed archive
+// is read no further than its data offset, and Yaz0 or zstd decoding is stopped once the name table is complete
+hk::Result readSarcMetadata(
+	std::vector<u8>& out, const std::filesystem::path& path, const zs::DictionarySet* dictionaries = nullptr
+);
+
+// compresses `data` with `layers` (outermost first, as `File::getLayers` lists them), e.g. to write a file back the way
+// it was stored after editing it. zstd layers use the dictionary picked for `filename`
+hk::Result compressLayers(
+	std::vector<u8>& data, std::span<const Layer> layers, const std::string& filename,
+	zs::DictionarySet* dictionaries = nullptr
+);
+
+} // namespace archive
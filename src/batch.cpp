@@ -0,0 +1,141 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace {
+
+bool isWildcard(std::string_view str) {
+	return str.find_first_of("*?") != std::string_view::npos;
+}
+
+bool isMatchingType(const fs::directory_entry& entry, bool isDirectoryInput) {
+	std::error_code ec;
+	return isDirectoryInput ? entry.is_directory(ec) : entry.is_regular_file(ec);
+}
+
+void collectDirectory(
+	std::vector<BatchInput>& out, const fs::path& dir, bool isDirectoryInput, std::string_view extension
+) {
+	if (isDirectoryInput) {
+		for (const auto& entry : fs::directory_iterator(dir))
+			if (isMatchingType(entry, true)) out.push_back({ entry.path(), entry.path().filename() });
+		return;
+	}
+
+	for (const auto& entry : fs::recursive_directory_iterator(dir)) {
+		if (!isMatchingType(entry, false)) continue;
+		if (!extension.empty() && entry.path().extension() != extension) continue;
+
+		out.push_back({ entry.path(), fs::relative(entry.path(), dir) });
+	}
+}
+
+void collectGlob(std::vector<BatchInput>& out, const std::string& pattern, bool isDirectoryInput) {
+	// split off the leading components that contain no wildcards, which is where the search starts
+	fs::path root;
+	fs::path rest;
+	bool isInPattern = false;
+	for (const fs::path& component : fs::path(pattern)) {
+		if (!isInPattern && isWildcard(component.string()))
+			isInPattern = true;
+
+		if (isInPattern)
+			rest /= component;
+		else
+			root /= component;
+	}
+
+	if (root.empty()) root = ".";
+	if (!fs::is_directory(root)) return;
+
+	const std::string relPattern = rest.generic_string();
+	// without `**`, nothing deeper than the pattern itself can match
+	const bool isUnbounded = relPattern.find("**") != std::string::npos;
+	const s32 maxDepth = std::count(relPattern.begin(), relPattern.end(), '/');
+
+	for (auto it = fs::recursive_directory_iterator(root); it != fs::recursive_directory_iterator(); ++it) {
+		if (!isUnbounded && it.depth() >= maxDepth) it.disable_recursion_pending();
+		if (!isMatchingType(*it, isDirectoryInput)) continue;
+
+		fs::path relPath = fs::relative(it->path(), root);
+		if (matchGlob(relPattern, relPath.generic_string())) out.push_back({ it->path(), relPath });
+	}
+}
+
+hk::Result collectManifest(std::vector<BatchInput>& out, const fs::path& manifestPath) {
+	std::ifstream manifest(manifestPath);
+	if (!manifest) return ResultFileError();
+
+	const fs::path baseDir = manifestPath.parent_path();
+
+	std::string line;
+	while (std::getline(manifest, line)) {
+		while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+			line.pop_back();
+		if (line.empty() || line.front() == '#') continue;
+
+		// outputs mirror the whole path as written, so absolute entries with the same filename stay apart and `..`
+		// can't lead out of the output directory
+		const fs::path path = line;
+		const fs::path relPath = (path.is_relative() ? path : path.relative_path()).lexically_normal();
+		if (relPath.empty() || *relPath.begin() == "..") return utils::ResultInvalidArgument();
+
+		out.push_back({ path.is_relative() ? baseDir / path : path, relPath });
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+bool matchGlob(std::string_view pattern, std::string_view path) {
+	if (pattern.empty()) return path.empty();
+
+	if (pattern.starts_with("**")) {
+		pattern.remove_prefix(2);
+		if (pattern.starts_with('/')) {
+			// `**/` also matches zero directories
+			if (matchGlob(pattern.substr(1), path)) return true;
+		}
+
+		for (size_t i = 0; i <= path.size(); i++)
+			if (matchGlob(pattern, path.substr(i))) return true;
+		return false;
+	}
+
+	if (pattern.front() == '*') {
+		for (size_t i = 0; i <= path.size(); i++) {
+			if (matchGlob(pattern.substr(1), path.substr(i))) return true;
+			if (i < path.size() && path[i] == '/') break;
+		}
+		return false;
+	}
+
+	if (path.empty()) return false;
+	if (pattern.front() == '?' ? path.front() == '/' : pattern.front() != path.front()) return false;
+
+	return matchGlob(pattern.substr(1), path.substr(1));
+}
+
+hk::Result collectBatchInputs(
+	std::vector<BatchInput>& out, const std::string& spec, bool isDirectoryInput, std::string_view extension
+) {
+	out.clear();
+
+	if (spec.starts_with('@'))
+		HK_TRY(collectManifest(out, spec.substr(1)));
+	else if (isWildcard(spec))
+		collectGlob(out, spec, isDirectoryInput);
+	else if (fs::is_directory(spec))
+		collectDirectory(out, spec, isDirectoryInput, extension);
+	else
+		return ResultDirNotFound();
+
+	std::sort(out.begin(), out.end(), [](const BatchInput& a, const BatchInput& b) { return a.path < b.path; });
+
+	return hk::ResultSuccess();
+}
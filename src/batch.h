@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct BatchInput {
+	fs::path path;
+	fs::path relPath; // location relative to the batch root, mirrored in the output directory
+};
+
+// `*` and `?` match within a single path component, `**` matches across components
+bool matchGlob(std::string_view pattern, std::string_view path);
+
+// expands `spec` into a sorted list of inputs. `spec` is one of:
+//  - a directory: its files ending in `extension` (recursively), or its immediate subdirectories if
+//    `isDirectoryInput` is set
+//  - a glob, matched against paths relative to its longest wildcard-free prefix
+//  - @<manifest>: a text file listing one input per line. relative paths are resolved against the manifest's
+//    directory, and absolute ones are mirrored whole (minus the root). entries that climb above the manifest's
+//    directory with `..` are rejected, and blank lines and lines starting with '#' are skipped
+hk::Result collectBatchInputs(
+	std::vector<BatchInput>& out, const std::string& spec, bool isDirectoryInput, std::string_view extension
+);
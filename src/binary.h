@@ -0,0 +1,47 @@
+#pragma once
+
+#include <bit>
+#include <cstring>
+#include <hk/types.h>
+#include <utility>
+
+#include "mizuna/util.h"
+
+namespace bin {
+
+template <typename T>
+T byteswap(T value) {
+	u8 bytes[sizeof(T)];
+	std::memcpy(bytes, &value, sizeof(T));
+	for (size_t i = 0; i < sizeof(T) / 2; i++)
+		std::swap(bytes[i], bytes[sizeof(T) - 1 - i]);
+	std::memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+template <typename T>
+T read(const u8* p, util::ByteOrder order) {
+	T value;
+	std::memcpy(&value, p, sizeof(T));
+	bool isNative = (order == util::ByteOrder::Little) == (std::endian::native == std::endian::little);
+	return isNative ? value : byteswap(value);
+}
+
+template <typename T>
+void write(u8* p, T value, util::ByteOrder order) {
+	bool isNative = (order == util::ByteOrder::Little) == (std::endian::native == std::endian::little);
+	if (!isNative) value = byteswap(value);
+	std::memcpy(p, &value, sizeof(T));
+}
+
+template <typename T>
+T readBE(const u8* p) {
+	return read<T>(p, util::ByteOrder::Big);
+}
+
+template <typename T>
+T readLE(const u8* p) {
+	return read<T>(p, util::ByteOrder::Little);
+}
+
+} // namespace bin
@@ -0,0 +1,888 @@
+#include "byml.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <set>
+
+#include "hash.h"
+#include "json.h"
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace byml {
+
+namespace {
+
+constexpr u32 cHeaderSize = 0x10;
+constexpr u32 cRootOffsetPos = 0xc;
+constexpr u32 cMaxContainerSize = 0xffffff;
+
+// the index of `str` in a sorted table
+hk::ValueOrResult<u32> findIndex(const std::vector<std::string>& table, std::string_view str) {
+	auto it = std::lower_bound(table.begin(), table.end(), str);
+	if (it == table.end() || *it != str) return utils::ResultBymlInvalidValue();
+	return u32(it - table.begin());
+}
+
+} // namespace
+
+hk::Result Document::init(std::span<const u8> data) {
+	if (data.size() < cHeaderSize) return utils::ResultBymlInvalidData();
+
+	if (data[0] == 'Y' && data[1] == 'B')
+		mByteOrder = util::ByteOrder::Little;
+	else if (data[0] == 'B' && data[1] == 'Y')
+		mByteOrder = util::ByteOrder::Big;
+	else
+		return utils::ResultBymlInvalidData();
+
+	mData = data;
+	mVersion = bin::read<u16>(&data[2], mByteOrder);
+	if (mVersion < cMinVersion || mVersion > cMaxVersion) return utils::ResultBymlInvalidData();
+
+	HK_TRY(initTable(mKeys, bin::read<u32>(&data[4], mByteOrder)));
+	HK_TRY(initTable(mStrings, bin::read<u32>(&data[8], mByteOrder)));
+
+	const u32 rootOffset = bin::read<u32>(&data[cRootOffsetPos], mByteOrder);
+	mRoot = { NodeType::Null, 0 };
+	if (rootOffset != 0) {
+		if (rootOffset >= data.size()) return utils::ResultBymlInvalidData();
+		mRoot = { NodeType(data[rootOffset]), rootOffset };
+		HK_TRY(getSize(mRoot));
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Document::initTable(StringTable& out, u32 offset) const {
+	out = {};
+	if (offset == 0) return hk::ResultSuccess();
+
+	if (u64(offset) + 4 > mData.size() || NodeType(mData[offset]) != NodeType::StringTable)
+		return utils::ResultBymlInvalidData();
+
+	const u32 header = bin::read<u32>(&mData[offset], mByteOrder);
+	const u32 count = mByteOrder == util::ByteOrder::Little ? header >> 8 : header & 0xffffff;
+	if (offset + 4 + (u64(count) + 1) * 4 > mData.size()) return utils::ResultBymlInvalidData();
+
+	out = { offset, count };
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<std::string_view> Document::getTableString(const StringTable& table, u32 index) const {
+	if (index >= table.count) return utils::ResultBymlInvalidData();
+
+	const u64 start = u64(table.offset) + bin::read<u32>(&mData[table.offset + 4 + index * 4], mByteOrder);
+	if (start >= mData.size()) return utils::ResultBymlInvalidData();
+
+	const char* str = reinterpret_cast<const char*>(&mData[start]);
+	const void* terminator = std::memchr(str, '\0', mData.size() - start);
+	if (!terminator) return utils::ResultBymlInvalidData();
+
+	return std::string_view(str, static_cast<const char*>(terminator) - str);
+}
+
+hk::ValueOrResult<std::string_view> Document::getKey(u32 index) const {
+	return getTableString(mKeys, index);
+}
+
+hk::ValueOrResult<std::string_view> Document::getString(u32 index) const {
+	return getTableString(mStrings, index);
+}
+
+hk::ValueOrResult<s32> Document::findTableString(const StringTable& table, std::string_view str) const {
+	// the table is sorted
+	s32 low = 0;
+	s32 high = s32(table.count) - 1;
+	while (low <= high) {
+		const s32 mid = (low + high) / 2;
+		const std::string_view midStr = HK_TRY(getTableString(table, mid));
+		if (midStr == str) return mid;
+		if (midStr < str)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1;
+}
+
+hk::ValueOrResult<s32> Document::findKey(std::string_view key) const {
+	return findTableString(mKeys, key);
+}
+
+hk::ValueOrResult<s32> Document::findString(std::string_view value) const {
+	return findTableString(mStrings, value);
+}
+
+hk::ValueOrResult<u32> Document::getSize(Node container) const {
+	if (!isContainer(container.type) || u64(container.value) + 4 > mData.size() ||
+	    NodeType(mData[container.value]) != container.type)
+		return utils::ResultBymlInvalidData();
+
+	const u32 header = bin::read<u32>(&mData[container.value], mByteOrder);
+	const u32 size = mByteOrder == util::ByteOrder::Little ? header >> 8 : header & 0xffffff;
+
+	// the entries have to fit in the file
+	const u64 entriesSize = container.type == NodeType::Hash ? u64(size) * 8 : ((u64(size) + 3) & ~3ull) + size * 4ull;
+	if (container.value + 4 + entriesSize > mData.size()) return utils::ResultBymlInvalidData();
+
+	return size;
+}
+
+hk::ValueOrResult<u32> Document::getEntryOffset(Node container, u32 index) const {
+	const u32 size = HK_TRY(getSize(container));
+	if (index >= size) return utils::ResultBymlInvalidData();
+
+	if (container.type == NodeType::Hash) return container.value + 4 + index * 8 + 4;
+	return container.value + 4 + ((size + 3) & ~3) + index * 4;
+}
+
+hk::ValueOrResult<Node> Document::getEntry(Node container, u32 index, u32* key) const {
+	const u32 valueOffset = HK_TRY(getEntryOffset(container, index));
+	const u32 value = bin::read<u32>(&mData[valueOffset], mByteOrder);
+
+	if (container.type == NodeType::Array) return Node { NodeType(mData[container.value + 4 + index]), value };
+
+	const u32 info = bin::read<u32>(&mData[valueOffset - 4], mByteOrder);
+	if (key) *key = mByteOrder == util::ByteOrder::Little ? info & 0xffffff : info >> 8;
+	return Node { NodeType(mByteOrder == util::ByteOrder::Little ? info >> 24 : info & 0xff), value };
+}
+
+hk::ValueOrResult<s32> Document::findEntry(Node hash, u32 key) const {
+	// entries are sorted by key
+	s32 low = 0;
+	s32 high = s32(HK_TRY(getSize(hash))) - 1;
+	while (low <= high) {
+		const s32 mid = (low + high) / 2;
+		u32 midKey;
+		HK_TRY(getEntry(hash, mid, &midKey));
+		if (midKey == key) return mid;
+		if (midKey < key)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1;
+}
+
+hk::ValueOrResult<u64> Document::get64(Node node) const {
+	if (!is64(node.type) || u64(node.value) + 8 > mData.size()) return utils::ResultBymlInvalidData();
+	return bin::read<u64>(&mData[node.value], mByteOrder);
+}
+
+hk::ValueOrResult<std::span<const u8>> Document::getBinary(Node node) const {
+	if (node.type != NodeType::Binary || u64(node.value) + 4 > mData.size()) return utils::ResultBymlInvalidData();
+
+	const u32 size = bin::read<u32>(&mData[node.value], mByteOrder);
+	if (node.value + 4 + u64(size) > mData.size()) return utils::ResultBymlInvalidData();
+	return mData.subspan(node.value + 4, size);
+}
+
+hk::Result FlatDocument::init(const Document& document) {
+	mTypes.clear();
+	mValues.clear();
+	mEntries.clear();
+	mEntryKeys.clear();
+	mArena.clear();
+	mContainerNodes.clear();
+	mPending.clear();
+
+	auto copyTable = [&](std::vector<u32>& out, u32 count, auto get) -> hk::Result {
+		out.assign(1, mArena.size());
+		for (u32 i = 0; i < count; i++) {
+			const std::string_view str = HK_TRY((document.*get)(i));
+			mArena.insert(mArena.end(), str.begin(), str.end());
+			out.push_back(mArena.size());
+		}
+		return hk::ResultSuccess();
+	};
+
+	HK_TRY(copyTable(mKeys, document.getKeyCount(), &Document::getKey));
+	HK_TRY(copyTable(mStrings, document.getStringCount(), &Document::getString));
+
+	HK_TRY(addNode(document, document.getRoot()));
+
+	// entries are read one container at a time, so however deep the document is, nothing recurses
+	while (!mPending.empty()) {
+		const auto [index, container] = mPending.back();
+		mPending.pop_back();
+
+		const u32 first = u32(mValues[index]);
+		const u32 size = mValues[index] >> 32;
+		for (u32 i = 0; i < size; i++) {
+			u32 key = 0;
+			const Node entry = HK_TRY(document.getEntry(container, i, &key));
+			if (container.type == NodeType::Hash && key >= getKeyCount()) return utils::ResultBymlInvalidData();
+
+			const u32 node = HK_TRY(addNode(document, entry));
+			mEntries[first + i] = node;
+			mEntryKeys[first + i] = key;
+		}
+	}
+
+	mContainerNodes.clear();
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<u32> FlatDocument::addNode(const Document& document, Node node) {
+	if (isContainer(node.type)) {
+		auto it = mContainerNodes.find(node.value);
+		if (it != mContainerNodes.end()) return it->second;
+	}
+
+	const u32 index = mTypes.size();
+	u64 value = node.value;
+
+	switch (node.type) {
+	case NodeType::Array:
+	case NodeType::Hash: {
+		const u32 size = HK_TRY(document.getSize(node));
+		value = u64(size) << 32 | mEntries.size();
+		mEntries.resize(mEntries.size() + size);
+		mEntryKeys.resize(mEntryKeys.size() + size);
+		mContainerNodes.emplace(node.value, index);
+		mPending.push_back({ index, node });
+		break;
+	}
+	case NodeType::String:
+		if (node.value >= document.getStringCount()) return utils::ResultBymlInvalidData();
+		break;
+	case NodeType::Binary: {
+		const std::span<const u8> data = HK_TRY(document.getBinary(node));
+		value = u64(data.size()) << 32 | mArena.size();
+		mArena.insert(mArena.end(), data.begin(), data.end());
+		break;
+	}
+	case NodeType::S64:
+	case NodeType::U64:
+	case NodeType::F64: value = HK_TRY(document.get64(node)); break;
+	case NodeType::Bool:
+	case NodeType::S32:
+	case NodeType::U32:
+	case NodeType::F32:
+	case NodeType::Null: break;
+	default: return utils::ResultBymlInvalidData();
+	}
+
+	mTypes.push_back(node.type);
+	mValues.push_back(value);
+	return index;
+}
+
+s32 FlatDocument::findArenaString(const std::vector<u32>& table, std::string_view str) const {
+	s32 low = 0;
+	s32 high = s32(table.size()) - 2;
+	while (low <= high) {
+		const s32 mid = (low + high) / 2;
+		const std::string_view midStr = getArenaString(table, mid);
+		if (midStr == str) return mid;
+		if (midStr < str)
+			low = mid + 1;
+		else
+			high = mid - 1;
+	}
+	return -1;
+}
+
+s32 FlatDocument::findEntry(u32 hash, u32 key) const {
+	if (mTypes[hash] != NodeType::Hash) return -1;
+
+	auto begin = mEntryKeys.begin() + u32(mValues[hash]);
+	auto end = begin + getSize(hash);
+	auto it = std::lower_bound(begin, end, key);
+	return it != end && *it == key ? s32(it - begin) : -1;
+}
+
+s32 FlatDocument::findEntry(u32 hash, std::string_view key) const {
+	const s32 id = findKey(key);
+	return id < 0 ? -1 : findEntry(hash, u32(id));
+}
+
+hk::ValueOrResult<u32> FlatDocument::getEntryByKey(u32 hash, std::string_view key) const {
+	const s32 index = findEntry(hash, key);
+	if (index < 0) return utils::ResultBymlKeyNotFound();
+	return getEntry(hash, index);
+}
+
+hk::ValueOrResult<u64> FlatDocument::getBits(u32 node, NodeType type) const {
+	if (mTypes[node] != type) return ResultInvalidNodeType();
+	return mValues[node];
+}
+
+hk::ValueOrResult<std::string_view> FlatDocument::getString(u32 node) const {
+	return getArenaString(mStrings, HK_TRY(getBits(node, NodeType::String)));
+}
+
+hk::ValueOrResult<std::span<const u8>> FlatDocument::getBinary(u32 node) const {
+	const u64 value = HK_TRY(getBits(node, NodeType::Binary));
+	return std::span(reinterpret_cast<const u8*>(mArena.data()) + u32(value), value >> 32);
+}
+
+hk::ValueOrResult<bool> FlatDocument::getBool(u32 node) const {
+	return HK_TRY(getBits(node, NodeType::Bool)) != 0;
+}
+
+hk::ValueOrResult<s32> FlatDocument::getS32(u32 node) const {
+	return s32(HK_TRY(getBits(node, NodeType::S32)));
+}
+
+hk::ValueOrResult<u32> FlatDocument::getU32(u32 node) const {
+	return u32(HK_TRY(getBits(node, NodeType::U32)));
+}
+
+hk::ValueOrResult<f32> FlatDocument::getF32(u32 node) const {
+	return std::bit_cast<f32>(u32(HK_TRY(getBits(node, NodeType::F32))));
+}
+
+hk::ValueOrResult<s64> FlatDocument::getS64(u32 node) const {
+	return s64(HK_TRY(getBits(node, NodeType::S64)));
+}
+
+hk::ValueOrResult<u64> FlatDocument::getU64(u32 node) const {
+	return HK_TRY(getBits(node, NodeType::U64));
+}
+
+hk::ValueOrResult<f64> FlatDocument::getF64(u32 node) const {
+	return std::bit_cast<f64>(HK_TRY(getBits(node, NodeType::F64)));
+}
+
+Encoder::Encoder(
+	std::iostream& out, const EncodeOptions& options, std::vector<std::string>&& keys,
+	std::vector<std::string>&& strings
+)
+	: mOut(out), mOptions(options), mKeys(std::move(keys)), mStrings(std::move(strings)) {}
+
+void Encoder::writeHeader(u32 rootOffset) {
+	mNode.clear();
+	if (mOptions.byteOrder == util::ByteOrder::Little)
+		mNode.insert(mNode.end(), { 'Y', 'B' });
+	else
+		mNode.insert(mNode.end(), { 'B', 'Y' });
+	put<u16>(mNode, mOptions.version);
+	put<u32>(mNode, 0);
+	put<u32>(mNode, 0);
+	put<u32>(mNode, rootOffset);
+}
+
+hk::Result Encoder::write(std::span<const u8> data) {
+	if (u64(mPos) + data.size() > std::numeric_limits<u32>::max()) return utils::ResultBymlInvalidValue();
+
+	mOut.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!mOut) return ResultFileError();
+	mPos += data.size();
+
+	// everything starts on a 4-byte boundary
+	constexpr u8 cPadding[3] = {};
+	const u32 padding = -mPos & 3;
+	mOut.write(reinterpret_cast<const char*>(cPadding), padding);
+	if (!mOut) return ResultFileError();
+	mPos += padding;
+
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<u32> Encoder::writeStringTable(const std::vector<std::string>& strings) {
+	if (strings.empty()) return 0;
+	if (strings.size() > cMaxContainerSize) return utils::ResultBymlInvalidValue();
+
+	const u32 offset = mPos;
+	const u32 count = strings.size();
+
+	// the header, then one offset per string and one to the end of the last
+	mNode.clear();
+	const u8 type = u8(NodeType::StringTable);
+	put<u32>(mNode, mOptions.byteOrder == util::ByteOrder::Little ? type | count << 8 : type << 24 | count);
+	u32 stringOffset = 4 + (count + 1) * 4;
+	for (const std::string& str : strings) {
+		put<u32>(mNode, stringOffset);
+		stringOffset += str.size() + 1;
+	}
+	put<u32>(mNode, stringOffset);
+	HK_TRY(write(mNode));
+
+	// the strings are written without padding between them, so it's added once they're all out
+	for (const std::string& str : strings) {
+		mOut.write(str.c_str(), str.size() + 1);
+		mPos += str.size() + 1;
+	}
+	if (!mOut) return ResultFileError();
+	HK_TRY(write({}));
+
+	return offset;
+}
+
+hk::Result Encoder::begin(NodeType type) {
+	if (mIsDone) return utils::ResultBymlInvalidValue();
+
+	if (mPos == 0) {
+		// the header and both string tables come first
+		writeHeader(0);
+		HK_TRY(write(mNode));
+
+		const u32 keyTableOffset = HK_TRY(writeStringTable(mKeys));
+		const u32 stringTableOffset = HK_TRY(writeStringTable(mStrings));
+
+		const std::streampos end = mOut.tellp();
+		mOut.seekp(4);
+		mNode.clear();
+		put<u32>(mNode, keyTableOffset);
+		put<u32>(mNode, stringTableOffset);
+		mOut.write(reinterpret_cast<const char*>(mNode.data()), mNode.size());
+		mOut.seekp(end);
+		if (!mOut) return ResultFileError();
+	}
+
+	if (!mStack.empty() && (mStack.back().type == NodeType::Hash) != mHasKey) return utils::ResultBymlInvalidValue();
+
+	// the key is kept with the container until it's closed and added to its parent
+	Container& container = mStack.emplace_back();
+	container.type = type;
+	container.key = mNextKey;
+	mHasKey = false;
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::beginArray() {
+	return begin(NodeType::Array);
+}
+
+hk::Result Encoder::beginHash() {
+	return begin(NodeType::Hash);
+}
+
+hk::Result Encoder::writeContainer(u32& offset, Container& container) {
+	std::vector<Entry>& entries = container.entries;
+	if (entries.size() > cMaxContainerSize) return utils::ResultBymlInvalidValue();
+
+	const bool isLittle = mOptions.byteOrder == util::ByteOrder::Little;
+	const u8 type = u8(container.type);
+	const u32 count = entries.size();
+
+	mNode.clear();
+	put<u32>(mNode, isLittle ? type | count << 8 : type << 24 | count);
+
+	if (container.type == NodeType::Hash) {
+		// hashes are looked up by binary search, so their entries are sorted by key
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+		for (u32 i = 1; i < count; i++)
+			if (entries[i].key == entries[i - 1].key) return utils::ResultBymlInvalidValue();
+
+		for (const Entry& entry : entries) {
+			const u8 entryType = u8(entry.type);
+			put<u32>(mNode, isLittle ? entry.key | entryType << 24 : entry.key << 8 | entryType);
+			put<u32>(mNode, entry.value);
+		}
+	} else {
+		for (const Entry& entry : entries)
+			mNode.push_back(u8(entry.type));
+		mNode.resize((mNode.size() + 3) & ~3);
+		for (const Entry& entry : entries)
+			put<u32>(mNode, entry.value);
+	}
+
+	if (!mOptions.isShareContainers) {
+		offset = mPos;
+		return write(mNode);
+	}
+
+	auto [it, isNew] = mContainers.try_emplace({ hash::key(mNode), mNode.size() }, mPos);
+	if (!isNew && HK_TRY(isWritten(it->second))) {
+		offset = it->second;
+		return hk::ResultSuccess();
+	}
+
+	// a container that only shares a digest with an earlier one is written out, but not shared
+	offset = mPos;
+	return write(mNode);
+}
+
+hk::ValueOrResult<bool> Encoder::isWritten(u32 offset) {
+	const std::streampos end = mOut.tellp();
+	mWritten.resize(mNode.size());
+	mOut.seekg(offset);
+	mOut.read(reinterpret_cast<char*>(mWritten.data()), mWritten.size());
+	mOut.seekp(end);
+	if (!mOut) return ResultFileError();
+
+	return mWritten == mNode;
+}
+
+hk::Result Encoder::end() {
+	if (mStack.empty() || mHasKey) return utils::ResultBymlInvalidValue();
+
+	Container container = std::move(mStack.back());
+	mStack.pop_back();
+
+	u32 offset;
+	HK_TRY(writeContainer(offset, container));
+
+	if (mStack.empty()) {
+		mRootOffset = offset;
+		mIsDone = true;
+		return hk::ResultSuccess();
+	}
+
+	mStack.back().entries.push_back({ container.key, container.type, offset });
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::setKey(std::string_view key) {
+	if (mStack.empty() || mStack.back().type != NodeType::Hash || mHasKey) return utils::ResultBymlInvalidValue();
+
+	mNextKey = HK_TRY(findIndex(mKeys, key));
+	mHasKey = true;
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::add(NodeType type, u32 value) {
+	// scalars can't be the root
+	if (mStack.empty()) return utils::ResultBymlInvalidValue();
+
+	Container& container = mStack.back();
+	if ((container.type == NodeType::Hash) != mHasKey) return utils::ResultBymlInvalidValue();
+
+	container.entries.push_back({ mNextKey, type, value });
+	mHasKey = false;
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::addData(NodeType type, std::span<const u8> data) {
+	// written straight away, and pointed to from the container
+	const u32 offset = mPos;
+	HK_TRY(write(data));
+
+	return add(type, offset);
+}
+
+hk::Result Encoder::add64(NodeType type, u64 bits) {
+	if (mOptions.version < cMinVersion64) return utils::ResultBymlInvalidValue();
+	if (!mOptions.isShareContainers) {
+		mNode.clear();
+		put<u64>(mNode, bits);
+		return addData(type, mNode);
+	}
+
+	// interned like strings, so the containers holding them can be shared too
+	auto it = mValues64.find(bits);
+	if (it == mValues64.end()) {
+		mNode.clear();
+		put<u64>(mNode, bits);
+		it = mValues64.emplace(bits, mPos).first;
+		HK_TRY(write(mNode));
+	}
+
+	return add(type, it->second);
+}
+
+hk::Result Encoder::addString(std::string_view value) {
+	return add(NodeType::String, HK_TRY(findIndex(mStrings, value)));
+}
+
+hk::Result Encoder::addBool(bool value) {
+	return add(NodeType::Bool, value);
+}
+
+hk::Result Encoder::addS32(s32 value) {
+	return add(NodeType::S32, u32(value));
+}
+
+hk::Result Encoder::addU32(u32 value) {
+	return add(NodeType::U32, value);
+}
+
+hk::Result Encoder::addF32(f32 value) {
+	return add(NodeType::F32, std::bit_cast<u32>(value));
+}
+
+hk::Result Encoder::addS64(s64 value) {
+	return add64(NodeType::S64, u64(value));
+}
+
+hk::Result Encoder::addU64(u64 value) {
+	return add64(NodeType::U64, value);
+}
+
+hk::Result Encoder::addF64(f64 value) {
+	return add64(NodeType::F64, std::bit_cast<u64>(value));
+}
+
+hk::Result Encoder::addBinary(std::span<const u8> value) {
+	mNode.clear();
+	put<u32>(mNode, value.size());
+	mNode.insert(mNode.end(), value.begin(), value.end());
+	return addData(NodeType::Binary, mNode);
+}
+
+hk::Result Encoder::addNull() {
+	return add(NodeType::Null, 0);
+}
+
+hk::Result Encoder::addValue(NodeType type, u64 bits) {
+	switch (type) {
+	case NodeType::Bool:
+	case NodeType::S32:
+	case NodeType::U32:
+	case NodeType::F32:
+	case NodeType::Null: return add(type, u32(bits));
+	case NodeType::S64:
+	case NodeType::U64:
+	case NodeType::F64: return add64(type, bits);
+	default: return utils::ResultBymlInvalidValue();
+	}
+}
+
+hk::Result Encoder::finish() {
+	if (!mIsDone) return utils::ResultBymlInvalidValue();
+
+	const std::streampos end = mOut.tellp();
+	mOut.seekp(cRootOffsetPos);
+	mNode.clear();
+	put<u32>(mNode, mRootOffset);
+	mOut.write(reinterpret_cast<const char*>(mNode.data()), mNode.size());
+	mOut.seekp(end);
+
+	return mOut ? hk::ResultSuccess() : ResultFileError();
+}
+
+namespace {
+
+// JSON as `json::writeByml` writes it: a value tagged with its type (see `json::getTypeTag`) is an object with the tag
+// as its only key, which is passed on as one value rather than as a hash
+class TypedHandler : public json::Handler {
+public:
+	hk::Result beginArray() final {
+		HK_TRY(beginValue());
+		return onBeginArray();
+	}
+
+	hk::Result endArray() final { return onEnd(); }
+
+	hk::Result beginObject() final {
+		HK_TRY(beginValue());
+		// whether it's a hash or a tagged value only shows with its first key
+		mIsObjectPending = true;
+		return hk::ResultSuccess();
+	}
+
+	hk::Result endObject() final {
+		if (mIsObjectPending) {
+			mIsObjectPending = false;
+			HK_TRY(onBeginHash());
+		} else if (mTagState == TagState::Done) {
+			mTagState = TagState::None;
+			return hk::ResultSuccess();
+		}
+		return onEnd();
+	}
+
+	hk::Result key(std::string_view key) final {
+		if (mTagState == TagState::Done) return utils::ResultBymlInvalidValue();
+		if (mIsObjectPending) {
+			mIsObjectPending = false;
+
+			mTag = json::findTypeTag(key);
+			if (mTag != NodeType::Null) {
+				mTagState = TagState::Value;
+				return hk::ResultSuccess();
+			}
+			HK_TRY(onBeginHash());
+		}
+		return onKey(key);
+	}
+
+	hk::Result string(std::string_view value) final {
+		if (mTagState == TagState::Value) return endTagged(NodeType::Binary, value);
+		return onString(value);
+	}
+
+	hk::Result number(std::string_view text) final {
+		if (mTagState == TagState::Value) {
+			if (mTag == NodeType::Binary) return utils::ResultBymlInvalidValue();
+			return endTagged(mTag, text);
+		}
+		return onNumber(text);
+	}
+
+	hk::Result boolean(bool value) final {
+		HK_TRY(beginValue());
+		return onBool(value);
+	}
+
+	hk::Result null() final {
+		HK_TRY(beginValue());
+		return onNull();
+	}
+
+protected:
+	virtual hk::Result onBeginArray() { return hk::ResultSuccess(); }
+	virtual hk::Result onBeginHash() { return hk::ResultSuccess(); }
+	virtual hk::Result onEnd() { return hk::ResultSuccess(); }
+	virtual hk::Result onKey(std::string_view) { return hk::ResultSuccess(); }
+	virtual hk::Result onString(std::string_view) { return hk::ResultSuccess(); }
+	virtual hk::Result onNumber(std::string_view) { return hk::ResultSuccess(); }
+	virtual hk::Result onBool(bool) { return hk::ResultSuccess(); }
+	virtual hk::Result onNull() { return hk::ResultSuccess(); }
+
+	// a tagged value, with the text of its number, or for Binary its base64 string
+	virtual hk::Result onTagged(NodeType, std::string_view) { return hk::ResultSuccess(); }
+
+private:
+	enum class TagState : u8 {
+		None,
+		Value, // after the tag, where its value goes
+		Done,  // after the value, where the object has to end
+	};
+
+	// a tagged value holds nothing but a number, or a string for Binary
+	hk::Result beginValue() const {
+		return mTagState == TagState::None ? hk::ResultSuccess() : utils::ResultBymlInvalidValue();
+	}
+
+	hk::Result endTagged(NodeType type, std::string_view text) {
+		if (type != mTag) return utils::ResultBymlInvalidValue();
+		mTagState = TagState::Done;
+		return onTagged(type, text);
+	}
+
+	bool mIsObjectPending = false;
+	TagState mTagState = TagState::None;
+	NodeType mTag = NodeType::Null;
+};
+
+// the first pass, which only looks at keys and strings
+class StringCollector : public TypedHandler {
+public:
+	// sorted already, which is the order BYML wants them in
+	static std::vector<std::string> take(std::set<std::string, std::less<>>& set) {
+		std::vector<std::string> out;
+		out.reserve(set.size());
+		while (!set.empty())
+			out.push_back(std::move(set.extract(set.begin()).value()));
+		return out;
+	}
+
+	std::set<std::string, std::less<>> mKeys;
+	std::set<std::string, std::less<>> mStrings;
+
+private:
+	hk::Result onKey(std::string_view key) override {
+		mKeys.emplace(key);
+		return hk::ResultSuccess();
+	}
+
+	hk::Result onString(std::string_view value) override {
+		mStrings.emplace(value);
+		return hk::ResultSuccess();
+	}
+};
+
+// the second pass, which writes the nodes
+class EncodeHandler : public TypedHandler {
+public:
+	explicit EncodeHandler(Encoder& encoder) : mEncoder(encoder) {}
+
+private:
+	hk::Result onBeginArray() override { return mEncoder.beginArray(); }
+	hk::Result onBeginHash() override { return mEncoder.beginHash(); }
+	hk::Result onEnd() override { return mEncoder.end(); }
+	hk::Result onKey(std::string_view key) override { return mEncoder.setKey(key); }
+	hk::Result onString(std::string_view value) override { return mEncoder.addString(value); }
+	hk::Result onNumber(std::string_view text) override {
+		const Number number = HK_TRY(parseNumber(text));
+		return mEncoder.addValue(number.type, number.bits);
+	}
+	hk::Result onBool(bool value) override { return mEncoder.addBool(value); }
+	hk::Result onNull() override { return mEncoder.addNull(); }
+
+	hk::Result onTagged(NodeType type, std::string_view text) override {
+		if (type == NodeType::Binary) {
+			HK_TRY(json::decodeBase64(mBinary, text));
+			return mEncoder.addBinary(mBinary);
+		}
+
+		// the tag's type or nothing, e.g. a negative U32 fails rather than becoming an S32
+		const Number number = HK_TRY(parseNumber(text, type));
+		if (number.type != type) return utils::ResultBymlInvalidValue();
+		return mEncoder.addValue(number.type, number.bits);
+	}
+
+	Encoder& mEncoder;
+	std::vector<u8> mBinary;
+};
+
+} // namespace
+
+hk::ValueOrResult<Number> parseNumber(std::string_view text, NodeType preferred) {
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+
+	const bool isFloat = preferred == NodeType::F32 || preferred == NodeType::F64;
+	if (!isFloat && text.find_first_of(".eE") == std::string_view::npos) {
+		s64 value;
+		if (std::from_chars(begin, end, value).ec == std::errc()) {
+			const bool isS32 = value >= std::numeric_limits<s32>::min() && value <= std::numeric_limits<s32>::max();
+			const bool isU32 = value >= 0 && value <= std::numeric_limits<u32>::max();
+
+			switch (preferred) {
+			case NodeType::S32:
+				if (isS32) return Number { preferred, u32(value) };
+				break;
+			case NodeType::U32:
+				if (isU32) return Number { preferred, u32(value) };
+				break;
+			case NodeType::S64: return Number { preferred, u64(value) };
+			case NodeType::U64:
+				if (value >= 0) return Number { preferred, u64(value) };
+				break;
+			default: break;
+			}
+
+			if (isS32) return Number { NodeType::S32, u32(value) };
+			if (isU32) return Number { NodeType::U32, u32(value) };
+			return Number { NodeType::S64, u64(value) };
+		}
+
+		u64 unsignedValue;
+		if (std::from_chars(begin, end, unsignedValue).ec != std::errc()) return utils::ResultBymlInvalidValue();
+		return Number { NodeType::U64, unsignedValue };
+	}
+
+	f64 value;
+	if (std::from_chars(begin, end, value).ec != std::errc()) return utils::ResultBymlInvalidValue();
+	if (preferred == NodeType::F64) return Number { NodeType::F64, std::bit_cast<u64>(value) };
+
+	// F32 if the shortest text of the nearest float reads back as the same number, which is how `byml r` prints them
+	const f32 single = f32(value);
+	if (std::isfinite(single)) {
+		char buf[32];
+		f64 roundTrip;
+		std::from_chars(buf, std::to_chars(buf, buf + sizeof(buf), single).ptr, roundTrip);
+		if (preferred == NodeType::F32 || roundTrip == value)
+			return Number { NodeType::F32, std::bit_cast<u32>(single) };
+	}
+
+	return Number { NodeType::F64, std::bit_cast<u64>(value) };
+}
+
+hk::Result encodeJson(std::istream& in, std::iostream& out, const EncodeOptions& options) {
+	if (options.version < cMinVersion || options.version > cMaxVersion) return utils::ResultInvalidArgument();
+
+	StringCollector collector;
+	HK_TRY(json::parse(in, collector));
+
+	in.clear();
+	in.seekg(0);
+	if (!in) return ResultFileError();
+
+	Encoder encoder(out, options, StringCollector::take(collector.mKeys), StringCollector::take(collector.mStrings));
+	EncodeHandler handler(encoder);
+	HK_TRY(json::parse(in, handler));
+
+	return encoder.finish();
+}
+
+} // namespace byml
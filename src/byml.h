@@ -0,0 +1,303 @@
+#pragma once
+
+#include <hk/ValueOrResult.h>
+#include <istream>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "binary.h"
+#include "hash.h"
+#include "mizuna/byml/reader.h"
+#include "mizuna/util.h"
+
+namespace byml {
+
+constexpr u16 cMinVersion = 1;
+constexpr u16 cMaxVersion = 7;
+
+// 64-bit values only exist from this version on
+constexpr u16 cMinVersion64 = 3;
+
+inline bool isContainer(NodeType type) {
+	return type == NodeType::Array || type == NodeType::Hash;
+}
+
+// values that don't fit in 32 bits, which are stored elsewhere and pointed to
+inline bool is64(NodeType type) {
+	return type == NodeType::S64 || type == NodeType::U64 || type == NodeType::F64;
+}
+
+// a node's type and the 32 bits stored for it in its parent: the value itself, a string index, or an offset
+struct Node {
+	NodeType type;
+	u32 value;
+};
+
+// a BYML file read in place. unlike mizuna's reader, containers are just their offsets, so nodes can be compared and
+// used as keys, e.g. to notice shared subtrees. every access is checked against the bounds of the data
+class Document {
+public:
+	// `data` has to outlive the document
+	hk::Result init(std::span<const u8> data);
+
+	// null for an empty document
+	Node getRoot() const { return mRoot; }
+
+	util::ByteOrder getByteOrder() const { return mByteOrder; }
+	u16 getVersion() const { return mVersion; }
+	std::span<const u8> getData() const { return mData; }
+
+	// the number of entries in a container
+	hk::ValueOrResult<u32> getSize(Node container) const;
+
+	// a container's `index`th entry. for hashes, `key` is set to its index in the key table
+	hk::ValueOrResult<Node> getEntry(Node container, u32 index, u32* key = nullptr) const;
+
+	// where the 32 bits of a container's `index`th entry are stored
+	hk::ValueOrResult<u32> getEntryOffset(Node container, u32 index) const;
+
+	u32 getKeyCount() const { return mKeys.count; }
+	u32 getStringCount() const { return mStrings.count; }
+	hk::ValueOrResult<std::string_view> getKey(u32 index) const;
+	hk::ValueOrResult<std::string_view> getString(u32 index) const;
+
+	// the key table index of `key`, or -1
+	hk::ValueOrResult<s32> findKey(std::string_view key) const;
+
+	// the string table index of `value`, or -1
+	hk::ValueOrResult<s32> findString(std::string_view value) const;
+
+	// the index of `key`'s entry in a hash, or -1
+	hk::ValueOrResult<s32> findEntry(Node hash, u32 key) const;
+
+	// the 8 bytes an S64, U64 or F64 points to
+	hk::ValueOrResult<u64> get64(Node node) const;
+	hk::ValueOrResult<std::span<const u8>> getBinary(Node node) const;
+
+private:
+	struct StringTable {
+		u32 offset = 0;
+		u32 count = 0;
+	};
+
+	hk::Result initTable(StringTable& out, u32 offset) const;
+	hk::ValueOrResult<std::string_view> getTableString(const StringTable& table, u32 index) const;
+	hk::ValueOrResult<s32> findTableString(const StringTable& table, std::string_view str) const;
+
+	std::span<const u8> mData;
+	util::ByteOrder mByteOrder = util::ByteOrder::Little;
+	u16 mVersion = 0;
+	StringTable mKeys;
+	StringTable mStrings;
+	Node mRoot = { NodeType::Null, 0 };
+};
+
+// a document decoded in one pass into flat arrays, for documents that are walked more than once. nodes are indices
+// into parallel arrays of types and values, and each container's entries are a contiguous range of node indices (with,
+// for hashes, a parallel range of sorted key ids), so walking a container is index arithmetic and finding a key is a
+// binary search over integers. containers shared in the file are decoded once and stay shared.
+// strings and binary data are copied into one arena, so the source can be freed. `init` can be called again for
+// another document, reusing all of the memory
+class FlatDocument {
+public:
+	static constexpr u32 cRoot = 0; // null for an empty document
+
+	hk::Result init(const Document& document);
+
+	u32 getNodeCount() const { return mTypes.size(); }
+	NodeType getType(u32 node) const { return mTypes[node]; }
+
+	// the number of entries in a container, or 0 for anything else
+	u32 getSize(u32 node) const { return isContainer(mTypes[node]) ? mValues[node] >> 32 : 0; }
+
+	// the node of a container's `index`th entry
+	u32 getEntry(u32 container, u32 index) const { return mEntries[u32(mValues[container]) + index]; }
+
+	// the key id of a hash's `index`th entry
+	u32 getEntryKey(u32 hash, u32 index) const { return mEntryKeys[u32(mValues[hash]) + index]; }
+
+	u32 getKeyCount() const { return mKeys.empty() ? 0 : mKeys.size() - 1; }
+
+	// empty for an id past the end of the key table
+	std::string_view getKey(u32 id) const { return getArenaString(mKeys, id); }
+
+	// the id of `key`, or -1
+	s32 findKey(std::string_view key) const { return findArenaString(mKeys, key); }
+
+	// the string table index of `value`, or -1
+	s32 findString(std::string_view value) const { return findArenaString(mStrings, value); }
+
+	// the index of the entry with key id `key` in a hash, or -1 (also if `node` isn't a hash)
+	s32 findEntry(u32 hash, u32 key) const;
+	s32 findEntry(u32 hash, std::string_view key) const;
+
+	// the node of `key` in a hash, which has to exist
+	hk::ValueOrResult<u32> getEntryByKey(u32 hash, std::string_view key) const;
+
+	// values, which fail unless the node has the type asked for
+	hk::ValueOrResult<std::string_view> getString(u32 node) const;
+	hk::ValueOrResult<std::span<const u8>> getBinary(u32 node) const;
+	hk::ValueOrResult<bool> getBool(u32 node) const;
+	hk::ValueOrResult<s32> getS32(u32 node) const;
+	hk::ValueOrResult<u32> getU32(u32 node) const;
+	hk::ValueOrResult<f32> getF32(u32 node) const;
+	hk::ValueOrResult<s64> getS64(u32 node) const;
+	hk::ValueOrResult<u64> getU64(u32 node) const;
+	hk::ValueOrResult<f64> getF64(u32 node) const;
+
+private:
+	hk::ValueOrResult<u32> addNode(const Document& document, Node node);
+	hk::ValueOrResult<u64> getBits(u32 node, NodeType type) const;
+
+	std::string_view getArenaString(const std::vector<u32>& table, u32 index) const {
+		if (u64(index) + 1 >= table.size()) return {};
+		return std::string_view(mArena.data() + table[index], table[index + 1] - table[index]);
+	}
+
+	s32 findArenaString(const std::vector<u32>& table, std::string_view str) const;
+
+	// per node. containers store the index of their first entry in the low 32 bits of their value and their size in
+	// the high ones, strings their index, binary data its arena offset and size, and other types their bits
+	std::vector<NodeType> mTypes;
+	std::vector<u64> mValues;
+
+	// per container entry
+	std::vector<u32> mEntries;
+	std::vector<u32> mEntryKeys;
+
+	// where each string starts in the arena, followed by where the last one ends
+	std::vector<u32> mKeys;
+	std::vector<u32> mStrings;
+	std::vector<char> mArena;
+
+	// only used while decoding: the node of each container's offset, and containers whose entries are yet to be read
+	std::unordered_map<u32, u32> mContainerNodes;
+	std::vector<std::pair<u32, Node>> mPending;
+};
+
+struct EncodeOptions {
+	util::ByteOrder byteOrder = util::ByteOrder::Little;
+	u16 version = 3; // SMO's. SM3DW's is 1
+	// write identical containers (and 64-bit values) once and point every parent at that copy, as Nintendo's files do
+	bool isShareContainers = true;
+};
+
+// writes a BYML document to a stream while it is being built. each container is written once it's closed, after its
+// children, so only the containers on the way to the current one are held in memory. the root offset in the header is
+// filled in by `finish`, which needs `out` to be seekable.
+// children are written (and shared) before their parents, so two containers with the same contents encode to the same
+// bytes. those are hashed to find containers that were written before, and read back from `out` to compare them with
+// to be sure, so each distinct subtree is stored once. only the digest, size and offset of each one are kept
+class Encoder {
+public:
+	// `keys` and `strings` hold every hash key and string value the document will have, sorted and without
+	// duplicates. they are written out first
+	Encoder(
+		std::iostream& out, const EncodeOptions& options, std::vector<std::string>&& keys,
+		std::vector<std::string>&& strings
+	);
+
+	// opens a container as the next value, or as the root
+	hk::Result beginArray();
+	hk::Result beginHash();
+
+	// closes the innermost container
+	hk::Result end();
+
+	// the key of the next value in the innermost hash
+	hk::Result setKey(std::string_view key);
+
+	hk::Result addString(std::string_view value);
+	hk::Result addBool(bool value);
+	hk::Result addS32(s32 value);
+	hk::Result addU32(u32 value);
+	hk::Result addF32(f32 value);
+	hk::Result addS64(s64 value);
+	hk::Result addU64(u64 value);
+	hk::Result addF64(f64 value);
+	hk::Result addBinary(std::span<const u8> value);
+	hk::Result addNull();
+
+	// any other value by its type and bits, e.g. as read by `parseNumber`
+	hk::Result addValue(NodeType type, u64 bits);
+
+	hk::Result finish();
+
+private:
+	struct Entry {
+		u32 key; // index into the key table, for hashes
+		NodeType type;
+		u32 value; // the value itself, or an offset
+	};
+
+	struct Container {
+		NodeType type;
+		u32 key; // its own key in the parent hash
+		std::vector<Entry> entries;
+	};
+
+	hk::Result add(NodeType type, u32 value);
+	hk::Result add64(NodeType type, u64 bits);
+	hk::Result addData(NodeType type, std::span<const u8> data);
+	hk::Result begin(NodeType type);
+
+	void writeHeader(u32 rootOffset);
+	hk::ValueOrResult<u32> writeStringTable(const std::vector<std::string>& strings);
+	hk::Result writeContainer(u32& offset, Container& container);
+	// whether the container at `offset` holds the same bytes as `mNode`
+	hk::ValueOrResult<bool> isWritten(u32 offset);
+	hk::Result write(std::span<const u8> data);
+
+	template <typename T>
+	void put(std::vector<u8>& out, T value) {
+		u8 bytes[sizeof(T)];
+		bin::write(bytes, value, mOptions.byteOrder);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	std::iostream& mOut;
+	const EncodeOptions mOptions;
+	const std::vector<std::string> mKeys;
+	const std::vector<std::string> mStrings;
+
+	// the offset of each container written so far, by its digest and size
+	std::map<std::pair<hash::Digest128, u32>, u32> mContainers;
+
+	// the offset of each 64-bit value written so far, by its bits
+	std::unordered_map<u64, u32> mValues64;
+
+	std::vector<Container> mStack;
+	u32 mNextKey = 0;
+	bool mHasKey = false;
+	bool mIsDone = false;
+	u32 mRootOffset = 0;
+	u32 mPos = 0;
+
+	// reused for every node, so writing allocates nothing once it has grown
+	std::vector<u8> mNode;
+	std::vector<u8> mWritten; // an earlier container read back from `mOut`
+};
+
+// a number value: its type and bits (for S64, U64 and F64 the 64 bits they point to)
+struct Number {
+	NodeType type;
+	u64 bits;
+};
+
+// reads a JSON number as `preferred` if it fits, e.g. to keep a value's type when it's replaced. otherwise, integers
+// become S32 where they fit and U32, S64 or U64 otherwise, and numbers with a fraction or exponent become F32 unless
+// F64 is needed to keep them exact
+hk::ValueOrResult<Number> parseNumber(std::string_view text, NodeType preferred = NodeType::Null);
+
+// converts the JSON document in `in` in two passes: the first collects every key and string, the second writes
+// the nodes. numbers are typed as by `parseNumber`, unless they're tagged as `json::writeByml` writes them (e.g.
+// `{"!u32": 5}`, see `json::getTypeTag`), so its output converts back to the same types. objects whose first key is a
+// tag are read as tagged values, never as hashes
+hk::Result encodeJson(std::istream& in, std::iostream& out, const EncodeOptions& options);
+
+} // namespace byml
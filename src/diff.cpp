@@ -0,0 +1,451 @@
+#include "diff.h"
+
+#include <algorithm>
+#include <format>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include "archive.h"
+#include "byml.h"
+#include "hash.h"
+#include "mizuna/results.h"
+#include "results.h"
+#include "sarc.h"
+
+namespace fs = std::filesystem;
+
+namespace diff {
+
+namespace {
+
+// containers nested deeper than this are taken to contain themselves
+constexpr u32 cMaxDepth = 1024;
+
+// archives nested deeper than this are taken to be malformed
+constexpr u32 cMaxArchiveDepth = 8;
+
+using Digest = hash::Digest128;
+
+// structural hashes of the nodes of a document. strings are hashed by their contents and containers by their entries,
+// so equal subtrees hash the same whatever their offsets, in the same file or another
+class Hasher {
+public:
+	explicit Hasher(const byml::Document& document) : mDocument(document) {}
+
+	hk::ValueOrResult<Digest> get(byml::Node node) {
+		return byml::isContainer(node.type) ? getContainer(node) : getScalar(node);
+	}
+
+private:
+	hk::ValueOrResult<Digest> getScalar(byml::Node node);
+	hk::ValueOrResult<Digest> getContainer(byml::Node node);
+
+	// the hash of a container's header, which its entries are then folded into one by one
+	Digest begin(byml::Node container, u32 size);
+	void combine(Digest& state, const Digest& child, std::string_view key);
+
+	void add(const void* data, size_t size) {
+		const u8* bytes = static_cast<const u8*>(data);
+		mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+	}
+
+	Digest hashBuffer() const { return hash::key(mBuffer); }
+
+	const byml::Document& mDocument;
+	std::unordered_map<u32, Digest> mContainers; // by offset, so shared subtrees are only hashed once
+	std::vector<u8> mBuffer;
+};
+
+hk::ValueOrResult<Digest> Hasher::getScalar(byml::Node node) {
+	mBuffer.clear();
+	mBuffer.push_back(u8(node.type));
+
+	switch (node.type) {
+	case byml::NodeType::String: {
+		const std::string_view str = HK_TRY(mDocument.getString(node.value));
+		add(str.data(), str.size());
+		break;
+	}
+	case byml::NodeType::Binary: {
+		const std::span<const u8> data = HK_TRY(mDocument.getBinary(node));
+		add(data.data(), data.size());
+		break;
+	}
+	case byml::NodeType::S64:
+	case byml::NodeType::U64:
+	case byml::NodeType::F64: {
+		const u64 value = HK_TRY(mDocument.get64(node));
+		add(&value, sizeof(value));
+		break;
+	}
+	default: add(&node.value, sizeof(node.value)); break;
+	}
+
+	return hashBuffer();
+}
+
+Digest Hasher::begin(byml::Node container, u32 size) {
+	mBuffer.clear();
+	mBuffer.push_back(u8(container.type));
+	add(&size, sizeof(size));
+	return hashBuffer();
+}
+
+void Hasher::combine(Digest& state, const Digest& child, std::string_view key) {
+	mBuffer.clear();
+	add(&state, sizeof(state));
+	add(&child, sizeof(child));
+	add(key.data(), key.size());
+	state = hashBuffer();
+}
+
+hk::ValueOrResult<Digest> Hasher::getContainer(byml::Node node) {
+	struct Frame {
+		byml::Node container;
+		u32 index;
+		u32 size;
+		Digest state;
+		std::string_view key; // its own key in the parent hash
+	};
+
+	auto it = mContainers.find(node.value);
+	if (it != mContainers.end()) return it->second;
+
+	// children are hashed before their parents, with an explicit stack
+	std::vector<Frame> stack;
+	const u32 rootSize = HK_TRY(mDocument.getSize(node));
+	stack.push_back({ node, 0, rootSize, begin(node, rootSize), {} });
+
+	while (true) {
+		Frame& frame = stack.back();
+
+		if (frame.index == frame.size) {
+			const Digest digest = frame.state;
+			const std::string_view key = frame.key;
+			mContainers.emplace(frame.container.value, digest);
+
+			stack.pop_back();
+			if (stack.empty()) return digest;
+			combine(stack.back().state, digest, key);
+			continue;
+		}
+
+		u32 keyIndex;
+		const byml::Node entry = HK_TRY(mDocument.getEntry(frame.container, frame.index++, &keyIndex));
+		const std::string_view key =
+			frame.container.type == byml::NodeType::Hash ? HK_TRY(mDocument.getKey(keyIndex)) : std::string_view();
+
+		if (!byml::isContainer(entry.type)) {
+			const Digest digest = HK_TRY(getScalar(entry));
+			combine(frame.state, digest, key);
+			continue;
+		}
+
+		auto cached = mContainers.find(entry.value);
+		if (cached != mContainers.end()) {
+			combine(frame.state, cached->second, key);
+			continue;
+		}
+
+		if (stack.size() >= cMaxDepth) return utils::ResultBymlInvalidData();
+		const u32 size = HK_TRY(mDocument.getSize(entry));
+		// invalidates `frame`
+		stack.push_back({ entry, 0, size, begin(entry, size), key });
+	}
+}
+
+std::string joinPath(const std::string& path, std::string_view component) {
+	if (path.empty()) return std::string(component);
+	return path + '/' + std::string(component);
+}
+
+class Differ {
+public:
+	Differ(json::Writer& out, const byml::Document& a, const byml::Document& b)
+		: mOut(out), mA(a), mB(b), mHasherA(a), mHasherB(b) {}
+
+	hk::Result run(u64& numChanges, const std::string& prefix);
+
+private:
+	enum class Side {
+		Both,
+		OnlyA,
+		OnlyB,
+	};
+
+	struct Item {
+		std::string path;
+		Side side;
+		byml::Node a;
+		byml::Node b;
+	};
+
+	hk::Result addChildren(std::vector<Item>& out, const Item& item);
+	hk::Result report(const Item& item);
+
+	json::Writer& mOut;
+	const byml::Document& mA;
+	const byml::Document& mB;
+	Hasher mHasherA;
+	Hasher mHasherB;
+};
+
+hk::Result Differ::run(u64& numChanges, const std::string& prefix) {
+	// depth first, with children pushed in reverse so changes come out in document order
+	std::vector<Item> stack;
+	stack.push_back({ prefix, Side::Both, mA.getRoot(), mB.getRoot() });
+
+	std::vector<Item> children;
+	while (!stack.empty()) {
+		const Item item = std::move(stack.back());
+		stack.pop_back();
+
+		if (item.side == Side::Both) {
+			// equal subtrees are skipped however big they are
+			if (HK_TRY(mHasherA.get(item.a)) == HK_TRY(mHasherB.get(item.b))) continue;
+
+			// hashing has already walked both subtrees, so they can't contain themselves
+			if (item.a.type == item.b.type && byml::isContainer(item.a.type)) {
+				children.clear();
+				HK_TRY(addChildren(children, item));
+				std::move(children.rbegin(), children.rend(), std::back_inserter(stack));
+				continue;
+			}
+		}
+
+		HK_TRY(report(item));
+		HK_TRY(mOut.getResult());
+		numChanges++;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Differ::addChildren(std::vector<Item>& out, const Item& item) {
+	const u32 sizeA = HK_TRY(mA.getSize(item.a));
+	const u32 sizeB = HK_TRY(mB.getSize(item.b));
+	const byml::Node null = { byml::NodeType::Null, 0 };
+
+	if (item.a.type == byml::NodeType::Array) {
+		for (u32 i = 0; i < std::max(sizeA, sizeB); i++) {
+			const std::string path = joinPath(item.path, std::to_string(i));
+			if (i >= sizeB)
+				out.push_back({ path, Side::OnlyA, HK_TRY(mA.getEntry(item.a, i)), null });
+			else if (i >= sizeA)
+				out.push_back({ path, Side::OnlyB, null, HK_TRY(mB.getEntry(item.b, i)) });
+			else
+				out.push_back({ path, Side::Both, HK_TRY(mA.getEntry(item.a, i)), HK_TRY(mB.getEntry(item.b, i)) });
+		}
+		return hk::ResultSuccess();
+	}
+
+	// entries are sorted by key on both sides, so they're merged in one pass
+	u32 i = 0;
+	u32 j = 0;
+	while (i < sizeA || j < sizeB) {
+		u32 keyA = 0;
+		u32 keyB = 0;
+		const byml::Node entryA = i < sizeA ? HK_TRY(mA.getEntry(item.a, i, &keyA)) : null;
+		const byml::Node entryB = j < sizeB ? HK_TRY(mB.getEntry(item.b, j, &keyB)) : null;
+		const std::string_view nameA = i < sizeA ? HK_TRY(mA.getKey(keyA)) : std::string_view();
+		const std::string_view nameB = j < sizeB ? HK_TRY(mB.getKey(keyB)) : std::string_view();
+
+		if (j == sizeB || (i < sizeA && nameA < nameB)) {
+			out.push_back({ joinPath(item.path, nameA), Side::OnlyA, entryA, null });
+			i++;
+		} else if (i == sizeA || nameB < nameA) {
+			out.push_back({ joinPath(item.path, nameB), Side::OnlyB, null, entryB });
+			j++;
+		} else {
+			out.push_back({ joinPath(item.path, nameA), Side::Both, entryA, entryB });
+			i++;
+			j++;
+		}
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Differ::report(const Item& item) {
+	const std::string_view path = item.path.empty() ? "/" : std::string_view(item.path);
+
+	switch (item.side) {
+	case Side::Both:
+		mOut.raw("~ ");
+		mOut.raw(path);
+		mOut.raw(": ");
+		HK_TRY(json::writeNode(mOut, mA, item.a));
+		mOut.raw(" -> ");
+		HK_TRY(json::writeNode(mOut, mB, item.b));
+		break;
+	case Side::OnlyA:
+		mOut.raw("- ");
+		mOut.raw(path);
+		mOut.raw(": ");
+		HK_TRY(json::writeNode(mOut, mA, item.a));
+		break;
+	case Side::OnlyB:
+		mOut.raw("+ ");
+		mOut.raw(path);
+		mOut.raw(": ");
+		HK_TRY(json::writeNode(mOut, mB, item.b));
+		break;
+	}
+
+	mOut.newline();
+	return hk::ResultSuccess();
+}
+
+// one romfs file's part of a tree diff
+struct FileJob {
+	std::vector<u8> output;
+	u64 numChanges = 0;
+	hk::Result result = hk::ResultSuccess();
+};
+
+void reportFile(json::Writer& out, char marker, const std::string& path) {
+	out.raw(std::string_view(&marker, 1));
+	out.raw(" ");
+	out.raw(path);
+	out.newline();
+}
+
+using EntryMap = std::map<std::string, const sarc::EntryInfo*>;
+
+void mapEntries(EntryMap& out, const sarc::EntryTable& table) {
+	for (const sarc::EntryInfo& entry : table.getEntries()) {
+		const std::string_view name = table.getName(entry);
+		out.emplace(name.empty() ? std::format("{:08x}.bin", entry.hash) : std::string(name), &entry);
+	}
+}
+
+hk::Result diffFiles(
+	FileJob& job, json::Writer& out, const std::string& path, const archive::File& a, const archive::File& b,
+	const zs::DictionarySet* dictionaries, u32 depth
+) {
+	const std::span<const u8> dataA = a.getData();
+	const std::span<const u8> dataB = b.getData();
+	if (std::equal(dataA.begin(), dataA.end(), dataB.begin(), dataB.end())) return hk::ResultSuccess();
+
+	if (a.getFormat() == archive::Format::Byml && b.getFormat() == archive::Format::Byml)
+		return diffByml(job.numChanges, out, dataA, dataB, path);
+
+	if (a.getFormat() != archive::Format::Sarc || b.getFormat() != archive::Format::Sarc || depth >= cMaxArchiveDepth) {
+		reportFile(out, '~', path);
+		job.numChanges++;
+		return hk::ResultSuccess();
+	}
+
+	sarc::EntryTable tableA;
+	sarc::EntryTable tableB;
+	HK_TRY(tableA.init(dataA));
+	HK_TRY(tableB.init(dataB));
+
+	EntryMap entriesA;
+	EntryMap entriesB;
+	mapEntries(entriesA, tableA);
+	mapEntries(entriesB, tableB);
+
+	std::set<std::string> names;
+	for (const auto& [name, entry] : entriesA)
+		names.insert(name);
+	for (const auto& [name, entry] : entriesB)
+		names.insert(name);
+
+	for (const std::string& name : names) {
+		const std::string entryPath = joinPath(path, name);
+		auto itA = entriesA.find(name);
+		auto itB = entriesB.find(name);
+
+		if (itA == entriesA.end() || itB == entriesB.end()) {
+			reportFile(out, itA == entriesA.end() ? '+' : '-', entryPath);
+			job.numChanges++;
+			continue;
+		}
+
+		const sarc::EntryInfo& entryA = *itA->second;
+		const sarc::EntryInfo& entryB = *itB->second;
+		if (entryA.end > dataA.size() || entryB.end > dataB.size()) return utils::ResultSarcInvalidHeader();
+
+		archive::File innerA;
+		archive::File innerB;
+		HK_TRY(innerA.open({ dataA.begin() + entryA.start, dataA.begin() + entryA.end }, dictionaries));
+		HK_TRY(innerB.open({ dataB.begin() + entryB.start, dataB.begin() + entryB.end }, dictionaries));
+		HK_TRY(diffFiles(job, out, entryPath, innerA, innerB, dictionaries, depth + 1));
+	}
+
+	return hk::ResultSuccess();
+}
+
+void listFiles(std::set<fs::path>& out, const fs::path& dir) {
+	for (const auto& entry : fs::recursive_directory_iterator(dir))
+		if (entry.is_regular_file()) out.insert(fs::relative(entry.path(), dir));
+}
+
+} // namespace
+
+hk::Result diffByml(
+	u64& numChanges, json::Writer& out, std::span<const u8> a, std::span<const u8> b, const std::string& prefix
+) {
+	byml::Document documentA;
+	byml::Document documentB;
+	HK_TRY(documentA.init(a));
+	HK_TRY(documentB.init(b));
+
+	Differ differ(out, documentA, documentB);
+	return differ.run(numChanges, prefix);
+}
+
+hk::Result diffTrees(
+	json::Writer& out, TreeStats& stats, const fs::path& a, const fs::path& b, const zs::DictionarySet* dictionaries,
+	ThreadPool& pool
+) {
+	if (!fs::is_directory(a) || !fs::is_directory(b)) return ResultDirNotFound();
+
+	std::set<fs::path> pathSet;
+	listFiles(pathSet, a);
+	listFiles(pathSet, b);
+	const std::vector<fs::path> relPaths(pathSet.begin(), pathSet.end());
+
+	// each job writes to its own buffer, and the buffers are printed in order at the end
+	std::vector<FileJob> jobs(relPaths.size());
+	pool.forEach(relPaths.size(), [&](size_t i) {
+		FileJob& job = jobs[i];
+		const Sink sink = makeVectorSink(job.output);
+		json::Writer writer(sink, false);
+
+		const std::string path = relPaths[i].generic_string();
+		const bool isInA = fs::is_regular_file(a / relPaths[i]);
+		const bool isInB = fs::is_regular_file(b / relPaths[i]);
+		if (!isInA || !isInB) {
+			reportFile(writer, isInA ? '-' : '+', path);
+			job.numChanges++;
+			job.result = writer.flush();
+			return;
+		}
+
+		archive::File fileA;
+		archive::File fileB;
+		job.result = fileA.open(a / relPaths[i], dictionaries);
+		if (job.result.succeeded()) job.result = fileB.open(b / relPaths[i], dictionaries);
+		if (job.result.succeeded()) job.result = diffFiles(job, writer, path, fileA, fileB, dictionaries, 0);
+
+		const hk::Result flushResult = writer.flush();
+		if (job.result.succeeded()) job.result = flushResult;
+	});
+
+	stats = {};
+	stats.numFiles = relPaths.size();
+	for (size_t i = 0; i < jobs.size(); i++) {
+		const FileJob& job = jobs[i];
+		out.raw({ reinterpret_cast<const char*>(job.output.data()), job.output.size() });
+		stats.numChanges += job.numChanges;
+		if (job.numChanges != 0) stats.numChangedFiles++;
+		if (job.result.failed()) stats.failures.push_back({ relPaths[i], job.result });
+	}
+
+	return out.getResult();
+}
+
+} // namespace diff
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "json.h"
+#include "pool.h"
+#include "zs.h"
+
+namespace diff {
+
+// what changed between two BYML documents, one line per change, with paths from the root (e.g.
+// `0/ObjectList/3/Translate/X`) prefixed by `prefix`:
+//   ~ path: old -> new
+//   - path: old
+//   + path: new
+// every container is hashed from its contents the first time it's compared (shared subtrees only once), so subtrees
+// that are the same on both sides are skipped without being walked. arrays are compared index by index
+hk::Result diffByml(
+	u64& numChanges, json::Writer& out, std::span<const u8> a, std::span<const u8> b, const std::string& prefix = ""
+);
+
+struct TreeFailure {
+	std::filesystem::path path;
+	hk::Result result;
+};
+
+struct TreeStats {
+	u64 numFiles = 0; // in either tree, with each archive counted once however many files it holds
+	u64 numChangedFiles = 0; // counted the same way
+	u64 numChanges = 0;
+	std::vector<TreeFailure> failures;
+};
+
+// diffs two directory trees, e.g. two versions of a romfs. archives are compared file by file, nested ones included,
+// and BYMLs value by value as in `diffByml`. anything else is only reported as changed (`~ path`), and files on one
+// side only as added or removed. romfs files are compared in parallel on `pool`, and the output is in path order
+hk::Result diffTrees(
+	json::Writer& out, TreeStats& stats, const std::filesystem::path& a, const std::filesystem::path& b,
+	const zs::DictionarySet* dictionaries, ThreadPool& pool
+);
+
+} // namespace diff
@@ -0,0 +1,137 @@
+#include "extract.h"
+
+#include <format>
+#include <functional>
+#include <set>
+#include <vector>
+
+#include "mizuna/results.h"
+#include "mizuna/util.h"
+#include "results.h"
+#include "sarc.h"
+
+#ifdef __linux__
+#include "fileio.h"
+#else
+#include <fstream>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace sarc {
+
+namespace {
+
+using WriteEntryFunc = std::function<hk::Result(const EntryInfo& entry, const fs::path& outPath)>;
+
+hk::Result extractEntries(
+	const EntryTable& table, const fs::path& outDir, ThreadPool* pool, const WriteEntryFunc& write
+) {
+	const std::vector<EntryInfo>& entries = table.getEntries();
+
+	std::vector<fs::path> outPaths(entries.size());
+	std::set<fs::path> dirs;
+	for (size_t i = 0; i < entries.size(); i++) {
+		HK_TRY(getEntryPath(outPaths[i], table, entries[i], outDir));
+		dirs.insert(outPaths[i].parent_path());
+	}
+
+	// creating directories from several threads at once only makes them race over the same parents
+	for (const fs::path& dir : dirs) {
+		std::error_code ec;
+		fs::create_directories(dir, ec);
+		if (ec) return ResultFileError();
+	}
+
+	std::vector<hk::Result> results(entries.size());
+	auto writeEntry = [&](size_t i) { results[i] = write(entries[i], outPaths[i]); };
+
+	if (pool)
+		pool->forEach(entries.size(), writeEntry);
+	else
+		for (size_t i = 0; i < entries.size(); i++)
+			writeEntry(i);
+
+	for (const hk::Result& result : results)
+		HK_TRY(result);
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result getEntryPath(fs::path& out, const EntryTable& table, const EntryInfo& entry, const fs::path& outDir) {
+	std::string_view name = table.getName(entry);
+	fs::path relPath = name.empty() ? fs::path(std::format("{:08x}.bin", entry.hash)) : fs::path(name);
+	relPath = relPath.lexically_normal();
+
+	// don't let a crafted name write outside of `outDir`
+	if (relPath.empty() || relPath.has_root_path() || *relPath.begin() == "..") return utils::ResultSarcInvalidHeader();
+
+	out = outDir / relPath;
+	return hk::ResultSuccess();
+}
+
+hk::Result writeEntryData(const fs::path& outPath, std::span<const u8> data) {
+#ifdef __linux__
+	fileio::FileDescriptor fd = fileio::openWrite(outPath);
+	if (!fd.isValid()) return ResultFileError();
+
+	return fileio::writeAll(fd.get(), data.data(), data.size(), 0);
+#else
+	std::ofstream file(outPath, std::ios::out | std::ios::binary);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	return file ? hk::ResultSuccess() : ResultFileError();
+#endif
+}
+
+hk::Result extractAll(std::span<const u8> archive, const fs::path& outDir, ThreadPool* pool) {
+	EntryTable table;
+	HK_TRY(table.init(archive));
+
+	for (const EntryInfo& entry : table.getEntries())
+		if (entry.end > archive.size()) return utils::ResultSarcInvalidHeader();
+
+	return extractEntries(table, outDir, pool, [&](const EntryInfo& entry, const fs::path& outPath) {
+		return writeEntryData(outPath, archive.subspan(entry.start, entry.end - entry.start));
+	});
+}
+
+hk::Result extractAllFromFile(const fs::path& archivePath, const fs::path& outDir, ThreadPool* pool) {
+#ifdef __linux__
+	fileio::FileDescriptor inFd = fileio::openRead(archivePath);
+	if (!inFd.isValid()) return ResultFileError();
+
+	std::error_code ec;
+	u64 archiveSize = fs::file_size(archivePath, ec);
+	if (ec || archiveSize < cArchiveHeaderSize) return utils::ResultSarcInvalidHeader();
+
+	u8 header[cArchiveHeaderSize];
+	HK_TRY(fileio::readAll(inFd.get(), header, cArchiveHeaderSize, 0));
+	u32 dataOffset = HK_TRY(EntryTable::readDataOffset(header));
+	if (dataOffset > archiveSize) return utils::ResultSarcInvalidHeader();
+
+	std::vector<u8> metadata(dataOffset);
+	HK_TRY(fileio::readAll(inFd.get(), metadata.data(), metadata.size(), 0));
+
+	EntryTable table;
+	HK_TRY(table.init(metadata));
+
+	for (const EntryInfo& entry : table.getEntries())
+		if (entry.end > archiveSize) return utils::ResultSarcInvalidHeader();
+
+	return extractEntries(table, outDir, pool, [&](const EntryInfo& entry, const fs::path& outPath) -> hk::Result {
+		fileio::FileDescriptor outFd = fileio::openWrite(outPath);
+		if (!outFd.isValid()) return ResultFileError();
+
+		return fileio::copyRange(inFd.get(), entry.start, outFd.get(), 0, entry.end - entry.start);
+	});
+#else
+	std::vector<u8> archive;
+	HK_TRY(util::readFile(archive, archivePath));
+
+	return extractAll(archive, outDir, pool);
+#endif
+}
+
+} // namespace sarc
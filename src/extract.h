@@ -0,0 +1,31 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <span>
+
+#include "pool.h"
+#include "sarc.h"
+
+namespace sarc {
+
+// where `entry` goes below `outDir`. entries without a name are written under their hash, and names that would lead
+// outside of `outDir` are rejected
+hk::Result getEntryPath(
+	std::filesystem::path& out, const EntryTable& table, const EntryInfo& entry, const std::filesystem::path& outDir
+);
+
+// creates or truncates `outPath`
+hk::Result writeEntryData(const std::filesystem::path& outPath, std::span<const u8> data);
+
+// writes every file in `archive` below `outDir` straight from the archive buffer. the directory tree is created up
+// front, then files are written in parallel on `pool`, or on the calling thread if it's null
+hk::Result extractAll(std::span<const u8> archive, const std::filesystem::path& outDir, ThreadPool* pool);
+
+// the same for an uncompressed archive on disk. only the metadata is read into memory; file data is copied by the
+// kernel with copy_file_range where that's available
+hk::Result extractAllFromFile(
+	const std::filesystem::path& archivePath, const std::filesystem::path& outDir, ThreadPool* pool
+);
+
+} // namespace sarc
@@ -0,0 +1,96 @@
+#include "fileio.h"
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <hk/ValueOrResult.h>
+#include <unistd.h>
+#include <vector>
+
+#include "mizuna/results.h"
+
+namespace fileio {
+
+namespace {
+
+constexpr size_t cCopyChunkSize = 0x10000;
+
+} // namespace
+
+FileDescriptor::~FileDescriptor() {
+	if (mFd >= 0) close(mFd);
+}
+
+FileDescriptor openRead(const std::filesystem::path& path) {
+	return FileDescriptor(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+}
+
+FileDescriptor openWrite(const std::filesystem::path& path) {
+	return FileDescriptor(open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+}
+
+hk::Result preallocate(s32 fd, u64 size) {
+	// not every filesystem supports fallocate, but a plain resize is still better than growing the file piecemeal
+	if (fallocate(fd, 0, 0, size) != 0 && ftruncate(fd, size) != 0) return ResultFileError();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result readAll(s32 fd, u8* data, size_t size, off_t offset) {
+	while (size > 0) {
+		ssize_t numRead = pread(fd, data, size, offset);
+		if (numRead < 0 && errno == EINTR) continue;
+		if (numRead <= 0) return ResultFileError();
+
+		data += numRead;
+		size -= numRead;
+		offset += numRead;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result writeAll(s32 fd, const u8* data, size_t size, off_t offset) {
+	while (size > 0) {
+		ssize_t written = pwrite(fd, data, size, offset);
+		if (written < 0 && errno == EINTR) continue;
+		if (written <= 0) return ResultFileError();
+
+		data += written;
+		size -= written;
+		offset += written;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result copyRange(s32 inFd, off_t inOffset, s32 outFd, off_t outOffset, size_t size) {
+	while (size > 0) {
+		ssize_t copied = copy_file_range(inFd, &inOffset, outFd, &outOffset, size, 0);
+		if (copied < 0 && errno == EINTR) continue;
+		// older kernels and some filesystem pairs can't do this, in which case the rest is copied by hand
+		if (copied < 0) break;
+		if (copied == 0) return ResultFileError();
+
+		size -= copied;
+	}
+
+	std::vector<u8> buffer(std::min(size, cCopyChunkSize));
+	while (size > 0) {
+		size_t chunkSize = std::min(size, buffer.size());
+		HK_TRY(readAll(inFd, buffer.data(), chunkSize, inOffset));
+		HK_TRY(writeAll(outFd, buffer.data(), chunkSize, outOffset));
+
+		inOffset += chunkSize;
+		outOffset += chunkSize;
+		size -= chunkSize;
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace fileio
+
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <sys/types.h>
+
+// thin wrappers over file descriptors, for the places where positioned or kernel-side copies pay off
+namespace fileio {
+
+class FileDescriptor {
+public:
+	explicit FileDescriptor(s32 fd) : mFd(fd) {}
+
+	~FileDescriptor();
+
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+	bool isValid() const { return mFd >= 0; }
+
+	s32 get() const { return mFd; }
+
+private:
+	s32 mFd;
+};
+
+FileDescriptor openRead(const std::filesystem::path& path);
+
+// creates or truncates `path`
+FileDescriptor openWrite(const std::filesystem::path& path);
+
+// sizes the file up front so its blocks can be allocated in one go, then filled in any order
+hk::Result preallocate(s32 fd, u64 size);
+
+// fails unless exactly `size` bytes could be read, e.g. if the file is shorter than expected
+hk::Result readAll(s32 fd, u8* data, size_t size, off_t offset);
+hk::Result writeAll(s32 fd, const u8* data, size_t size, off_t offset);
+
+// copies with copy_file_range, falling back to reading and writing if the kernel or filesystem won't
+hk::Result copyRange(s32 inFd, off_t inOffset, s32 outFd, off_t outOffset, size_t size);
+
+} // namespace fileio
+
+#endif
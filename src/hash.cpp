@@ -0,0 +1,109 @@
+#include "hash.h"
+
+#include <algorithm>
+#include <bit>
+
+#include "binary.h"
+
+namespace hash {
+
+namespace {
+
+constexpr u64 cPrime1 = 0x9e3779b185ebca87;
+constexpr u64 cPrime2 = 0xc2b2ae3d27d4eb4f;
+constexpr u64 cPrime3 = 0x165667b19e3779f9;
+constexpr u64 cPrime4 = 0x85ebca77c2b2ae63;
+constexpr u64 cPrime5 = 0x27d4eb2f165667c5;
+
+// only needs to differ from the first seed, and to stay the same for as long as digests are kept
+constexpr u64 cSecondSeed = 0x6d697a756e61;
+
+u64 round(u64 acc, u64 input) {
+	acc += input * cPrime2;
+	acc = std::rotl(acc, 31);
+	return acc * cPrime1;
+}
+
+u64 mergeRound(u64 acc, u64 value) {
+	acc ^= round(0, value);
+	return acc * cPrime1 + cPrime4;
+}
+
+} // namespace
+
+Xxh64::Xxh64(u64 seed)
+	: mSeed(seed), mAcc { seed + cPrime1 + cPrime2, seed + cPrime2, seed, seed - cPrime1 } {}
+
+void Xxh64::consumeStripe(const u8* stripe) {
+	for (size_t i = 0; i < mAcc.size(); i++)
+		mAcc[i] = round(mAcc[i], bin::readLE<u64>(stripe + i * 8));
+}
+
+void Xxh64::update(std::span<const u8> data) {
+	const u8* p = data.data();
+	const u8* end = p + data.size();
+	mSize += data.size();
+
+	// a stripe started by an earlier piece is finished first
+	if (mBufferSize != 0) {
+		const size_t size = std::min<size_t>(end - p, cStripeSize - mBufferSize);
+		std::copy_n(p, size, mBuffer.data() + mBufferSize);
+		mBufferSize += size;
+		p += size;
+		if (mBufferSize < cStripeSize) return;
+
+		consumeStripe(mBuffer.data());
+		mBufferSize = 0;
+	}
+
+	for (; size_t(end - p) >= cStripeSize; p += cStripeSize)
+		consumeStripe(p);
+
+	std::copy(p, end, mBuffer.data());
+	mBufferSize = end - p;
+}
+
+u64 Xxh64::digest() const {
+	u64 h;
+	if (mSize >= cStripeSize) {
+		h = std::rotl(mAcc[0], 1) + std::rotl(mAcc[1], 7) + std::rotl(mAcc[2], 12) + std::rotl(mAcc[3], 18);
+		for (const u64 acc : mAcc)
+			h = mergeRound(h, acc);
+	} else {
+		h = mSeed + cPrime5;
+	}
+
+	h += mSize;
+
+	// what's left after the last full stripe
+	const u8* p = mBuffer.data();
+	const u8* end = p + mBufferSize;
+	for (; end - p >= 8; p += 8)
+		h = std::rotl(h ^ round(0, bin::readLE<u64>(p)), 27) * cPrime1 + cPrime4;
+	if (end - p >= 4) {
+		h = std::rotl(h ^ (bin::readLE<u32>(p) * cPrime1), 23) * cPrime2 + cPrime3;
+		p += 4;
+	}
+	for (; p < end; p++)
+		h = std::rotl(h ^ (*p * cPrime5), 11) * cPrime1;
+
+	h ^= h >> 33;
+	h *= cPrime2;
+	h ^= h >> 29;
+	h *= cPrime3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+u64 xxh64(std::span<const u8> data, u64 seed) {
+	Xxh64 state(seed);
+	state.update(data);
+	return state.digest();
+}
+
+Digest128 key(std::span<const u8> data) {
+	return { xxh64(data), xxh64(data, cSecondSeed) };
+}
+
+} // namespace hash
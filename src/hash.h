@@ -0,0 +1,46 @@
+#pragma once
+
+#include <array>
+#include <compare>
+#include <hk/types.h>
+#include <span>
+
+namespace hash {
+
+// XXH64, fast enough to hash every file of a romfs without slowing extraction down
+u64 xxh64(std::span<const u8> data, u64 seed = 0);
+
+// the same, for data that arrives in pieces, e.g. on its way to a sink. gives what `xxh64` gives for all of it at once
+class Xxh64 {
+public:
+	explicit Xxh64(u64 seed = 0);
+
+	void update(std::span<const u8> data);
+	u64 digest() const;
+
+private:
+	static constexpr size_t cStripeSize = 32;
+
+	void consumeStripe(const u8* stripe);
+
+	const u64 mSeed;
+	std::array<u64, 4> mAcc;
+	std::array<u8, cStripeSize> mBuffer; // the start of a stripe that hasn't arrived in full yet
+	size_t mBufferSize = 0;
+	u64 mSize = 0;
+};
+
+// two XXH64s of the same data with different seeds, which is what data is deduplicated and compared by. at 128 bits,
+// two different inputs meeting by chance is too unlikely to matter, even across billions of them, so this alone is
+// trusted where a collision would only make a report wrong. where it would make output wrong, the bytes are compared
+// as well
+struct Digest128 {
+	u64 a;
+	u64 b;
+
+	auto operator<=>(const Digest128& other) const = default;
+};
+
+Digest128 key(std::span<const u8> data);
+
+} // namespace hash
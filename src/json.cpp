@@ -0,0 +1,785 @@
+#include "json.h"
+
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <hk/ValueOrResult.h>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace json {
+
+namespace {
+
+constexpr char cHexDigits[] = "0123456789abcdef";
+
+constexpr char cBase64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+constexpr std::pair<byml::NodeType, std::string_view> cTypeTags[] = {
+	{ byml::NodeType::U32, "!u32" }, { byml::NodeType::S64, "!s64" },       { byml::NodeType::U64, "!u64" },
+	{ byml::NodeType::F64, "!f64" }, { byml::NodeType::Binary, "!binary" },
+};
+
+} // namespace
+
+Writer::Writer(Sink sink, bool isPretty) : mSink(std::move(sink)), mIsPretty(isPretty) {}
+
+void Writer::put(std::string_view str) {
+	while (!str.empty()) {
+		if (mPos == mBuffer.size()) drain();
+
+		const size_t size = std::min(str.size(), mBuffer.size() - mPos);
+		std::copy_n(str.data(), size, mBuffer.data() + mPos);
+		mPos += size;
+		str.remove_prefix(size);
+	}
+}
+
+void Writer::drain() {
+	if (mResult.succeeded() && mPos != 0)
+		mResult = mSink({ reinterpret_cast<const u8*>(mBuffer.data()), mPos });
+	mPos = 0;
+}
+
+hk::Result Writer::flush() {
+	drain();
+	return mResult;
+}
+
+void Writer::separate() {
+	if (mIsAfterKey) {
+		mIsAfterKey = false;
+		return;
+	}
+	if (mDepth == 0) return;
+
+	if (!mIsFirst) put(',');
+	mIsFirst = false;
+
+	if (mIsPretty) {
+		put('\n');
+		for (u32 i = 0; i < mDepth; i++)
+			put('\t');
+	}
+}
+
+void Writer::begin(char bracket) {
+	separate();
+	put(bracket);
+	mDepth++;
+	mIsFirst = true;
+}
+
+void Writer::end(char bracket) {
+	mDepth--;
+
+	// empty containers stay on one line
+	if (mIsPretty && !mIsFirst) {
+		put('\n');
+		for (u32 i = 0; i < mDepth; i++)
+			put('\t');
+	}
+
+	put(bracket);
+	mIsFirst = false;
+}
+
+void Writer::beginArray() {
+	begin('[');
+}
+
+void Writer::endArray() {
+	end(']');
+}
+
+void Writer::beginObject() {
+	begin('{');
+}
+
+void Writer::endObject() {
+	end('}');
+}
+
+void Writer::key(std::string_view key) {
+	string(key);
+	put(':');
+	if (mIsPretty) put(' ');
+	mIsAfterKey = true;
+}
+
+void Writer::string(std::string_view value) {
+	separate();
+	put('"');
+
+	// runs of characters that need no escaping are copied in one go
+	size_t start = 0;
+	for (size_t i = 0; i < value.size(); i++) {
+		const u8 c = value[i];
+		if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+		put(value.substr(start, i - start));
+		start = i + 1;
+
+		put('\\');
+		switch (c) {
+		case '"': put('"'); break;
+		case '\\': put('\\'); break;
+		case '\b': put('b'); break;
+		case '\f': put('f'); break;
+		case '\n': put('n'); break;
+		case '\r': put('r'); break;
+		case '\t': put('t'); break;
+		default:
+			put("u00");
+			put(cHexDigits[c >> 4]);
+			put(cHexDigits[c & 0xf]);
+			break;
+		}
+	}
+	put(value.substr(start));
+
+	put('"');
+}
+
+void Writer::binary(std::span<const u8> data) {
+	separate();
+	put('"');
+
+	size_t i = 0;
+	for (; i + 3 <= data.size(); i += 3) {
+		const u32 group = data[i] << 16 | data[i + 1] << 8 | data[i + 2];
+		put(cBase64Digits[group >> 18]);
+		put(cBase64Digits[group >> 12 & 0x3f]);
+		put(cBase64Digits[group >> 6 & 0x3f]);
+		put(cBase64Digits[group & 0x3f]);
+	}
+
+	if (i < data.size()) {
+		const bool isPair = i + 2 == data.size();
+		const u32 group = data[i] << 16 | (isPair ? data[i + 1] << 8 : 0);
+		put(cBase64Digits[group >> 18]);
+		put(cBase64Digits[group >> 12 & 0x3f]);
+		put(isPair ? cBase64Digits[group >> 6 & 0x3f] : '=');
+		put('=');
+	}
+
+	put('"');
+}
+
+void Writer::boolean(bool value) {
+	separate();
+	put(value ? "true" : "false");
+}
+
+void Writer::integer(s64 value) {
+	separate();
+	char buf[24];
+	put({ buf, std::to_chars(buf, buf + sizeof(buf), value).ptr });
+}
+
+void Writer::integer(u64 value) {
+	separate();
+	char buf[24];
+	put({ buf, std::to_chars(buf, buf + sizeof(buf), value).ptr });
+}
+
+template <typename T>
+void Writer::putFloat(T value) {
+	separate();
+
+	// JSON has no way to write these
+	if (!std::isfinite(value)) {
+		put("null");
+		return;
+	}
+
+	// the shortest text that reads back as the same value. whole numbers keep a `.0` so they still read as floats
+	char buf[32];
+	const std::string_view text(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr);
+	put(text);
+	if (text.find_first_of(".e") == std::string_view::npos) put(".0");
+}
+
+void Writer::number(f32 value) {
+	putFloat(value);
+}
+
+void Writer::number(f64 value) {
+	putFloat(value);
+}
+
+void Writer::null() {
+	separate();
+	put("null");
+}
+
+void Writer::beginTagged(std::string_view tag) {
+	separate();
+	put("{\"");
+	put(tag);
+	put("\":");
+	if (mIsPretty) put(' ');
+	mIsAfterKey = true;
+}
+
+void Writer::endTagged() {
+	put('}');
+}
+
+void Writer::newline() {
+	put('\n');
+}
+
+void Writer::raw(std::string_view text) {
+	put(text);
+}
+
+namespace {
+
+// the input, a buffer at a time
+class Lexer {
+public:
+	explicit Lexer(std::istream& in) : mIn(in) {}
+
+	// -1 at the end of the input
+	s32 peek() {
+		if (mPos == mEnd && !refill()) return -1;
+		return u8(mBuffer[mPos]);
+	}
+
+	s32 get() {
+		const s32 c = peek();
+		if (c >= 0) mPos++;
+		return c;
+	}
+
+	// the next character that isn't whitespace
+	s32 skipSpace() {
+		s32 c = peek();
+		while (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+			mPos++;
+			c = peek();
+		}
+		return c;
+	}
+
+	bool expect(std::string_view text) {
+		for (char c : text)
+			if (get() != u8(c)) return false;
+		return true;
+	}
+
+	hk::Result readString(std::string& out);
+	hk::Result readNumber(std::string& out);
+
+private:
+	static constexpr size_t cBufferSize = 64 * 1024;
+
+	bool refill() {
+		mIn.read(mBuffer.data(), mBuffer.size());
+		mPos = 0;
+		mEnd = mIn.gcount();
+		return mEnd != 0;
+	}
+
+	hk::ValueOrResult<u32> readHex4();
+
+	std::istream& mIn;
+	std::array<char, cBufferSize> mBuffer;
+	size_t mPos = 0;
+	size_t mEnd = 0;
+};
+
+hk::ValueOrResult<u32> Lexer::readHex4() {
+	u32 value = 0;
+	for (s32 i = 0; i < 4; i++) {
+		const s32 c = get();
+		u32 digit;
+		if (c >= '0' && c <= '9')
+			digit = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			digit = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			digit = c - 'A' + 10;
+		else
+			return utils::ResultJsonInvalidSyntax();
+		value = value << 4 | digit;
+	}
+	return value;
+}
+
+void appendUtf8(std::string& out, u32 codepoint) {
+	if (codepoint < 0x80) {
+		out += char(codepoint);
+	} else if (codepoint < 0x800) {
+		out += char(0xc0 | codepoint >> 6);
+		out += char(0x80 | (codepoint & 0x3f));
+	} else if (codepoint < 0x10000) {
+		out += char(0xe0 | codepoint >> 12);
+		out += char(0x80 | (codepoint >> 6 & 0x3f));
+		out += char(0x80 | (codepoint & 0x3f));
+	} else {
+		out += char(0xf0 | codepoint >> 18);
+		out += char(0x80 | (codepoint >> 12 & 0x3f));
+		out += char(0x80 | (codepoint >> 6 & 0x3f));
+		out += char(0x80 | (codepoint & 0x3f));
+	}
+}
+
+// the opening quote has already been read
+hk::Result Lexer::readString(std::string& out) {
+	out.clear();
+	while (true) {
+		// runs of plain characters are copied straight out of the buffer
+		size_t start = mPos;
+		while (mPos != mEnd && mBuffer[mPos] != '"' && mBuffer[mPos] != '\\' && u8(mBuffer[mPos]) >= 0x20)
+			mPos++;
+		out.append(mBuffer.data() + start, mPos - start);
+
+		const s32 c = get();
+		if (c == '"') return hk::ResultSuccess();
+		// control characters have to be escaped, and -1 is the end of the input
+		if (c < 0x20) return utils::ResultJsonInvalidSyntax();
+		if (c != '\\') {
+			// the buffer ran out in the middle of a run
+			out += char(c);
+			continue;
+		}
+
+		switch (get()) {
+		case '"': out += '"'; break;
+		case '\\': out += '\\'; break;
+		case '/': out += '/'; break;
+		case 'b': out += '\b'; break;
+		case 'f': out += '\f'; break;
+		case 'n': out += '\n'; break;
+		case 'r': out += '\r'; break;
+		case 't': out += '\t'; break;
+		case 'u': {
+			u32 codepoint = HK_TRY(readHex4());
+			if (codepoint >= 0xd800 && codepoint < 0xdc00) {
+				// the high half of a surrogate pair, which has to be followed by the low half
+				if (!expect("\\u")) return utils::ResultJsonInvalidSyntax();
+				const u32 low = HK_TRY(readHex4());
+				if (low < 0xdc00 || low >= 0xe000) return utils::ResultJsonInvalidSyntax();
+				codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+			} else if (codepoint >= 0xdc00 && codepoint < 0xe000) {
+				return utils::ResultJsonInvalidSyntax();
+			}
+			appendUtf8(out, codepoint);
+			break;
+		}
+		default: return utils::ResultJsonInvalidSyntax();
+		}
+	}
+}
+
+bool isDigit(s32 c) {
+	return c >= '0' && c <= '9';
+}
+
+// checks the number against JSON's grammar as it goes: -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+hk::Result Lexer::readNumber(std::string& out) {
+	out.clear();
+
+	auto digits = [&] {
+		if (!isDigit(peek())) return false;
+		while (isDigit(peek()))
+			out += char(get());
+		return true;
+	};
+
+	if (peek() == '-') out += char(get());
+	if (peek() == '0')
+		out += char(get());
+	else if (!digits())
+		return utils::ResultJsonInvalidSyntax();
+
+	if (peek() == '.') {
+		out += char(get());
+		if (!digits()) return utils::ResultJsonInvalidSyntax();
+	}
+
+	if (peek() == 'e' || peek() == 'E') {
+		out += char(get());
+		if (peek() == '+' || peek() == '-') out += char(get());
+		if (!digits()) return utils::ResultJsonInvalidSyntax();
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result parse(std::istream& in, Handler& handler) {
+	Lexer lexer(in);
+
+	// whether each open container is an object
+	std::vector<bool> stack;
+	std::string text;
+
+	// the value at the top, then one per iteration: a value is read, or a container closed
+	bool isValueNext = true;
+	while (true) {
+		s32 c = lexer.skipSpace();
+
+		if (!isValueNext) {
+			// after a value: the end of the document, a comma or the end of a container
+			if (stack.empty()) break;
+
+			const bool isObject = stack.back();
+			lexer.get();
+			if (c == (isObject ? '}' : ']')) {
+				stack.pop_back();
+				HK_TRY(isObject ? handler.endObject() : handler.endArray());
+				continue;
+			}
+			if (c != ',') return utils::ResultJsonInvalidSyntax();
+			c = lexer.skipSpace();
+		}
+
+		if (!stack.empty() && stack.back()) {
+			if (lexer.get() != '"') return utils::ResultJsonInvalidSyntax();
+			HK_TRY(lexer.readString(text));
+			HK_TRY(handler.key(text));
+			if (lexer.skipSpace() != ':') return utils::ResultJsonInvalidSyntax();
+			lexer.get();
+			c = lexer.skipSpace();
+		}
+
+		isValueNext = false;
+		switch (c) {
+		case '{':
+		case '[': {
+			lexer.get();
+			const bool isObject = c == '{';
+			HK_TRY(isObject ? handler.beginObject() : handler.beginArray());
+
+			// empty containers close straight away, anything else is read as the next value
+			if (lexer.skipSpace() == (isObject ? '}' : ']')) {
+				lexer.get();
+				HK_TRY(isObject ? handler.endObject() : handler.endArray());
+			} else {
+				stack.push_back(isObject);
+				isValueNext = true;
+			}
+			break;
+		}
+		case '"': {
+			lexer.get();
+			HK_TRY(lexer.readString(text));
+			HK_TRY(handler.string(text));
+			break;
+		}
+		case 't': {
+			if (!lexer.expect("true")) return utils::ResultJsonInvalidSyntax();
+			HK_TRY(handler.boolean(true));
+			break;
+		}
+		case 'f': {
+			if (!lexer.expect("false")) return utils::ResultJsonInvalidSyntax();
+			HK_TRY(handler.boolean(false));
+			break;
+		}
+		case 'n': {
+			if (!lexer.expect("null")) return utils::ResultJsonInvalidSyntax();
+			HK_TRY(handler.null());
+			break;
+		}
+		default: {
+			if (c != '-' && !isDigit(c)) return utils::ResultJsonInvalidSyntax();
+			HK_TRY(lexer.readNumber(text));
+			HK_TRY(handler.number(text));
+			break;
+		}
+		}
+	}
+
+	// nothing but whitespace may follow the document
+	return lexer.skipSpace() == -1 ? hk::ResultSuccess() : utils::ResultJsonInvalidSyntax();
+}
+
+std::string_view getTypeTag(byml::NodeType type) {
+	for (const auto& [tagType, tag] : cTypeTags)
+		if (tagType == type) return tag;
+	return {};
+}
+
+byml::NodeType findTypeTag(std::string_view tag) {
+	for (const auto& [type, tagText] : cTypeTags)
+		if (tagText == tag) return type;
+	return byml::NodeType::Null;
+}
+
+hk::Result decodeBase64(std::vector<u8>& out, std::string_view text) {
+	out.clear();
+	if (text.size() % 4 != 0) return utils::ResultJsonInvalidSyntax();
+	out.reserve(text.size() / 4 * 3);
+
+	for (size_t i = 0; i < text.size(); i += 4) {
+		u32 group = 0;
+		u32 numPadding = 0;
+		for (size_t j = 0; j < 4; j++) {
+			const char c = text[i + j];
+			// only the last two characters of the last group may be padding, and nothing but padding may follow it
+			const bool isPadding = c == '=' && j >= 2 && i + 4 == text.size();
+			const char* digit = c == '\0' ? nullptr : std::strchr(cBase64Digits, c);
+			if (isPadding)
+				numPadding++;
+			else if (!digit || numPadding != 0)
+				return utils::ResultJsonInvalidSyntax();
+			group = group << 6 | (isPadding ? 0 : u32(digit - cBase64Digits));
+		}
+
+		out.push_back(group >> 16);
+		if (numPadding < 2) out.push_back(group >> 8);
+		if (numPadding < 1) out.push_back(group);
+	}
+
+	return hk::ResultSuccess();
+}
+
+namespace {
+
+// whether a value of `type` would be read back as another type without its tag
+bool isTagNeeded(byml::NodeType type, u64 bits) {
+	switch (type) {
+	case byml::NodeType::U32: return bits <= u64(std::numeric_limits<s32>::max());
+	case byml::NodeType::S64:
+		return s64(bits) >= std::numeric_limits<s32>::min() && s64(bits) <= s64(std::numeric_limits<u32>::max());
+	case byml::NodeType::U64: return bits <= u64(std::numeric_limits<s64>::max());
+	case byml::NodeType::F64: {
+		// JSON has no way to write these, and they come back as null whatever their tag
+		const f64 value = std::bit_cast<f64>(bits);
+		if (!std::isfinite(value)) return false;
+
+		// `byml::parseNumber` reads a float as an F32 if the shortest text of the nearest F32 reads back the same
+		const f32 single = f32(value);
+		if (!std::isfinite(single)) return false;
+
+		char buf[32];
+		f64 roundTrip;
+		std::from_chars(buf, std::to_chars(buf, buf + sizeof(buf), single).ptr, roundTrip);
+		return roundTrip == value;
+	}
+	case byml::NodeType::Binary: return true;
+	default: return false;
+	}
+}
+
+// any value that isn't a container, string or binary, by its type and bits as in `byml::Number`
+hk::Result writeScalar(Writer& writer, byml::NodeType type, u64 bits) {
+	const bool isTagged = isTagNeeded(type, bits);
+	if (isTagged) writer.beginTagged(getTypeTag(type));
+
+	switch (type) {
+	case byml::NodeType::Bool: writer.boolean(bits != 0); break;
+	case byml::NodeType::S32: writer.integer(s64(s32(bits))); break;
+	case byml::NodeType::F32: writer.number(std::bit_cast<f32>(u32(bits))); break;
+	case byml::NodeType::U32:
+	case byml::NodeType::U64: writer.integer(bits); break;
+	case byml::NodeType::S64: writer.integer(s64(bits)); break;
+	case byml::NodeType::F64: writer.number(std::bit_cast<f64>(bits)); break;
+	case byml::NodeType::Null: writer.null(); break;
+	default: return byml::ResultInvalidNodeType();
+	}
+
+	if (isTagged) writer.endTagged();
+	return hk::ResultSuccess();
+}
+
+void writeBinary(Writer& writer, std::span<const u8> data) {
+	writer.beginTagged(getTypeTag(byml::NodeType::Binary));
+	writer.binary(data);
+	writer.endTagged();
+}
+
+} // namespace
+
+hk::Result writeByml(Writer& writer, const byml::Reader& root) {
+	struct Frame {
+		byml::Reader node;
+		u32 index;
+		u32 size;
+		bool isHash;
+	};
+
+	std::vector<Frame> stack;
+
+	auto enter = [&](const byml::Reader& node) -> hk::Result {
+		const byml::NodeType type = HK_TRY(node.getType());
+		if (type == byml::NodeType::Array)
+			writer.beginArray();
+		else if (type == byml::NodeType::Hash)
+			writer.beginObject();
+		else
+			return byml::ResultInvalidNodeType();
+
+		stack.push_back({ node, 0, node.getSize(), type == byml::NodeType::Hash });
+		return hk::ResultSuccess();
+	};
+
+	HK_TRY(enter(root));
+
+	// reused for every value, so walking the document allocates nothing once they have grown
+	std::string key;
+	std::string str;
+	std::vector<u8> binary;
+
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		if (frame.index == frame.size) {
+			if (frame.isHash)
+				writer.endObject();
+			else
+				writer.endArray();
+			stack.pop_back();
+			continue;
+		}
+
+		const byml::Reader& node = frame.node;
+		const u32 i = frame.index++;
+
+		if (frame.isHash) {
+			HK_TRY(node.getKeyByIdx(&key, i));
+			writer.key(key);
+		}
+
+		switch (HK_TRY(node.getTypeByIdx(i))) {
+		case byml::NodeType::Array:
+		case byml::NodeType::Hash: {
+			byml::Reader container;
+			HK_TRY(node.getContainerByIdx(&container, i));
+			// invalidates `frame`
+			HK_TRY(enter(container));
+			break;
+		}
+		case byml::NodeType::String: {
+			HK_TRY(node.getStringByIdx(&str, i));
+			writer.string(str);
+			break;
+		}
+		case byml::NodeType::Binary: {
+			HK_TRY(node.getBinaryByIdx(&binary, i));
+			writeBinary(writer, binary);
+			break;
+		}
+		case byml::NodeType::Bool: {
+			bool value;
+			HK_TRY(node.getBoolByIdx(&value, i));
+			writer.boolean(value);
+			break;
+		}
+		case byml::NodeType::S32: {
+			s32 value;
+			HK_TRY(node.getS32ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::S32, u32(value)));
+			break;
+		}
+		case byml::NodeType::F32: {
+			f32 value;
+			HK_TRY(node.getF32ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::F32, std::bit_cast<u32>(value)));
+			break;
+		}
+		case byml::NodeType::U32: {
+			u32 value;
+			HK_TRY(node.getU32ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::U32, value));
+			break;
+		}
+		case byml::NodeType::S64: {
+			s64 value;
+			HK_TRY(node.getS64ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::S64, u64(value)));
+			break;
+		}
+		case byml::NodeType::U64: {
+			u64 value;
+			HK_TRY(node.getU64ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::U64, value));
+			break;
+		}
+		case byml::NodeType::F64: {
+			f64 value;
+			HK_TRY(node.getF64ByIdx(&value, i));
+			HK_TRY(writeScalar(writer, byml::NodeType::F64, std::bit_cast<u64>(value)));
+			break;
+		}
+		case byml::NodeType::Null: {
+			writer.null();
+			break;
+		}
+		case byml::NodeType::StringTable: {
+			return byml::ResultInvalidNodeType();
+		}
+		}
+
+		HK_TRY(writer.getResult());
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result writeNode(Writer& writer, const byml::Document& document, byml::Node node) {
+	struct Frame {
+		byml::Node container;
+		u32 index;
+		u32 size;
+	};
+
+	std::vector<Frame> stack;
+
+	auto write = [&](byml::Node node) -> hk::Result {
+		switch (node.type) {
+		case byml::NodeType::Array:
+		case byml::NodeType::Hash: {
+			const u32 size = HK_TRY(document.getSize(node));
+			if (node.type == byml::NodeType::Hash)
+				writer.beginObject();
+			else
+				writer.beginArray();
+			stack.push_back({ node, 0, size });
+			break;
+		}
+		case byml::NodeType::String: writer.string(HK_TRY(document.getString(node.value))); break;
+		case byml::NodeType::Binary: writeBinary(writer, HK_TRY(document.getBinary(node))); break;
+		case byml::NodeType::S64:
+		case byml::NodeType::U64:
+		case byml::NodeType::F64: HK_TRY(writeScalar(writer, node.type, HK_TRY(document.get64(node)))); break;
+		default: HK_TRY(writeScalar(writer, node.type, node.value)); break;
+		}
+		return hk::ResultSuccess();
+	};
+
+	HK_TRY(write(node));
+
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		if (frame.index == frame.size) {
+			if (frame.container.type == byml::NodeType::Hash)
+				writer.endObject();
+			else
+				writer.endArray();
+			stack.pop_back();
+			continue;
+		}
+
+		u32 key;
+		const byml::Node entry = HK_TRY(document.getEntry(frame.container, frame.index++, &key));
+		if (frame.container.type == byml::NodeType::Hash) writer.key(HK_TRY(document.getKey(key)));
+
+		// may invalidate `frame`
+		HK_TRY(write(entry));
+		HK_TRY(writer.getResult());
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace json
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <hk/Result.h>
+#include <istream>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "byml.h"
+#include "mizuna/byml/reader.h"
+#include "stream.h"
+
+namespace json {
+
+// JSON text handed to a sink through a fixed-size buffer, so the document never has to fit in memory. a failed write
+// is kept and reported by `getResult` and `flush`, after which everything else is dropped
+class Writer {
+public:
+	// `isPretty` puts every value on its own line, indented with tabs. otherwise the output has no whitespace at all
+	explicit Writer(Sink sink, bool isPretty = true);
+
+	void beginArray();
+	void endArray();
+	void beginObject();
+	void endObject();
+
+	// the key of the next value in the current object
+	void key(std::string_view key);
+
+	void string(std::string_view value);
+	void binary(std::span<const u8> data); // as a base64 string
+	void boolean(bool value);
+	void integer(s64 value);
+	void integer(u64 value);
+	void number(f32 value);
+	void number(f64 value);
+	void null();
+
+	// a value tagged with its type, as an object with the tag as its only key, e.g. `{"!u32": 5}`. the value goes
+	// between the two calls, and the whole thing stays on one line
+	void beginTagged(std::string_view tag);
+	void endTagged();
+
+	// a newline between top-level values, e.g. for NDJSON
+	void newline();
+
+	// text that goes into the output as is, e.g. around top-level values
+	void raw(std::string_view text);
+
+	hk::Result getResult() const { return mResult; }
+
+	hk::Result flush();
+
+private:
+	static constexpr size_t cBufferSize = 64 * 1024;
+
+	// the comma, newline and indent that go before a value
+	void separate();
+	void begin(char bracket);
+	void end(char bracket);
+
+	template <typename T>
+	void putFloat(T value);
+
+	void put(char c) {
+		if (mPos == mBuffer.size()) drain();
+		mBuffer[mPos++] = c;
+	}
+	void put(std::string_view str);
+	void drain();
+
+	const Sink mSink;
+	const bool mIsPretty;
+	hk::Result mResult = hk::ResultSuccess();
+
+	std::array<char, cBufferSize> mBuffer;
+	size_t mPos = 0;
+
+	u32 mDepth = 0;
+	bool mIsFirst = true;     // nothing written yet in the current container
+	bool mIsAfterKey = false; // the next value goes right after its key
+};
+
+// receives a document from `parse` one token at a time, in order. numbers are passed on as their text, so it's up to
+// the handler what type they become
+class Handler {
+public:
+	virtual ~Handler() = default;
+
+	virtual hk::Result beginArray() = 0;
+	virtual hk::Result endArray() = 0;
+	virtual hk::Result beginObject() = 0;
+	virtual hk::Result endObject() = 0;
+	virtual hk::Result key(std::string_view key) = 0;
+	virtual hk::Result string(std::string_view value) = 0;
+	virtual hk::Result number(std::string_view text) = 0;
+	virtual hk::Result boolean(bool value) = 0;
+	virtual hk::Result null() = 0;
+};
+
+// parses the one JSON document in `in`, which is read through a fixed-size buffer. nesting is tracked with an explicit
+// stack, so only the longest string and the depth of the document take up memory. fails with ResultJsonInvalidSyntax
+hk::Result parse(std::istream& in, Handler& handler);
+
+// the tag `writeByml` and `writeNode` mark values of `type` with where JSON's own types would read them back as another
+// type: U32s that fit an S32, S64s and U64s that fit a 32-bit type, F64s whose text reads back as an F32, and every
+// binary node (as base64). empty for the other types
+std::string_view getTypeTag(byml::NodeType type);
+
+// the type a tag stands for, or Null if `tag` isn't one
+byml::NodeType findTypeTag(std::string_view tag);
+
+// the inverse of `Writer::binary`. fails with ResultJsonInvalidSyntax
+hk::Result decodeBase64(std::vector<u8>& out, std::string_view text);
+
+// writes one node of `document` and everything under it, walked the same way as `writeByml`
+hk::Result writeNode(Writer& writer, const byml::Document& document, byml::Node node);
+
+// writes the BYML document under `root` to `writer`. containers are walked with an explicit stack rather than by
+// recursion, so deep nesting costs a few bytes per level and nothing on the native stack
+hk::Result writeByml(Writer& writer, const byml::Reader& root);
+
+} // namespace json
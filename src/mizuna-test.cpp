@@ -6,14 +6,14 @@
 #include <string>
 #include <vector>
 
+#include "archive.h"
 #include "clipp/clipp.h"
 #include "config.h"
 #include "mini/ini.h"
 #include "mizuna/byml/reader.h"
 #include "mizuna/results.h"
-#include "mizuna/sarc/reader.h"
 #include "mizuna/util.h"
-#include "mizuna/yaz0.h"
+#include "vfs.h"
 
 namespace fs = std::filesystem;
 
@@ -36,8 +36,8 @@ struct SearchEngine {
 	SearchEngine() {}
 
 	hk::Result searchAllStages(const fs::path& romfsPath);
-	hk::Result searchBYML(const std::vector<u8> bymlContents);
-	hk::Result searchStage(const fs::path& stagePath);
+	hk::Result searchBYML(std::span<const u8> bymlContents);
+	hk::Result searchStage(vfs::FileSystem& romfs, const std::string& stageFilename);
 	hk::Result searchScenario(const byml::Reader& scenario);
 
 	std::string mCurStageName;
@@ -57,7 +57,7 @@ hk::Result readVec3f(hk::util::Vector3f* out, const byml::Reader& reader, const
 	return hk::ResultSuccess();
 }
 
-hk::Result SearchEngine::searchBYML(const std::vector<u8> bymlContents) {
+hk::Result SearchEngine::searchBYML(std::span<const u8> bymlContents) {
 	byml::Reader reader;
 	HK_TRY(reader.init(bymlContents.data(), bymlContents.size()));
 
@@ -115,26 +115,17 @@ hk::Result SearchEngine::searchBYML(const std::vector<u8> bymlContents) {
 	return hk::ResultSuccess();
 }
 
-hk::Result SearchEngine::searchStage(const fs::path& stagePath) {
-	std::string stageName = stagePath.filename().stem().string();
+hk::Result SearchEngine::searchStage(vfs::FileSystem& romfs, const std::string& stageFilename) {
+	std::string stageName = archive::getStem(stageFilename);
 
 	printf("searching %s\n", stageName.c_str());
 
-	std::vector<u8> szsContents;
-	HK_TRY(util::readFile(szsContents, stagePath));
+	const std::string cameraParamPath = "StageData/" + stageFilename + "/CameraParam.byml";
+	if (!HK_TRY(romfs.exists(cameraParamPath))) return hk::ResultSuccess();
 
-	std::vector<u8> sarcContents;
-	HK_TRY(yaz0::decompress(sarcContents, szsContents));
-
-	sarc::Reader sarc(sarcContents);
-	HK_TRY(sarc.init());
-
-	if (!sarc.getFilenames().contains("CameraParam.byml")) return hk::ResultSuccess();
-
-	std::vector<u8> bymlContents;
-	HK_TRY(sarc.getFileData(bymlContents, "CameraParam.byml"));
-
-	HK_TRY(searchBYML(bymlContents));
+	vfs::FileHandle cameraParam;
+	HK_TRY(romfs.open(cameraParam, cameraParamPath));
+	HK_TRY(searchBYML(cameraParam.getData()));
 
 	return hk::ResultSuccess();
 }
@@ -145,18 +136,20 @@ hk::Result SearchEngine::searchAllStages(const fs::path& romfsPath) {
 
 	printf("searching...\n");
 
+	vfs::FileSystem romfs(romfsPath);
+
 	// sort stage paths
 	std::set<fs::path> stagePaths;
 	for (const auto& entry : fs::directory_iterator(stageDataPath))
 		stagePaths.insert(entry.path());
 
 	for (const auto& stagePath : stagePaths) {
-		std::string stageName = stagePath.filename().stem().string();
+		std::string stageName = archive::getStem(stagePath);
 		mCurStageName = stageName;
 
 		if (!stageName.ends_with("Map")) continue;
 
-		HK_TRY(searchStage(stagePath));
+		HK_TRY(searchStage(romfs, stagePath.filename().string()));
 	}
 
 	return hk::ResultSuccess();
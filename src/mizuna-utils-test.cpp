@@ -0,0 +1,579 @@
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <hk/diag/diag.h>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "archive.h"
+#include "byml.h"
+#include "hash.h"
+#include "json.h"
+#include "mizuna/util.h"
+#include "pack.h"
+#include "patch.h"
+#include "repack.h"
+#include "results.h"
+#include "sarc.h"
+#include "stream.h"
+#include "transform.h"
+#include "yaz0.h"
+#include "zs.h"
+
+namespace fs = std::filesystem;
+
+// round trips through the formats mizuna-utils writes, run by ctest. each test fails at the first check that doesn't
+// hold, printing it, or with the result of the first call that fails
+
+#define CHECK(condition)                                                                                               \
+	do {                                                                                                               \
+		if (!(condition)) {                                                                                            \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                              \
+			return hk::ResultInvalidArgument();                                                                        \
+		}                                                                                                              \
+	} while (0)
+
+// compressible, but not trivially so, like most game data
+std::vector<u8> make_data(size_t size, u32 seed) {
+	std::vector<u8> out(size);
+	u32 state = seed;
+	for (size_t i = 0; i < size; i++) {
+		state = state * 1664525 + 1013904223;
+		// mostly copies of recent bytes, with new ones mixed in
+		out[i] = i >= 64 && (state >> 28) < 12 ? out[i - 1 - (state >> 8) % 64] : u8(state >> 24);
+	}
+	return out;
+}
+
+hk::Result write_file(const fs::path& path, std::span<const u8> data) {
+	return writeFileReplacing(path, [&](const Sink& sink) { return sink(data); });
+}
+
+// `szs w`
+hk::Result write_szs(const fs::path& outPath, const fs::path& inDir, u32 alignment) {
+	std::vector<u8> archive;
+	HK_TRY(sarc::packDirectoryToBuffer(archive, inDir, util::ByteOrder::Little, alignment, nullptr));
+
+	std::vector<u8> szs;
+	yaz0::Encoder encoder(makeVectorSink(szs), archive.size(), 0);
+	HK_TRY(encoder.write(archive));
+	HK_TRY(encoder.finish());
+	return write_file(outPath, szs);
+}
+
+// `byml w`
+hk::Result encode_json(std::vector<u8>& out, std::string_view json, const byml::EncodeOptions& options = {}) {
+	std::istringstream in(std::string(json), std::ios::in | std::ios::binary);
+	std::stringstream encoded(std::ios::in | std::ios::out | std::ios::binary);
+	HK_TRY(byml::encodeJson(in, encoded, options));
+
+	const std::string bytes = std::move(encoded).str();
+	out.assign(bytes.begin(), bytes.end());
+	return hk::ResultSuccess();
+}
+
+// `byml r`, without whitespace
+hk::Result decode_json(std::string& out, std::span<const u8> data) {
+	byml::Document document;
+	HK_TRY(document.init(data));
+
+	std::vector<u8> text;
+	json::Writer writer(makeVectorSink(text), false);
+	HK_TRY(json::writeNode(writer, document, document.getRoot()));
+	HK_TRY(writer.flush());
+
+	out.assign(text.begin(), text.end());
+	return hk::ResultSuccess();
+}
+
+// a BYML holding every node type, with 32- and 64-bit values both in and out of the ranges JSON alone can tell apart
+hk::Result encode_every_type(std::vector<u8>& out, const byml::EncodeOptions& options) {
+	std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+	byml::Encoder encoder(
+		stream, options,
+		{ "Array", "Binary", "Bool", "Deep", "F32", "F64", "F64Exact", "Hash", "Nested", "Null", "S32", "S64", "S64Big",
+		  "String", "U32", "U32Big", "U64", "U64Big" },
+		{ "Kuribo \"gold\"\n", "deep" }
+	);
+
+	constexpr u8 cBinary[] = { 0x00, 0x01, 0xff, 'a', 'b' };
+
+	HK_TRY(encoder.beginHash());
+	HK_TRY(encoder.setKey("Array"));
+	HK_TRY(encoder.beginArray());
+	HK_TRY(encoder.addS32(1));
+	HK_TRY(encoder.beginArray());
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.beginHash());
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.setKey("Binary"));
+	HK_TRY(encoder.addBinary(cBinary));
+	HK_TRY(encoder.setKey("Bool"));
+	HK_TRY(encoder.addBool(true));
+	HK_TRY(encoder.setKey("F32"));
+	HK_TRY(encoder.addF32(1.5f));
+	HK_TRY(encoder.setKey("F64"));
+	HK_TRY(encoder.addF64(0.1));
+	HK_TRY(encoder.setKey("F64Exact"));
+	HK_TRY(encoder.addF64(0.123456789012345));
+	HK_TRY(encoder.setKey("Hash"));
+	HK_TRY(encoder.beginHash());
+	HK_TRY(encoder.setKey("Nested"));
+	HK_TRY(encoder.beginHash());
+	HK_TRY(encoder.setKey("Deep"));
+	HK_TRY(encoder.addString("deep"));
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.setKey("Null"));
+	HK_TRY(encoder.addNull());
+	HK_TRY(encoder.setKey("S32"));
+	HK_TRY(encoder.addS32(-4));
+	HK_TRY(encoder.setKey("S64"));
+	HK_TRY(encoder.addS64(-3));
+	HK_TRY(encoder.setKey("S64Big"));
+	HK_TRY(encoder.addS64(-5000000000));
+	HK_TRY(encoder.setKey("String"));
+	HK_TRY(encoder.addString("Kuribo \"gold\"\n"));
+	HK_TRY(encoder.setKey("U32"));
+	HK_TRY(encoder.addU32(5));
+	HK_TRY(encoder.setKey("U32Big"));
+	HK_TRY(encoder.addU32(3000000000));
+	HK_TRY(encoder.setKey("U64"));
+	HK_TRY(encoder.addU64(9));
+	HK_TRY(encoder.setKey("U64Big"));
+	HK_TRY(encoder.addU64(18000000000000000000ull));
+	HK_TRY(encoder.end());
+	HK_TRY(encoder.finish());
+
+	const std::string bytes = std::move(stream).str();
+	out.assign(bytes.begin(), bytes.end());
+	return hk::ResultSuccess();
+}
+
+// the above as `byml r` prints it: values that would come back as another type are tagged with theirs
+constexpr std::string_view cEveryType =
+	R"({"Array":[1,[],{}],"Binary":{"!binary":"AAH/YWI="},"Bool":true,"F32":1.5,"F64":{"!f64":0.1},)"
+	R"("F64Exact":0.123456789012345,"Hash":{"Nested":{"Deep":"deep"}},"Null":null,"S32":-4,"S64":{"!s64":-3},)"
+	R"("S64Big":-5000000000,"String":"Kuribo \"gold\"\n","U32":{"!u32":5},"U32Big":3000000000,"U64":{"!u64":9},)"
+	R"("U64Big":18000000000000000000})";
+
+hk::Result test_byml_round_trip(const fs::path&) {
+	for (const util::ByteOrder byteOrder : { util::ByteOrder::Little, util::ByteOrder::Big }) {
+		const byml::EncodeOptions options = { .byteOrder = byteOrder };
+
+		std::vector<u8> encoded;
+		HK_TRY(encode_every_type(encoded, options));
+		std::string decoded;
+		HK_TRY(decode_json(decoded, encoded));
+		CHECK(decoded == cEveryType);
+
+		// and converting it back gives the same file, byte for byte
+		std::vector<u8> reencoded;
+		HK_TRY(encode_json(reencoded, decoded, options));
+		CHECK(reencoded == encoded);
+	}
+
+	// a tagged value holds a value of its type and nothing else
+	std::vector<u8> data;
+	CHECK(encode_json(data, R"({"A":{"!u32":-1}})").failed());
+	CHECK(encode_json(data, R"({"A":{"!u32":5,"B":1}})").failed());
+	CHECK(encode_json(data, R"({"A":{"!binary":"AAH"}})").failed());
+
+	return hk::ResultSuccess();
+}
+
+hk::Result test_byml_sharing(const fs::path&) {
+	constexpr std::string_view cRepeated =
+		R"([{"Id":"obj0","Scale":{"X":1.0,"Y":2.0},"Size":5000000000},{"Id":"obj0","Scale":{"X":1.0,"Y":2.0},)"
+		R"("Size":5000000000},{"Id":"obj1","Scale":{"X":1.0,"Y":3.0},"Size":5000000001}])";
+
+	std::vector<u8> shared;
+	HK_TRY(encode_json(shared, cRepeated));
+	std::vector<u8> unshared;
+	HK_TRY(encode_json(unshared, cRepeated, { .isShareContainers = false }));
+	CHECK(shared.size() < unshared.size());
+
+	std::string decoded;
+	HK_TRY(decode_json(decoded, shared));
+	CHECK(decoded == cRepeated);
+
+	// the first two objects, 64-bit values included, are one copy. the third only looks like them
+	byml::Document document;
+	HK_TRY(document.init(shared));
+	const byml::Node first = HK_TRY(document.getEntry(document.getRoot(), 0));
+	const byml::Node second = HK_TRY(document.getEntry(document.getRoot(), 1));
+	const byml::Node third = HK_TRY(document.getEntry(document.getRoot(), 2));
+	CHECK(first.value == second.value);
+	CHECK(first.value != third.value);
+
+	return hk::ResultSuccess();
+}
+
+// `byml p`, checking whether it was done in place
+hk::Result patch_byml(std::string& out, std::string_view json, std::string_view operations, bool isInPlace) {
+	std::vector<u8> data;
+	HK_TRY(encode_json(data, json));
+
+	std::istringstream in(std::string(operations), std::ios::in | std::ios::binary);
+	std::vector<patch::Operation> parsed;
+	HK_TRY(patch::parseOperations(parsed, in));
+
+	const size_t size = data.size();
+	patch::Stats stats;
+	HK_TRY(patch::patchByml(data, parsed, stats));
+	CHECK(stats.isRebuilt != isInPlace);
+	if (isInPlace) CHECK(data.size() == size && stats.numInPlace == parsed.size());
+
+	return decode_json(out, data);
+}
+
+hk::Result test_byml_patch(const fs::path&) {
+	constexpr std::string_view cDocument =
+		R"([{"Big":5000000000,"Hp":3,"Id":"obj0","Name":"Kuribo","Scale":{"X":1.0}},)"
+		R"({"Big":6000000000,"Hp":4,"Id":"obj1","Name":"Other","Scale":{"X":1.5}}])";
+	constexpr std::string_view cReplace =
+		R"([{"op":"replace","path":"/0/Hp","value":10},{"op":"replace","path":"/1/Big","value":7000000000},)"
+		R"({"op":"replace","path":"/0/Name","value":"Other"},{"op":"replace","path":"/1/Scale/X","value":2.5}])";
+	// adding a key that's there already replaces its value, with the same one here, but only a rebuild can add
+	constexpr std::string_view cReplaceAndAdd =
+		R"([{"op":"replace","path":"/0/Hp","value":10},{"op":"replace","path":"/1/Big","value":7000000000},)"
+		R"({"op":"replace","path":"/0/Name","value":"Other"},{"op":"replace","path":"/1/Scale/X","value":2.5},)"
+		R"({"op":"add","path":"/0/Id","value":"obj0"}])";
+	constexpr std::string_view cExpected =
+		R"([{"Big":5000000000,"Hp":10,"Id":"obj0","Name":"Other","Scale":{"X":1.0}},)"
+		R"({"Big":7000000000,"Hp":4,"Id":"obj1","Name":"Other","Scale":{"X":2.5}}])";
+
+	std::string inPlace;
+	HK_TRY(patch_byml(inPlace, cDocument, cReplace, true));
+	CHECK(inPlace == cExpected);
+
+	std::string rebuilt;
+	HK_TRY(patch_byml(rebuilt, cDocument, cReplaceAndAdd, false));
+	CHECK(rebuilt == cExpected);
+
+	// a shared container can't be written over without changing every parent, so only the one edited changes
+	std::string unshared;
+	HK_TRY(patch_byml(unshared, R"([{"X":1.0},{"X":1.0}])", R"([{"op":"replace","path":"/1/X","value":2.0}])", false));
+	CHECK(unshared == R"([{"X":1.0},{"X":2.0}])");
+
+	return hk::ResultSuccess();
+}
+
+hk::Result test_szs_repack(const fs::path& tempDir) {
+	const fs::path inDir = tempDir / "in";
+	fs::create_directories(inDir / "Sub");
+	HK_TRY(write_file(inDir / "Big.bin", make_data(300000, 1)));
+	HK_TRY(write_file(inDir / "Sub/Small.byml", make_data(5000, 2)));
+	HK_TRY(write_file(inDir / "Last.bin", make_data(80000, 3)));
+
+	for (const u32 alignment : { 0x80u, 0x1000u }) {
+		const fs::path szsPath = tempDir / "base.szs";
+		HK_TRY(write_szs(szsPath, inDir, alignment));
+
+		// an edit near the end of whichever file comes last in the archive
+		std::vector<u8> base;
+		HK_TRY(util::readFile(base, szsPath));
+		std::vector<u8> archive;
+		HK_TRY(yaz0::decompressFast(archive, base));
+		sarc::EntryTable table;
+		HK_TRY(table.init(archive));
+		const sarc::EntryInfo& last = *std::ranges::max_element(table.getEntries(), {}, &sarc::EntryInfo::start);
+
+		const fs::path editedPath = inDir / table.getName(last);
+		std::vector<u8> edited;
+		HK_TRY(util::readFile(edited, editedPath));
+		edited[edited.size() - 10] ^= 0xff;
+		HK_TRY(write_file(editedPath, edited));
+
+		// repacked over the base, it decodes to what `szs w` would have made, laid out the same way
+		szs::RepackStats stats;
+		HK_TRY(szs::repack(szsPath, inDir, szsPath, stats));
+		CHECK(stats.reusedSize > 0);
+
+		std::vector<u8> repacked;
+		HK_TRY(util::readFile(repacked, szsPath));
+		std::vector<u8> repackedArchive;
+		HK_TRY(yaz0::decompressFast(repackedArchive, repacked));
+		std::vector<u8> expected;
+		HK_TRY(sarc::packDirectoryToBuffer(expected, inDir, util::ByteOrder::Little, alignment, nullptr));
+		CHECK(repackedArchive == expected);
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result test_yaz0_seek_index(const fs::path&) {
+	const std::vector<u8> data = make_data(200000, 4);
+	constexpr u32 cInterval = 0x4000;
+
+	// hashed as it's written, a group at a time
+	std::vector<u8> compressed;
+	const Sink vectorSink = makeVectorSink(compressed);
+	hash::Xxh64 compressedHash;
+	auto sink = [&](std::span<const u8> chunk) {
+		compressedHash.update(chunk);
+		return vectorSink(chunk);
+	};
+	yaz0::Encoder encoder(sink, data.size(), 0);
+	encoder.setSeekInterval(cInterval);
+	HK_TRY(encoder.write(data));
+	HK_TRY(encoder.finish());
+
+	// as `szs w --index` writes it and `szs x` reads it back
+	yaz0::SeekIndex recorded = encoder.getSeekIndex();
+	recorded.compressedHash = compressedHash.digest();
+	CHECK(recorded.compressedHash == hash::xxh64(compressed));
+	std::vector<u8> indexContents;
+	yaz0::writeSeekIndex(indexContents, recorded);
+	yaz0::SeekIndex written;
+	HK_TRY(yaz0::readSeekIndex(written, indexContents));
+	CHECK(written.compressedSize == compressed.size() && written.compressedHash == recorded.compressedHash);
+
+	// as `szs i` builds it
+	yaz0::SeekIndex built;
+	HK_TRY(yaz0::buildSeekIndex(built, compressed, cInterval));
+	CHECK(built.compressedHash == recorded.compressedHash);
+
+	struct Range {
+		u32 offset;
+		u32 size;
+	};
+	const Range ranges[] = {
+		{ 0, 100 }, { cInterval - 1, 2 }, { 12345, 40000 }, { u32(data.size()) - 7, 7 }, { 0, u32(data.size()) },
+	};
+	for (const yaz0::SeekIndex* index : { &written, &built }) {
+		for (const Range& range : ranges) {
+			std::vector<u8> out;
+			HK_TRY(yaz0::decompressRange(out, compressed, *index, range.offset, range.size));
+			CHECK(std::ranges::equal(out, std::span(data).subspan(range.offset, range.size)));
+		}
+	}
+
+	// an index whose checkpoints are out of order or past the end of the stream is rejected when it's read
+	CHECK(recorded.checkpoints.size() >= 3);
+	auto isRejected = [](const yaz0::SeekIndex& index) {
+		std::vector<u8> contents;
+		yaz0::writeSeekIndex(contents, index);
+		yaz0::SeekIndex read;
+		return yaz0::readSeekIndex(read, contents).failed();
+	};
+	yaz0::SeekIndex tampered = recorded;
+	std::swap(tampered.checkpoints[1], tampered.checkpoints[2]);
+	CHECK(isRejected(tampered));
+	tampered = recorded;
+	tampered.checkpoints.back().outOffset = tampered.decompressedSize + 1;
+	CHECK(isRejected(tampered));
+	tampered = recorded;
+	tampered.checkpoints.back().inOffset = tampered.compressedSize + 1;
+	CHECK(isRejected(tampered));
+
+	return hk::ResultSuccess();
+}
+
+// `romfs t` on one stage
+hk::Result transform_byml(
+	std::string& out, u32& numObjects, std::string_view json, std::string_view spec, bool isInPlace
+) {
+	std::vector<u8> data;
+	HK_TRY(encode_json(data, json));
+
+	std::istringstream in(std::string(spec), std::ios::in | std::ios::binary);
+	transform::Spec parsed;
+	HK_TRY(transform::parseSpec(parsed, in));
+
+	std::vector<u8> edited;
+	patch::Stats stats;
+	numObjects = HK_TRY(transform::transformByml(edited, data, parsed, stats));
+	if (numObjects == 0) {
+		CHECK(edited.empty());
+		out.clear();
+		return hk::ResultSuccess();
+	}
+	CHECK(stats.isRebuilt != isInPlace);
+
+	return decode_json(out, edited);
+}
+
+hk::Result test_romfs_transform(const fs::path&) {
+	// a scenario with one Kuribo in its ObjectList, and another linked from a different object
+	constexpr std::string_view cStage =
+		R"([{"ObjectList":[{"Hp":3,"Id":"obj0","Links":{},"Scale":{"X":1.0,"Y":1.5,"Z":1.0},)"
+		R"("UnitConfig":{"ParameterConfigName":"Kuribo"},"UnitConfigName":"Kuribo"},)"
+		R"({"Id":"obj1","Links":{"Kids":[{"Hp":4,"Id":"obj2","Links":{},"Scale":{"X":1.0,"Y":0.5,"Z":1.0},)"
+		R"("UnitConfig":{"ParameterConfigName":"Kuribo"},"UnitConfigName":"Kuribo"}]},)"
+		R"("UnitConfig":{"ParameterConfigName":"Other"},"UnitConfigName":"Other"}]}])";
+	constexpr std::string_view cExpected =
+		R"([{"ObjectList":[{"Hp":5,"Id":"obj0","Links":{},"Scale":{"X":1.0,"Y":3.0,"Z":1.0},)"
+		R"("UnitConfig":{"ParameterConfigName":"Kuribo"},"UnitConfigName":"Kuribo"},)"
+		R"({"Id":"obj1","Links":{"Kids":[{"Hp":5,"Id":"obj2","Links":{},"Scale":{"X":1.0,"Y":1.0,"Z":1.0},)"
+		R"("UnitConfig":{"ParameterConfigName":"Kuribo"},"UnitConfigName":"Kuribo"}]},)"
+		R"("UnitConfig":{"ParameterConfigName":"Other"},"UnitConfigName":"Other"}]}])";
+
+	std::string out;
+	u32 numObjects = 0;
+
+	// replacing and scaling numbers is done in place
+	constexpr std::string_view cScale = R"({"name":"Kuribo","recurse":true,"edits":[{"op":"scale","path":"Scale/Y",)"
+										R"("value":2},{"op":"replace","path":"Hp","value":5}]})";
+	HK_TRY(transform_byml(out, numObjects, cStage, cScale, true));
+	CHECK(numObjects == 2);
+	CHECK(out == cExpected);
+
+	// without recurse, linked objects are left alone
+	HK_TRY(transform_byml(out, numObjects, cStage, R"({"name":"Kuribo","edits":[]})", true));
+	CHECK(numObjects == 1);
+
+	// adding a key rebuilds the document
+	HK_TRY(transform_byml(
+		out, numObjects, cStage, R"({"name":"Other","edits":[{"op":"add","path":"Hp","value":1}]})", false
+	));
+	CHECK(numObjects == 1);
+	CHECK(out.find(R"({"Hp":1,"Id":"obj1")") != std::string::npos);
+
+	// stages that don't mention the name aren't edited at all
+	HK_TRY(transform_byml(out, numObjects, cStage, R"({"name":"Kameck","edits":[]})", true));
+	CHECK(numObjects == 0);
+
+	// and a scaled value that no longer fits its type fails rather than wrapping around
+	const hk::Result overflow = transform_byml(
+		out, numObjects, cStage, R"({"name":"Kuribo","edits":[{"op":"scale","path":"Hp","value":1e10}]})", true
+	);
+	CHECK(overflow == utils::ResultBymlInvalidValue());
+
+	return hk::ResultSuccess();
+}
+
+// `zs w`, with the dictionary `zs w` would pick for `filename` if there is one
+hk::Result compress_zs(
+	std::vector<u8>& out, std::span<const u8> data, zs::DictionarySet* dictionaries, const std::string& filename
+) {
+	std::istringstream in(std::string(data.begin(), data.end()), std::ios::in | std::ios::binary);
+	zs::CompressOptions options;
+	options.pledgedSize = data.size();
+	if (dictionaries) options.dictionary = dictionaries->findCDict(filename, options.level);
+
+	out.clear();
+	return zs::compressStream(in, makeVectorSink(out), options);
+}
+
+hk::Result test_zs_dictionaries(const fs::path& tempDir) {
+	// a dictionary in zstd's format, with entropy tables that are as small as they can be and repeat offsets that
+	// differ from the ones a frame without a dictionary starts from, so decoding such a frame with it goes wrong
+	constexpr u32 cDictionaryId = 0x6d697a75;
+	std::vector<u8> dictionary = {
+		0x37, 0xa4, 0x30, 0xec, // magic
+		0x75, 0x7a, 0x69, 0x6d, // id
+		0x80, 0x10,             // literals: two symbols of weight 1
+		0xf0, 0x03,             // offsets, match lengths and literal lengths: only symbol 0, at accuracy log 5
+		0xf0, 0x03, 0xf0, 0x03, //
+		0x02, 0x00, 0x00, 0x00, // repeat offsets
+		0x05, 0x00, 0x00, 0x00, //
+		0x09, 0x00, 0x00, 0x00, //
+	};
+	for (u32 i = 0; i < 64; i++)
+		dictionary.push_back("0123456789abcdef"[i % 16]);
+	HK_TRY(write_file(tempDir / "test.zsdic", dictionary));
+
+	zs::DictionarySet dictionaries;
+	HK_TRY(dictionaries.load(tempDir / "test.zsdic"));
+
+	const std::vector<u8> first = make_data(10000, 5);
+	const std::vector<u8> second(10000, 'a');
+
+	// a frame that names the dictionary, followed by one that doesn't have any
+	std::vector<u8> compressed;
+	HK_TRY(compress_zs(compressed, first, &dictionaries, "file.test.zs"));
+	CHECK(ZSTD_getDictID_fromFrame(compressed.data(), compressed.size()) == cDictionaryId);
+	std::vector<u8> plain;
+	HK_TRY(compress_zs(plain, second, nullptr, "file.zs"));
+	CHECK(ZSTD_getDictID_fromFrame(plain.data(), plain.size()) == 0);
+	compressed.insert(compressed.end(), plain.begin(), plain.end());
+
+	std::vector<u8> expected = first;
+	expected.insert(expected.end(), second.begin(), second.end());
+
+	std::vector<u8> decompressed;
+	HK_TRY(zs::decompress(decompressed, compressed, &dictionaries));
+	CHECK(decompressed == expected);
+
+	// and a frame that names a dictionary that isn't loaded fails
+	CHECK(zs::decompress(decompressed, compressed).failed());
+
+	return hk::ResultSuccess();
+}
+
+hk::Result test_archive_layers(const fs::path&) {
+	const std::vector<u8> data = make_data(50000, 6);
+
+	// a Yaz0 stream inside a zstd frame, as some files in newer games are stored
+	std::vector<u8> yaz0;
+	yaz0::Encoder encoder(makeVectorSink(yaz0), data.size(), 0x80);
+	HK_TRY(encoder.write(data));
+	HK_TRY(encoder.finish());
+	std::vector<u8> nested;
+	HK_TRY(compress_zs(nested, yaz0, nullptr, "file.zs"));
+
+	archive::File file;
+	HK_TRY(file.open(std::vector(nested)));
+	CHECK(file.getLayers().size() == 2);
+	CHECK(file.getLayers()[0].format == archive::Format::Zstd && file.getLayers()[1].format == archive::Format::Yaz0);
+	CHECK(file.getLayers()[1].alignment == 0x80);
+
+	// compressing it again gives the same layers, the Yaz0 header's alignment included
+	std::vector<u8> recompressed(file.getData().begin(), file.getData().end());
+	HK_TRY(archive::compressLayers(recompressed, file.getLayers(), "file.zs"));
+	archive::File reopened;
+	HK_TRY(reopened.open(std::move(recompressed)));
+	CHECK(std::ranges::equal(reopened.getData(), data));
+	CHECK(reopened.getLayers().size() == 2 && reopened.getLayers()[1].alignment == 0x80);
+
+	return hk::ResultSuccess();
+}
+
+struct Test {
+	const char* name;
+	hk::Result (*run)(const fs::path& tempDir);
+};
+
+constexpr Test cTests[] = {
+	{ "byml round trip", test_byml_round_trip },
+	{ "byml sharing", test_byml_sharing },
+	{ "byml patch", test_byml_patch },
+	{ "szs repack", test_szs_repack },
+	{ "yaz0 seek index", test_yaz0_seek_index },
+	{ "romfs transform", test_romfs_transform },
+	{ "zs dictionaries", test_zs_dictionaries },
+	{ "archive layers", test_archive_layers },
+};
+
+s32 main() {
+	const fs::path tempDir = fs::temp_directory_path() / "mizuna-utils-test";
+
+	u32 numFailed = 0;
+	for (const Test& test : cTests) {
+		// each test gets an empty directory to write files to
+		std::error_code ec;
+		fs::remove_all(tempDir, ec);
+		fs::create_directories(tempDir, ec);
+
+		const hk::Result r = test.run(tempDir);
+		if (r.failed()) {
+			fprintf(stderr, "FAILED %s: %s\n", test.name, hk::diag::getResultName(r));
+			numFailed++;
+		} else {
+			printf("ok %s\n", test.name);
+		}
+	}
+
+	std::error_code ec;
+	fs::remove_all(tempDir, ec);
+
+	printf("%zu tests, %u failed\n", std::size(cTests), numFailed);
+	return numFailed == 0 ? 0 : 1;
+}
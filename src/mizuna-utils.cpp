@@ -1,219 +1,451 @@
+#include <atomic>
+#include <charconv>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <format>
 #include <fstream>
 #include <hk/ValueOrResult.h>
 #include <hk/diag/diag.h>
 #include <iostream>
-#include <zstd/zstd.h>
-
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "archive.h"
+#include "batch.h"
+#include "byml.h"
+#include "diff.h"
+#include "extract.h"
+#include "hash.h"
+#include "json.h"
 #include "mizuna/bffnt.h"
 #include "mizuna/bfres/reader.h"
 #include "mizuna/bntx.h"
 #include "mizuna/byml/reader.h"
 #include "mizuna/byml/writer.h"
 #include "mizuna/results.h"
-#include "mizuna/sarc/reader.h"
-#include "mizuna/sarc/writer.h"
 #include "mizuna/util.h"
 #include "mizuna/yaz0.h"
+#include "pack.h"
+#include "patch.h"
+#include "pool.h"
+#include "query.h"
+#include "repack.h"
+#include "results.h"
+#include "romfs.h"
+#include "sarc.h"
+#include "stream.h"
+#include "transform.h"
+#include "vfs.h"
+#include "yaz0.h"
+#include "zs.h"
 
 namespace fs = std::filesystem;
 
 std::string programName;
 
-hk::Result print_byml(std::string& out, const byml::Reader& node, s32 level = 0) {
-	std::string indent(level, '\t');
-
-	if (HK_TRY(node.getType()) == byml::NodeType::Array) {
-		out += "[";
-		for (u32 i = 0; i < node.getSize(); i++) {
-			out += "\n";
-			byml::NodeType childType = HK_TRY(node.getTypeByIdx(i));
-			out += "\t";
-
-			switch (childType) {
-			case byml::NodeType::Array: {
-				byml::Reader container;
-				HK_TRY(node.getContainerByIdx(&container, i));
-				out += indent;
-				HK_TRY(print_byml(out, container, level + 1));
-				break;
-			}
-			case byml::NodeType::Hash: {
-				byml::Reader container;
-				HK_TRY(node.getContainerByIdx(&container, i));
-				out += indent;
-				HK_TRY(print_byml(out, container, level + 1));
-				break;
-			}
-			case byml::NodeType::String: {
-				std::string str;
-				HK_TRY(node.getStringByIdx(&str, i));
-				out += std::format("{}\"{}\"", indent, str);
-				break;
-			}
-			case byml::NodeType::Binary: {
-				std::vector<u8> value;
-				HK_TRY(node.getBinaryByIdx(&value, i));
-				// out += ;
-				break;
-			}
-			case byml::NodeType::Bool: {
-				bool value;
-				HK_TRY(node.getBoolByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::S32: {
-				s32 value;
-				HK_TRY(node.getS32ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::F32: {
-				f32 value;
-				HK_TRY(node.getF32ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::U32: {
-				u32 value;
-				HK_TRY(node.getU32ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::S64: {
-				s64 value;
-				HK_TRY(node.getS64ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::U64: {
-				u64 value;
-				HK_TRY(node.getU64ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::F64: {
-				f64 value;
-				HK_TRY(node.getF64ByIdx(&value, i));
-				out += std::format("{}{}", indent, value);
-				break;
-			}
-			case byml::NodeType::Null: {
-				out += std::format("{}null", indent);
-				break;
-			}
-			case byml::NodeType::StringTable: {
-				fprintf(stderr, "error: string table node can't be in tree\n");
-				return byml::ResultInvalidNodeType();
-			}
-			}
+// loaded from `--dict`, and shared by every file the command touches
+zs::DictionarySet zstdDictionaries;
 
-			if (i != node.getSize() - 1)
-				out += ",";
-			else
-				out += std::format("\n{}", indent);
-		}
-		out += "]";
-	} else if (HK_TRY(node.getType()) == byml::NodeType::Hash) {
-		out += "{";
-		for (u32 i = 0; i < node.getSize(); i++) {
-			out += "\n";
-			byml::NodeType childType = HK_TRY(node.getTypeByIdx(i));
-			std::string key;
-			HK_TRY(node.getKeyByIdx(&key, i));
-			out += std::format("\t{}\"{}\": ", indent, key);
-
-			switch (childType) {
-			case byml::NodeType::Array: {
-				byml::Reader container;
-				HK_TRY(node.getContainerByIdx(&container, i));
-				HK_TRY(print_byml(out, container, level + 1));
-				break;
-			}
-			case byml::NodeType::Hash: {
-				byml::Reader container;
-				HK_TRY(node.getContainerByIdx(&container, i));
-				HK_TRY(print_byml(out, container, level + 1));
-				break;
-			}
-			case byml::NodeType::String: {
-				std::string str;
-				HK_TRY(node.getStringByIdx(&str, i));
-				out += std::format("\"{}\"", str);
-				break;
-			}
-			case byml::NodeType::Binary: {
-				std::vector<u8> value;
-				HK_TRY(node.getBinaryByIdx(&value, i));
-				// out += ;
-				break;
-			}
-			case byml::NodeType::Bool: {
-				bool value;
-				HK_TRY(node.getBoolByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::S32: {
-				s32 value;
-				HK_TRY(node.getS32ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::F32: {
-				f32 value;
-				HK_TRY(node.getF32ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::U32: {
-				u32 value;
-				HK_TRY(node.getU32ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::S64: {
-				s64 value;
-				HK_TRY(node.getS64ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::U64: {
-				u64 value;
-				HK_TRY(node.getU64ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::F64: {
-				f64 value;
-				HK_TRY(node.getF64ByIdx(&value, i));
-				out += std::format("{}", value);
-				break;
-			}
-			case byml::NodeType::Null: {
-				out += "null";
-				break;
-			}
-			case byml::NodeType::StringTable: {
-				fprintf(stderr, "error: string table node can't be in tree\n");
-				return byml::ResultInvalidNodeType();
-			}
-			}
+constexpr u32 cDefaultSeekInterval = 64 * 1024;
+// Yaz0 streams can't be 4 GiB or more, so nothing is gained from a larger one
+constexpr u32 cMaxSeekIntervalKiB = 4 * 1024 * 1024 - 1;
 
-			if (i != node.getSize() - 1)
-				out += ",";
-			else
-				out += std::format("\n{}", indent);
+// the whole of `text` as a number (hex with a `0x` prefix), unlike atoi, which takes "abc" for 0 and lets "-1" wrap
+bool parse_u32(u32& out, const char* text) {
+	const bool isHex = text[0] == '0' && (text[1] == 'x' || text[1] == 'X');
+	if (isHex) text += 2;
+
+	const char* end = text + std::strlen(text);
+	auto [ptr, ec] = std::from_chars(text, end, out, isHex ? 16 : 10);
+	return *text != '\0' && ec == std::errc() && ptr == end;
+}
+
+// an optional numeric argument, which fails with ResultInvalidArgument if it's given but isn't a number
+hk::ValueOrResult<u32> parse_u32_arg(const char* text, const char* name) {
+	u32 value;
+	if (!parse_u32(value, text)) {
+		fprintf(stderr, "error: %s must be a number, not '%s'\n", name, text);
+		return hk::ResultInvalidArgument();
+	}
+	return value;
+}
+
+fs::path get_seek_index_path(const fs::path& archivePath) {
+	return archivePath.string() + ".idx";
+}
+
+hk::Result save_seek_index(
+	const fs::path& archivePath, std::span<const u8> szsContents, std::span<const u8> sarcContents, u32 interval
+) {
+	yaz0::SeekIndex index;
+	HK_TRY(yaz0::buildSeekIndex(index, szsContents, sarcContents, interval));
+
+	std::vector<u8> indexContents;
+	yaz0::writeSeekIndex(indexContents, index);
+	util::writeFile(get_seek_index_path(archivePath), indexContents);
+
+	return hk::ResultSuccess();
+}
+
+// pulls a single file out of an SZS. if a seek index sits next to the archive, only the SARC metadata and the file
+// itself are decoded; otherwise the archive is decoded whole, whatever its compression
+hk::Result extract_szs_entry(std::vector<u8>& out, const fs::path& archivePath, const std::string& name) {
+	std::vector<u8> szsContents;
+	yaz0::SeekIndex index;
+	bool hasIndex = false;
+	const fs::path indexPath = get_seek_index_path(archivePath);
+	if (fs::exists(indexPath)) {
+		HK_TRY(util::readFile(szsContents, archivePath));
+
+		std::vector<u8> indexContents;
+		HK_TRY(util::readFile(indexContents, indexPath));
+
+		hasIndex = yaz0::readSeekIndex(index, indexContents).succeeded() &&
+		           index.compressedSize == szsContents.size() && index.compressedHash == hash::xxh64(szsContents);
+		if (!hasIndex) fprintf(stderr, "warning: ignoring outdated seek index %s\n", indexPath.string().c_str());
+	}
+
+	if (!hasIndex) {
+		archive::File file;
+		HK_TRY(file.openAs(archivePath, archive::Format::Sarc, &zstdDictionaries));
+		std::span<const u8> sarcContents = file.getData();
+
+		sarc::EntryTable table;
+		HK_TRY(table.init(sarcContents));
+
+		const sarc::EntryInfo* entry = table.find(name);
+		if (!entry) return utils::ResultSarcEntryNotFound();
+		if (entry->end > sarcContents.size()) return utils::ResultSarcInvalidHeader();
+
+		out.assign(sarcContents.begin() + entry->start, sarcContents.begin() + entry->end);
+		return hk::ResultSuccess();
+	}
+
+	std::vector<u8> header;
+	HK_TRY(yaz0::decompressRange(header, szsContents, index, 0, sarc::cArchiveHeaderSize));
+	u32 dataOffset = HK_TRY(sarc::EntryTable::readDataOffset(header));
+
+	std::vector<u8> metadata;
+	HK_TRY(yaz0::decompressRange(metadata, szsContents, index, 0, dataOffset));
+
+	sarc::EntryTable table;
+	HK_TRY(table.init(metadata));
+
+	const sarc::EntryInfo* entry = table.find(name);
+	if (!entry) return utils::ResultSarcEntryNotFound();
+
+	return yaz0::decompressRange(out, szsContents, index, entry->start, entry->end - entry->start);
+}
+
+hk::Result read_yaz0(const fs::path& inPath, const fs::path& outPath) {
+	std::ifstream infile(inPath, std::ios::in | std::ios::binary);
+	if (!infile) return ResultFileError();
+
+	std::ofstream outfile(outPath, std::ios::out | std::ios::binary);
+	return yaz0::decompressStream(infile, makeStreamSink(outfile));
+}
+
+hk::Result write_yaz0(const fs::path& inPath, const fs::path& outPath, u32 alignment) {
+	std::vector<u8> fileContents;
+	HK_TRY(util::readFile(fileContents, inPath));
+
+	std::vector<u8> outputBuffer;
+	yaz0::compress(outputBuffer, fileContents, alignment);
+
+	util::writeFile(outPath, outputBuffer);
+
+	return hk::ResultSuccess();
+}
+
+// any compression is detected and removed first, so this also reads SZS and .zs archives. files are written on `pool`
+// if there is one
+hk::Result read_sarc(const fs::path& archivePath, const fs::path& outDir, ThreadPool* pool) {
+	// uncompressed archives are copied out of the file on disk without reading the file data
+	archive::Format format = HK_TRY(archive::detectFileFormat(archivePath));
+	if (format == archive::Format::Sarc) return sarc::extractAllFromFile(archivePath, outDir, pool);
+
+	archive::File file;
+	HK_TRY(file.openAs(archivePath, archive::Format::Sarc, &zstdDictionaries));
+
+	return sarc::extractAll(file.getData(), outDir, pool);
+}
+
+constexpr u32 cMaxListedAlignment = 0x2000;
+
+// only the header and tables are read, with decompression stopped right after them. `isLong` adds sizes, offsets and
+// alignments. the latter isn't stored anywhere, so it's the largest power of two (up to 0x2000) the offset is a
+// multiple of
+hk::Result list_sarc(const fs::path& archivePath, bool isLong) {
+	std::vector<u8> metadata;
+	HK_TRY(archive::readSarcMetadata(metadata, archivePath, &zstdDictionaries));
+
+	sarc::EntryTable table;
+	HK_TRY(table.init(metadata));
+
+	if (isLong) printf("%10s  %8s  %5s  %s\n", "size", "offset", "align", "name");
+
+	for (const sarc::EntryInfo& entry : table.getEntries()) {
+		std::string_view name = table.getName(entry);
+		std::string filename = name.empty() ? std::format("{:08x}.bin", entry.hash) : std::string(name);
+
+		if (!isLong) {
+			printf("%s\n", filename.c_str());
+			continue;
 		}
-		out += "}";
+
+		u32 alignment = std::min(entry.start & (~entry.start + 1), cMaxListedAlignment);
+		printf("%10u  %08x  %5x  %s\n", entry.end - entry.start, entry.start, alignment, filename.c_str());
 	}
 
 	return hk::ResultSuccess();
 }
 
+// files are streamed into place in the output, on `pool` if there is one
+hk::Result write_sarc(const fs::path& inDir, const fs::path& outPath, u32 alignment, ThreadPool* pool) {
+	return sarc::packDirectory(inDir, outPath, util::ByteOrder::Little, alignment, pool);
+}
+
+// the archive is compressed as it's read, so neither the SARC nor the SZS is ever held in memory whole
+hk::Result write_szs(const fs::path& inDir, const fs::path& outPath, bool isWriteIndex) {
+	sarc::PackSource source;
+	HK_TRY(sarc::collectPackSource(source, inDir));
+
+	sarc::Layout layout;
+	HK_TRY(sarc::buildLayout(layout, source.files, util::ByteOrder::Little, 0x80));
+
+	std::ofstream outfile(outPath, std::ios::out | std::ios::binary);
+	if (!outfile) return ResultFileError();
+
+	// the index holds a hash of the archive, which is worked out as the archive goes to disk
+	const Sink fileSink = makeStreamSink(outfile);
+	hash::Xxh64 compressedHash;
+	auto sink = [&](std::span<const u8> data) {
+		if (isWriteIndex) compressedHash.update(data);
+		return fileSink(data);
+	};
+
+	yaz0::Encoder encoder(sink, layout.archiveSize, 0xc);
+	if (isWriteIndex) encoder.setSeekInterval(cDefaultSeekInterval);
+
+	HK_TRY(sarc::streamArchive(source, layout, [&](std::span<const u8> data) { return encoder.write(data); }));
+	HK_TRY(encoder.finish());
+
+	if (isWriteIndex) {
+		outfile.close();
+		if (!outfile) return ResultFileError();
+
+		yaz0::SeekIndex index = encoder.getSeekIndex();
+		index.compressedHash = compressedHash.digest();
+
+		std::vector<u8> indexContents;
+		yaz0::writeSeekIndex(indexContents, index);
+		util::writeFile(get_seek_index_path(outPath), indexContents);
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result read_zs(const fs::path& inPath, const fs::path& outPath) {
+	std::ifstream infile(inPath, std::ios::in | std::ios::binary);
+	if (!infile) return ResultFileError();
+
+	std::ofstream outfile(outPath, std::ios::out | std::ios::binary);
+	return zs::decompressStream(infile, makeStreamSink(outfile), &zstdDictionaries);
+}
+
+hk::Result write_zs(const fs::path& inPath, const fs::path& outPath, s32 level, u32 numWorkers) {
+	std::ifstream infile(inPath, std::ios::in | std::ios::binary);
+	if (!infile) return ResultFileError();
+
+	zs::CompressOptions options = {
+		.level = level,
+		.numWorkers = numWorkers,
+		.pledgedSize = fs::file_size(inPath),
+		.dictionary = zstdDictionaries.findCDict(outPath.filename().string(), level),
+	};
+
+	std::ofstream outfile(outPath, std::ios::out | std::ios::binary);
+	return zs::compressStream(infile, makeStreamSink(outfile), options);
+}
+
+// prints to stdout if `outPath` is empty. the JSON is written out while the document is walked, so it never has to fit
+// in memory
+hk::Result read_byml(const fs::path& inPath, const fs::path& outPath) {
+	archive::File file;
+	HK_TRY(file.openAs(inPath, archive::Format::Byml, &zstdDictionaries));
+
+	byml::Reader byml;
+	HK_TRY(byml.init(file.getData().data(), file.getData().size()));
+
+	std::ofstream outfile;
+	if (!outPath.empty()) {
+		outfile.open(outPath, std::ios::out | std::ios::binary);
+		if (!outfile) return ResultFileError();
+	}
+
+	const Sink sink = outPath.empty() ? makeFileSink(stdout) : makeStreamSink(outfile);
+	json::Writer writer(sink);
+	HK_TRY(json::writeByml(writer, byml));
+	writer.newline();
+
+	return writer.flush();
+}
+
+// the JSON is read twice, first for its strings and then for its values, so neither it nor the BYML is ever held in
+// memory as a whole
+hk::Result write_byml(const fs::path& inPath, const fs::path& outPath, const byml::EncodeOptions& options) {
+	std::ifstream infile(inPath, std::ios::in | std::ios::binary);
+	if (!infile) return ResultFileError();
+
+	// read as well as written, so that shared containers can be compared with the copy written before
+	std::fstream outfile(outPath, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!outfile) return ResultFileError();
+
+	return byml::encodeJson(infile, outfile, options);
+}
+
+// scalar edits are written over the values they replace, and anything else rebuilds the document. `outPath` can be
+// `inPath`
+hk::Result patch_byml(const fs::path& inPath, const fs::path& patchPath, const fs::path& outPath) {
+	std::ifstream patchFile(patchPath, std::ios::in | std::ios::binary);
+	if (!patchFile) return ResultFileError();
+
+	std::vector<patch::Operation> operations;
+	HK_TRY(patch::parseOperations(operations, patchFile));
+
+	archive::File file;
+	HK_TRY(file.openAs(inPath, archive::Format::Byml, &zstdDictionaries));
+	std::vector<u8> data(file.getData().begin(), file.getData().end());
+
+	patch::Stats stats;
+	HK_TRY(patch::patchByml(data, operations, stats));
+
+	// compressed the way the input was, and only replacing the output once it's complete, since it may be the input
+	HK_TRY(archive::compressLayers(data, file.getLayers(), outPath.filename().string(), &zstdDictionaries));
+	HK_TRY(writeFileReplacing(outPath, [&](const Sink& sink) { return sink(data); }));
+
+	if (stats.isRebuilt)
+		fprintf(stderr, "applied %zu operations by rebuilding the document\n", operations.size());
+	else
+		fprintf(stderr, "applied %u operations in place\n", stats.numInPlace);
+
+	return hk::ResultSuccess();
+}
+
+// two directories are diffed file by file on a thread pool, anything else as a pair of BYMLs
+hk::Result diff_byml(const fs::path& pathA, const fs::path& pathB, u32 numThreads) {
+	const Sink sink = makeFileSink(stdout);
+	json::Writer writer(sink, false);
+
+	if (fs::is_directory(pathA) && fs::is_directory(pathB)) {
+		ThreadPool pool(numThreads);
+		diff::TreeStats stats;
+		HK_TRY(diff::diffTrees(writer, stats, pathA, pathB, &zstdDictionaries, pool));
+		HK_TRY(writer.flush());
+
+		for (const diff::TreeFailure& failure : stats.failures)
+			fprintf(stderr, "error: %s: %s\n", failure.path.string().c_str(), hk::diag::getResultName(failure.result));
+
+		fprintf(
+			stderr, "compared %llu files on %u threads: %llu changed (%llu changes), %zu failed\n",
+			(unsigned long long)stats.numFiles, pool.getNumThreads(), (unsigned long long)stats.numChangedFiles,
+			(unsigned long long)stats.numChanges, stats.failures.size()
+		);
+
+		return stats.failures.empty() ? hk::ResultSuccess() : utils::ResultBatchJobFailed();
+	}
+
+	archive::File fileA;
+	archive::File fileB;
+	HK_TRY(fileA.openAs(pathA, archive::Format::Byml, &zstdDictionaries));
+	HK_TRY(fileB.openAs(pathB, archive::Format::Byml, &zstdDictionaries));
+
+	u64 numChanges = 0;
+	HK_TRY(diff::diffByml(numChanges, writer, fileA.getData(), fileB.getData()));
+	return writer.flush();
+}
+
+// `spec` is a file, or a glob, directory or @manifest as in batch mode. files are queried in parallel, and each one's
+// matches are printed as soon as it's done, so the order of files in the output isn't fixed
+hk::Result query_byml(const std::string& spec, std::string_view path, u32 numThreads) {
+	std::vector<query::Step> steps;
+	HK_TRY(query::parsePath(steps, path));
+
+	std::vector<BatchInput> inputs;
+	if (fs::is_regular_file(spec)) inputs.push_back({ spec, spec });
+	else HK_TRY(collectBatchInputs(inputs, spec, false, ""));
+
+	ThreadPool pool(numThreads);
+	std::mutex outMutex;
+	std::vector<hk::Result> results(inputs.size(), hk::ResultSuccess());
+	std::atomic<u64> numMatches = 0;
+
+	pool.forEach(inputs.size(), [&](size_t i) {
+		std::vector<u8> buffer;
+		const Sink sink = makeVectorSink(buffer);
+		json::Writer writer(sink, false);
+
+		u64 fileMatches = 0;
+		archive::File file;
+		results[i] = file.open(inputs[i].path, &zstdDictionaries);
+		if (results[i].succeeded())
+			results[i] = query::queryFile(
+				fileMatches, writer, file, inputs[i].relPath.generic_string(), steps, &zstdDictionaries
+			);
+		if (results[i].succeeded()) results[i] = writer.flush();
+		numMatches += fileMatches;
+		if (buffer.empty()) return;
+
+		std::lock_guard lock(outMutex);
+		fwrite(buffer.data(), 1, buffer.size(), stdout);
+	});
+
+	size_t numFailed = 0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		if (results[i].succeeded()) continue;
+		fprintf(stderr, "error: %s: %s\n", inputs[i].path.string().c_str(), hk::diag::getResultName(results[i]));
+		numFailed++;
+	}
+
+	fprintf(
+		stderr, "queried %zu files on %u threads: %llu matches, %zu failed\n", inputs.size(), pool.getNumThreads(),
+		(unsigned long long)numMatches.load(), numFailed
+	);
+
+	return numFailed == 0 ? hk::ResultSuccess() : utils::ResultBatchJobFailed();
+}
+
+hk::Result transform_romfs(
+	const fs::path& romfsDir, const fs::path& specPath, const fs::path& outDir, u32 numThreads
+) {
+	std::ifstream specFile(specPath, std::ios::in | std::ios::binary);
+	if (!specFile) return ResultFileError();
+
+	transform::Spec spec;
+	HK_TRY(transform::parseSpec(spec, specFile));
+
+	ThreadPool pool(numThreads);
+	transform::Stats stats;
+	HK_TRY(transform::transformAll(romfsDir, outDir, spec, &zstdDictionaries, pool, stats));
+
+	for (const transform::Failure& failure : stats.failures)
+		fprintf(stderr, "error: %s: %s\n", failure.path.string().c_str(), hk::diag::getResultName(failure.result));
+
+	printf(
+		"edited %llu objects in %llu of %llu archives on %u threads, %zu failed\n",
+		(unsigned long long)stats.numObjects, (unsigned long long)stats.numChanged,
+		(unsigned long long)stats.numArchives, pool.getNumThreads(), stats.failures.size()
+	);
+	printf(
+		"%llu BYMLs patched in place, %llu of %llu compressed bytes reused\n", (unsigned long long)stats.numInPlace,
+		(unsigned long long)stats.reusedSize, (unsigned long long)stats.compressedSize
+	);
+
+	return stats.failures.empty() ? hk::ResultSuccess() : utils::ResultBatchJobFailed();
+}
+
 hk::Result handle_yaz0(s32 argc, char* argv[]) {
 	if (argc < 3 || util::isEqual(argv[2], "--help")) {
 		fprintf(stderr, "usage: %s yaz0 r <compressed file> <decompressed file>\n", programName.c_str());
@@ -228,14 +460,7 @@ hk::Result handle_yaz0(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
-
-		std::vector<u8> outputBuffer;
-		HK_TRY(yaz0::decompress(outputBuffer, fileContents));
-
-		std::ofstream outfile(argv[4], std::ios::out | std::ios::binary);
-		outfile.write(reinterpret_cast<const char*>(outputBuffer.data()), outputBuffer.size());
+		HK_TRY(read_yaz0(argv[3], argv[4]));
 	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
 		if (argc < 5) {
 			fprintf(
@@ -244,15 +469,9 @@ hk::Result handle_yaz0(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		u32 alignment = argc > 5 ? atoi(argv[5]) : 0x80;
+		u32 alignment = argc > 5 ? HK_TRY(parse_u32_arg(argv[5], "alignment")) : 0x80;
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
-
-		std::vector<u8> outputBuffer;
-		yaz0::compress(outputBuffer, fileContents, alignment);
-
-		util::writeFile(argv[4], outputBuffer);
+		HK_TRY(write_yaz0(argv[3], argv[4], alignment));
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
 		return hk::ResultInvalidArgument();
@@ -266,7 +485,7 @@ hk::Result handle_sarc(s32 argc, char* argv[]) {
 		fprintf(stderr, "usage: %s sarc r|read <archive> <output dir>\n", programName.c_str());
 		fprintf(stderr, "       %s sarc w|write <input dir> <output archive> [alignment]\n", programName.c_str());
 		fprintf(stderr, "       %*s         (default alignment: 0x80)\n", (s32)programName.length(), "");
-		fprintf(stderr, "       %s sarc l|list <archive>\n", programName.c_str());
+		fprintf(stderr, "       %s sarc l|list <archive> [--long]\n", programName.c_str());
 		return hk::ResultInvalidArgument();
 	}
 
@@ -276,66 +495,25 @@ hk::Result handle_sarc(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::string archiveName = argv[3];
-
-		std::vector<u8> fileContents;
-		if (archiveName.find(".zs") != std::string::npos) {
-			std::vector<u8> compressedContents;
-			HK_TRY(util::readFile(compressedContents, archiveName));
-			u64 decompSize = ZSTD_getFrameContentSize(compressedContents.data(), compressedContents.size());
-			fileContents.resize(decompSize);
-			ZSTD_decompress(
-				fileContents.data(), fileContents.size(), compressedContents.data(), compressedContents.size()
-			);
-		} else {
-			HK_TRY(util::readFile(fileContents, archiveName));
-		}
-		sarc::Reader sarc(fileContents);
-		HK_TRY(sarc.init());
-
-		HK_TRY(sarc.saveAll(argv[4]));
+		ThreadPool pool;
+		HK_TRY(read_sarc(argv[3], argv[4], &pool));
 	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
 		if (argc < 5) {
 			fprintf(stderr, "usage: %s sarc w|write <input dir> <output archive> [alignment]\n", programName.c_str());
 			return hk::ResultInvalidArgument();
 		}
 
-		fs::path inDir = argv[3];
-		if (!fs::is_directory(inDir)) {
-			return ResultDirNotFound();
-		}
+		u32 alignment = argc > 5 ? HK_TRY(parse_u32_arg(argv[5], "alignment")) : 0x80;
 
-		u32 alignment = argc > 5 ? atoi(argv[5]) : 0x80;
-
-		sarc::Writer writer;
-
-		for (const auto& entry : fs::recursive_directory_iterator(inDir)) {
-			fs::path entryPath = entry.path();
-			fs::path relPath = fs::relative(entryPath, inDir);
-
-			if (entry.is_directory()) continue;
-
-			std::vector<u8> fileContents;
-			HK_TRY(util::readFile(fileContents, entryPath));
-
-			writer.addFile(relPath.string(), fileContents);
-		}
-
-		writer.save(argv[4], util::ByteOrder::Little, alignment);
+		ThreadPool pool;
+		HK_TRY(write_sarc(argv[3], argv[4], alignment, &pool));
 	} else if (util::isEqual(argv[2], "list") || util::isEqual(argv[2], "l")) {
 		if (argc < 4) {
-			fprintf(stderr, "usage: %s sarc l|list <archive>\n", programName.c_str());
+			fprintf(stderr, "usage: %s sarc l|list <archive> [--long]\n", programName.c_str());
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
-
-		sarc::Reader sarc(fileContents);
-		HK_TRY(sarc.init());
-
-		for (const std::string& filename : sarc.getFilenames())
-			printf("%s\n", filename.c_str());
+		HK_TRY(list_sarc(argv[3], argc > 4 && util::isEqual(argv[4], "--long")));
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
 		return hk::ResultInvalidArgument();
@@ -347,8 +525,12 @@ hk::Result handle_sarc(s32 argc, char* argv[]) {
 hk::Result handle_szs(s32 argc, char* argv[]) {
 	if (argc < 3 || util::isEqual(argv[2], "--help")) {
 		fprintf(stderr, "usage: %s szs r|read <archive> <output dir>\n", programName.c_str());
-		fprintf(stderr, "       %s szs w|write <input dir> <output archive>\n", programName.c_str());
-		fprintf(stderr, "       %s szs l|list <archive>\n", programName.c_str());
+		fprintf(stderr, "       %s szs w|write <input dir> <output archive> [--index]\n", programName.c_str());
+		fprintf(stderr, "       %s szs u|update <base archive> <input dir> <output archive>\n", programName.c_str());
+		fprintf(stderr, "       %s szs l|list <archive> [--long]\n", programName.c_str());
+		fprintf(stderr, "       %s szs x|extract <archive> <file> <output file>\n", programName.c_str());
+		fprintf(stderr, "       %s szs i|index <archive> [interval in KiB]\n", programName.c_str());
+		fprintf(stderr, "       %*s        (default interval: 64)\n", (s32)programName.length(), "");
 		return hk::ResultInvalidArgument();
 	}
 
@@ -358,63 +540,128 @@ hk::Result handle_szs(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
-
-		std::vector<u8> decompressed;
-		HK_TRY(yaz0::decompress(decompressed, fileContents));
-
-		sarc::Reader sarc(decompressed);
-		HK_TRY(sarc.init());
-
-		HK_TRY(sarc.saveAll(argv[4]));
+		ThreadPool pool;
+		HK_TRY(read_sarc(argv[3], argv[4], &pool));
 	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
 		if (argc < 5) {
-			fprintf(stderr, "usage: %s szs w|write <input dir> <output archive>\n", programName.c_str());
+			fprintf(stderr, "usage: %s szs w|write <input dir> <output archive> [--index]\n", programName.c_str());
 			return hk::ResultInvalidArgument();
 		}
 
-		fs::path inDir = argv[3];
-		if (!fs::is_directory(inDir)) {
-			return ResultDirNotFound();
+		bool isWriteIndex = argc > 5 && util::isEqual(argv[5], "--index");
+
+		HK_TRY(write_szs(argv[3], argv[4], isWriteIndex));
+	} else if (util::isEqual(argv[2], "update") || util::isEqual(argv[2], "u")) {
+		if (argc < 6) {
+			fprintf(
+				stderr, "usage: %s szs u|update <base archive> <input dir> <output archive>\n", programName.c_str()
+			);
+			return hk::ResultInvalidArgument();
 		}
 
-		sarc::Writer writer;
+		szs::RepackStats stats;
+		HK_TRY(szs::repack(argv[3], argv[4], argv[5], stats));
+		printf("reused %u of %u compressed bytes\n", stats.reusedSize, stats.compressedSize);
 
-		for (const auto& entry : fs::recursive_directory_iterator(inDir)) {
-			fs::path entryPath = entry.path();
-			fs::path relPath = fs::relative(entryPath, inDir);
+		// an index made for whatever was there before would no longer match
+		std::error_code ec;
+		fs::remove(get_seek_index_path(argv[5]), ec);
+	} else if (util::isEqual(argv[2], "list") || util::isEqual(argv[2], "l")) {
+		if (argc < 4) {
+			fprintf(stderr, "usage: %s szs l|list <archive> [--long]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
 
-			std::vector<u8> fileContents;
-			HK_TRY(util::readFile(fileContents, entryPath));
+		HK_TRY(list_sarc(argv[3], argc > 4 && util::isEqual(argv[4], "--long")));
+	} else if (util::isEqual(argv[2], "extract") || util::isEqual(argv[2], "x")) {
+		if (argc < 6) {
+			fprintf(stderr, "usage: %s szs x|extract <archive> <file> <output file>\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
+
+		std::vector<u8> fileContents;
+		HK_TRY(extract_szs_entry(fileContents, argv[3], argv[4]));
 
-			writer.addFile(relPath.string(), fileContents);
+		util::writeFile(argv[5], fileContents);
+	} else if (util::isEqual(argv[2], "index") || util::isEqual(argv[2], "i")) {
+		if (argc < 4) {
+			fprintf(stderr, "usage: %s szs i|index <archive> [interval in KiB]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> sarcContents;
-		writer.saveToVec(sarcContents);
+		u32 interval = cDefaultSeekInterval;
+		if (argc > 4) {
+			u32 intervalKiB;
+			if (!parse_u32(intervalKiB, argv[4]) || intervalKiB == 0 || intervalKiB > cMaxSeekIntervalKiB) {
+				fprintf(stderr, "error: interval must be from 1 to %u KiB\n", cMaxSeekIntervalKiB);
+				return hk::ResultInvalidArgument();
+			}
+			interval = intervalKiB * 1024;
+		}
 
 		std::vector<u8> szsContents;
-		yaz0::compress(szsContents, sarcContents, 0xc);
+		HK_TRY(util::readFile(szsContents, argv[3]));
 
-		util::writeFile(argv[4], szsContents);
-	} else if (util::isEqual(argv[2], "list") || util::isEqual(argv[2], "l")) {
-		if (argc < 4) {
-			fprintf(stderr, "usage: %s szs l|list <archive>\n", programName.c_str());
+		std::vector<u8> sarcContents;
+		HK_TRY(yaz0::decompressFast(sarcContents, szsContents));
+
+		HK_TRY(save_seek_index(argv[3], szsContents, sarcContents, interval));
+	} else {
+		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
+		return hk::ResultInvalidArgument();
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result handle_zs(s32 argc, char* argv[]) {
+	if (argc < 3 || util::isEqual(argv[2], "--help")) {
+		fprintf(stderr, "usage: %s zs r|read <compressed file> <decompressed file>\n", programName.c_str());
+		fprintf(
+			stderr, "       %s zs w|write <decompressed file> <compressed file> [level] [threads]\n",
+			programName.c_str()
+		);
+		fprintf(stderr, "       (default level: %d, default threads: one per hardware thread)\n", zs::cDefaultLevel);
+		fprintf(stderr, "       %s zs l|list <archive> [--long]\n", programName.c_str());
+		return hk::ResultInvalidArgument();
+	}
+
+	if (util::isEqual(argv[2], "read") || util::isEqual(argv[2], "r")) {
+		if (argc < 5) {
+			fprintf(stderr, "usage: %s zs r|read <compressed file> <decompressed file>\n", programName.c_str());
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
+		HK_TRY(read_zs(argv[3], argv[4]));
+	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
+		if (argc < 5) {
+			fprintf(
+				stderr, "usage: %s zs w|write <decompressed file> <compressed file> [level] [threads]\n",
+				programName.c_str()
+			);
+			return hk::ResultInvalidArgument();
+		}
 
-		std::vector<u8> decompressed;
-		HK_TRY(yaz0::decompress(decompressed, fileContents));
+		// negative levels are zstd's fastest
+		s32 level = zs::cDefaultLevel;
+		if (argc > 5) {
+			const char* end = argv[5] + std::strlen(argv[5]);
+			auto [ptr, ec] = std::from_chars(argv[5], end, level);
+			if (ec != std::errc() || ptr != end || level < ZSTD_minCLevel() || level > ZSTD_maxCLevel()) {
+				fprintf(stderr, "error: level must be from %d to %d\n", ZSTD_minCLevel(), ZSTD_maxCLevel());
+				return hk::ResultInvalidArgument();
+			}
+		}
+		u32 numWorkers = argc > 6 ? HK_TRY(parse_u32_arg(argv[6], "threads")) : std::thread::hardware_concurrency();
 
-		sarc::Reader sarc(decompressed);
-		HK_TRY(sarc.init());
+		HK_TRY(write_zs(argv[3], argv[4], level, numWorkers));
+	} else if (util::isEqual(argv[2], "list") || util::isEqual(argv[2], "l")) {
+		if (argc < 4) {
+			fprintf(stderr, "usage: %s zs l|list <archive> [--long]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
 
-		for (const std::string& filename : sarc.getFilenames())
-			printf("%s\n", filename.c_str());
+		HK_TRY(list_sarc(argv[3], argc > 4 && util::isEqual(argv[4], "--long")));
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
 		return hk::ResultInvalidArgument();
@@ -435,10 +682,10 @@ hk::Result handle_bffnt(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
+		archive::File file;
+		HK_TRY(file.openAs(argv[3], archive::Format::Bffnt, &zstdDictionaries));
 
-		BFFNT bffnt(fileContents);
+		BFFNT bffnt(file.getBuffer());
 		HK_TRY(bffnt.read());
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
@@ -460,10 +707,10 @@ hk::Result handle_bntx(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
+		archive::File file;
+		HK_TRY(file.openAs(argv[3], archive::Format::Bntx, &zstdDictionaries));
 
-		BNTX bntx(fileContents);
+		BNTX bntx(file.getBuffer());
 		HK_TRY(bntx.read());
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
@@ -476,7 +723,13 @@ hk::Result handle_bntx(s32 argc, char* argv[]) {
 hk::Result handle_byml(s32 argc, char* argv[]) {
 	if (argc < 3 || util::isEqual(argv[2], "--help")) {
 		fprintf(stderr, "usage: %s byml r <input file> [output json]\n", programName.c_str());
-		fprintf(stderr, "       %s byml w <output file>\n", programName.c_str());
+		fprintf(stderr, "       %s byml w <input json> <output file> [le|be] [version]\n", programName.c_str());
+		fprintf(stderr, "       %*s         (default: le 3, as in SMO)\n", (s32)programName.length(), "");
+		fprintf(stderr, "       %s byml d|diff <a> <b> [threads]\n", programName.c_str());
+		fprintf(stderr, "       %*s         (two files, or two directories)\n", (s32)programName.length(), "");
+		fprintf(stderr, "       %s byml q|query <file|glob|dir|@manifest> <path> [threads]\n", programName.c_str());
+		fprintf(stderr, "       %*s         (e.g. '0/ObjectList/*/UnitConfigName')\n", (s32)programName.length(), "");
+		fprintf(stderr, "       %s byml p|patch <input file> <patch json> <output file>\n", programName.c_str());
 		return hk::ResultInvalidArgument();
 	}
 
@@ -486,24 +739,54 @@ hk::Result handle_byml(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
+		HK_TRY(read_byml(argv[3], argc < 5 ? "" : argv[4]));
+	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
+		if (argc < 5) {
+			fprintf(stderr, "usage: %s byml w <input json> <output file> [le|be] [version]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
+
+		byml::EncodeOptions options;
+		for (s32 i = 5; i < argc; i++) {
+			if (util::isEqual(argv[i], "le"))
+				options.byteOrder = util::ByteOrder::Little;
+			else if (util::isEqual(argv[i], "be"))
+				options.byteOrder = util::ByteOrder::Big;
+			else {
+				u32 version;
+				if (!parse_u32(version, argv[i]) || version < byml::cMinVersion || version > byml::cMaxVersion) {
+					fprintf(
+						stderr, "error: '%s' is neither le, be nor a version between %u and %u\n", argv[i],
+						byml::cMinVersion, byml::cMaxVersion
+					);
+					return hk::ResultInvalidArgument();
+				}
+				options.version = version;
+			}
+		}
 
-		byml::Reader byml;
-		HK_TRY(byml.init(fileContents.data(), fileContents.size()));
+		HK_TRY(write_byml(argv[3], argv[4], options));
+	} else if (util::isEqual(argv[2], "diff") || util::isEqual(argv[2], "d")) {
+		if (argc < 5) {
+			fprintf(stderr, "usage: %s byml d|diff <a> <b> [threads]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
 
-		std::string out;
-		HK_TRY(print_byml(out, byml));
+		HK_TRY(diff_byml(argv[3], argv[4], argc < 6 ? 0 : HK_TRY(parse_u32_arg(argv[5], "threads"))));
+	} else if (util::isEqual(argv[2], "query") || util::isEqual(argv[2], "q")) {
+		if (argc < 5) {
+			fprintf(stderr, "usage: %s byml q|query <file|glob|dir|@manifest> <path> [threads]\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
 
-		if (argc < 5)
-			printf("%s\n", out.c_str());
-		else
-			util::writeFile(argv[4], out + '\n');
-	} else if (util::isEqual(argv[2], "write") || util::isEqual(argv[2], "w")) {
-		if (argc < 4) {
-			fprintf(stderr, "usage: %s byml w <output file>\n", programName.c_str());
+		HK_TRY(query_byml(argv[3], argv[4], argc < 6 ? 0 : HK_TRY(parse_u32_arg(argv[5], "threads"))));
+	} else if (util::isEqual(argv[2], "patch") || util::isEqual(argv[2], "p")) {
+		if (argc < 6) {
+			fprintf(stderr, "usage: %s byml p|patch <input file> <patch json> <output file>\n", programName.c_str());
 			return hk::ResultInvalidArgument();
 		}
+
+		HK_TRY(patch_byml(argv[3], argv[4], argv[5]));
 	} else {
 		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
 		return hk::ResultInvalidArgument();
@@ -525,10 +808,10 @@ hk::Result handle_bfres(s32 argc, char* argv[]) {
 			return hk::ResultInvalidArgument();
 		}
 
-		std::vector<u8> fileContents;
-		HK_TRY(util::readFile(fileContents, argv[3]));
+		archive::File file;
+		HK_TRY(file.openAs(argv[3], archive::Format::Bfres, &zstdDictionaries));
 
-		bfres::Reader bfres(fileContents);
+		bfres::Reader bfres(file.getBuffer());
 		HK_TRY(bfres.read());
 
 		HK_TRY(bfres.exportGLTF(argv[4]));
@@ -545,12 +828,242 @@ hk::Result handle_bfres(s32 argc, char* argv[]) {
 	return hk::ResultSuccess();
 }
 
+struct BatchOperation {
+	const char* format;
+	const char* option;
+	const char* shortOption;
+	bool isDirectoryInput;       // archives are written from directories
+	const char* inputExtension;  // picked up when the input is a directory
+	fs::path (*getOutputPath)(const fs::path& outDir, const fs::path& relPath);
+	hk::Result (*run)(const fs::path& inPath, const fs::path& outPath);
+};
+
+const BatchOperation cBatchOperations[] = {
+	{ "yaz0", "read", "r", false, ".szs",
+	  [](const fs::path& outDir, const fs::path& relPath) {
+		  fs::path outPath = outDir / relPath;
+		  if (relPath.extension() == ".szs") return outPath.replace_extension(".sarc");
+		  if (relPath.extension() == ".yaz0") return outPath.replace_extension();
+		  return outPath += ".bin";
+	  },
+	  read_yaz0 },
+	{ "yaz0", "write", "w", false, "",
+	  [](const fs::path& outDir, const fs::path& relPath) {
+		  fs::path outPath = outDir / relPath;
+		  return relPath.extension() == ".sarc" ? outPath.replace_extension(".szs") : outPath += ".yaz0";
+	  },
+	  [](const fs::path& inPath, const fs::path& outPath) { return write_yaz0(inPath, outPath, 0x80); } },
+	{ "sarc", "read", "r", false, ".sarc",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath).replace_extension(); },
+	  // the pool is already busy with other inputs, so each archive is extracted on its own job's thread
+	  [](const fs::path& inPath, const fs::path& outPath) { return read_sarc(inPath, outPath, nullptr); } },
+	{ "sarc", "write", "w", true, "",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath) += ".sarc"; },
+	  [](const fs::path& inPath, const fs::path& outPath) { return write_sarc(inPath, outPath, 0x80, nullptr); } },
+	{ "szs", "read", "r", false, ".szs",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath).replace_extension(); },
+	  [](const fs::path& inPath, const fs::path& outPath) { return read_sarc(inPath, outPath, nullptr); } },
+	{ "szs", "write", "w", true, "",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath) += ".szs"; },
+	  [](const fs::path& inPath, const fs::path& outPath) { return write_szs(inPath, outPath, false); } },
+	{ "zs", "read", "r", false, ".zs",
+	  [](const fs::path& outDir, const fs::path& relPath) {
+		  fs::path outPath = outDir / relPath;
+		  return relPath.extension() == ".zs" ? outPath.replace_extension() : outPath += ".bin";
+	  },
+	  read_zs },
+	{ "zs", "write", "w", false, "",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath) += ".zs"; },
+	  // the pool already keeps every core busy, so each file compresses on a single thread
+	  [](const fs::path& inPath, const fs::path& outPath) { return write_zs(inPath, outPath, zs::cDefaultLevel, 0); } },
+	{ "byml", "read", "r", false, ".byml",
+	  [](const fs::path& outDir, const fs::path& relPath) { return (outDir / relPath).replace_extension(".json"); },
+	  read_byml },
+};
+
+hk::Result handle_batch(s32 argc, char* argv[]) {
+	if (argc < 6 || util::isEqual(argv[2], "--help")) {
+		fprintf(stderr, "usage: %s batch <format> <option> <inputs> <output dir> [threads]\n", programName.c_str());
+		fprintf(stderr, "\tsupported: yaz0 r|w, sarc r|w, szs r|w, zs r|w, byml r\n");
+		fprintf(stderr, "\t<inputs> is a directory, a glob (e.g. 'romfs/StageData/*Map.szs'),\n");
+		fprintf(stderr, "\tor @<manifest> listing one input per line\n");
+		fprintf(stderr, "\t(default threads: one per hardware thread)\n");
+		return hk::ResultInvalidArgument();
+	}
+
+	const BatchOperation* op = nullptr;
+	for (const BatchOperation& candidate : cBatchOperations) {
+		if (util::isEqual(argv[2], candidate.format) &&
+		    (util::isEqual(argv[3], candidate.option) || util::isEqual(argv[3], candidate.shortOption)))
+			op = &candidate;
+	}
+
+	if (!op) {
+		fprintf(stderr, "error: '%s %s' has no batch mode\n", argv[2], argv[3]);
+		return hk::ResultInvalidArgument();
+	}
+
+	std::vector<BatchInput> inputs;
+	HK_TRY(collectBatchInputs(inputs, argv[4], op->isDirectoryInput, op->inputExtension));
+
+	const fs::path outDir = argv[5];
+	u32 numThreads = argc > 6 ? HK_TRY(parse_u32_arg(argv[6], "threads")) : 0;
+
+	// inputs sharing an output would race each other, and only one of them would survive
+	std::map<fs::path, const fs::path*> outputs;
+	for (const BatchInput& input : inputs) {
+		const fs::path outPath = op->getOutputPath(outDir, input.relPath).lexically_normal();
+		const auto [it, isNew] = outputs.emplace(outPath, &input.path);
+		if (isNew) continue;
+
+		fprintf(
+			stderr, "error: %s and %s would both be written to %s\n", it->second->string().c_str(),
+			input.path.string().c_str(), outPath.string().c_str()
+		);
+		return hk::ResultInvalidArgument();
+	}
+
+	std::vector<hk::Result> results(inputs.size());
+	ThreadPool pool(numThreads);
+	pool.forEach(inputs.size(), [&](size_t i) {
+		const fs::path outPath = op->getOutputPath(outDir, inputs[i].relPath);
+
+		std::error_code ec;
+		fs::create_directories(outPath.parent_path(), ec);
+		if (ec) {
+			results[i] = ResultFileError();
+			return;
+		}
+
+		results[i] = op->run(inputs[i].path, outPath);
+	});
+
+	u32 numFailed = 0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		if (results[i].succeeded()) continue;
+
+		fprintf(stderr, "error: %s: %s\n", inputs[i].path.string().c_str(), hk::diag::getResultName(results[i]));
+		numFailed++;
+	}
+
+	printf("processed %zu files (%u failed) on %u threads\n", inputs.size(), numFailed, pool.getNumThreads());
+
+	return numFailed == 0 ? hk::ResultSuccess() : utils::ResultBatchJobFailed();
+}
+
+hk::Result handle_romfs(s32 argc, char* argv[]) {
+	if (argc < 3 || util::isEqual(argv[2], "--help")) {
+		fprintf(
+			stderr, "usage: %s romfs x|extract <romfs dir> <output dir> [--manifest] [threads]\n", programName.c_str()
+		);
+		fprintf(stderr, "\tunpacks every archive, nested ones included, and stores identical files once:\n");
+		fprintf(stderr, "\tduplicates are hardlinked, or listed in <output dir>/dedup-manifest.tsv with --manifest\n");
+		fprintf(stderr, "\t(default threads: one per hardware thread)\n");
+		fprintf(stderr, "usage: %s romfs r|read <romfs dir> <path> <output file>\n", programName.c_str());
+		fprintf(stderr, "\treads one file, where <path> may run into archives, e.g.\n");
+		fprintf(stderr, "\tStageData/FooStageMap.szs/FooStageMap.byml\n");
+		fprintf(
+			stderr, "usage: %s romfs t|transform <romfs dir> <spec json> <output dir> [threads]\n",
+			programName.c_str()
+		);
+		fprintf(stderr, "\tedits every matching object in StageData and writes only the archives that changed\n");
+		return hk::ResultInvalidArgument();
+	}
+
+	if (util::isEqual(argv[2], "read") || util::isEqual(argv[2], "r")) {
+		if (argc < 6) {
+			fprintf(stderr, "usage: %s romfs r|read <romfs dir> <path> <output file>\n", programName.c_str());
+			return hk::ResultInvalidArgument();
+		}
+
+		vfs::FileSystem romfs(argv[3], vfs::cDefaultCacheBudget, &zstdDictionaries);
+		vfs::FileHandle file;
+		HK_TRY(romfs.open(file, argv[4]));
+
+		return sarc::writeEntryData(argv[5], file.getData());
+	}
+
+	if (util::isEqual(argv[2], "extract") || util::isEqual(argv[2], "x")) {
+		if (argc < 5) {
+			fprintf(
+				stderr, "usage: %s romfs x|extract <romfs dir> <output dir> [--manifest] [threads]\n",
+				programName.c_str()
+			);
+			return hk::ResultInvalidArgument();
+		}
+
+		romfs::ExtractOptions options = { .dictionaries = &zstdDictionaries };
+		u32 numThreads = 0;
+		for (s32 i = 5; i < argc; i++) {
+			if (util::isEqual(argv[i], "--manifest"))
+				options.isWriteManifest = true;
+			else
+				numThreads = HK_TRY(parse_u32_arg(argv[i], "threads"));
+		}
+
+		ThreadPool pool(numThreads);
+		romfs::ExtractStats stats;
+		HK_TRY(romfs::extractAll(argv[3], argv[4], options, pool, stats));
+
+		for (const romfs::ExtractFailure& failure : stats.failures)
+			fprintf(stderr, "error: %s: %s\n", failure.path.string().c_str(), hk::diag::getResultName(failure.result));
+
+		constexpr f64 cMiB = 1024.0 * 1024.0;
+		const u64 numDuplicates = stats.numFiles - stats.numUnique;
+		printf(
+			"extracted %llu files (%.1f MiB) on %u threads, %zu failed\n", (unsigned long long)stats.numFiles,
+			stats.totalSize / cMiB, pool.getNumThreads(), stats.failures.size()
+		);
+		printf(
+			"%llu unique, %llu duplicates %s: %.1f MiB written, %.1f MiB saved\n", (unsigned long long)stats.numUnique,
+			(unsigned long long)numDuplicates, options.isWriteManifest ? "listed in the manifest" : "hardlinked",
+			stats.writtenSize / cMiB, (stats.totalSize - stats.writtenSize) / cMiB
+		);
+
+		if (!stats.failures.empty()) return utils::ResultBatchJobFailed();
+	} else if (util::isEqual(argv[2], "transform") || util::isEqual(argv[2], "t")) {
+		if (argc < 6) {
+			fprintf(
+				stderr, "usage: %s romfs t|transform <romfs dir> <spec json> <output dir> [threads]\n",
+				programName.c_str()
+			);
+			return hk::ResultInvalidArgument();
+		}
+
+		return transform_romfs(argv[3], argv[4], argv[5], argc >= 7 ? HK_TRY(parse_u32_arg(argv[6], "threads")) : 0);
+	} else {
+		fprintf(stderr, "error: unrecognized option '%s'\n", argv[2]);
+		return hk::ResultInvalidArgument();
+	}
+
+	return hk::ResultSuccess();
+}
+
 s32 main(s32 argc, char* argv[]) {
 	programName = "./" + fs::path(argv[0]).filename().string();
 
+	// `--dict` works with every format, so it's taken out of the arguments before they're handed to a handler
+	std::vector<char*> args;
+	for (s32 i = 0; i < argc; i++) {
+		if (!util::isEqual(argv[i], "--dict") || i + 1 >= argc) {
+			args.push_back(argv[i]);
+			continue;
+		}
+
+		hk::Result r = zstdDictionaries.load(argv[++i]);
+		if (r.failed()) {
+			fprintf(stderr, "error: failed to load dictionary %s: %s\n", argv[i], hk::diag::getResultName(r));
+			return 1;
+		}
+	}
+	argc = args.size();
+	args.push_back(nullptr);
+	argv = args.data();
+
 	if (argc < 2) {
-		fprintf(stderr, "usage: %s <format> <options...>\n", programName.c_str());
-		fprintf(stderr, "\tformats: yaz0, sarc, szs, bffnt, bntx, byml, bfres\n");
+		fprintf(stderr, "usage: %s [--dict <path>...] <format> <options...>\n", programName.c_str());
+		fprintf(stderr, "\tformats: yaz0, sarc, szs, zs, bffnt, bntx, byml, bfres, batch, romfs\n");
+		fprintf(stderr, "\t--dict: zstd dictionary or dictionary pack (a SARC of *.zsdic) for .zs files\n");
 		fprintf(stderr, "\nrun `%s <format> --help` for more info on a specific format\n", programName.c_str());
 		return 1;
 	}
@@ -563,6 +1076,8 @@ s32 main(s32 argc, char* argv[]) {
 		r = handle_sarc(argc, argv);
 	else if (util::isEqual(argv[1], "szs"))
 		r = handle_szs(argc, argv);
+	else if (util::isEqual(argv[1], "zs"))
+		r = handle_zs(argc, argv);
 	else if (util::isEqual(argv[1], "bffnt"))
 		r = handle_bffnt(argc, argv);
 	else if (util::isEqual(argv[1], "bntx"))
@@ -571,16 +1086,24 @@ s32 main(s32 argc, char* argv[]) {
 		r = handle_byml(argc, argv);
 	else if (util::isEqual(argv[1], "bfres"))
 		r = handle_bfres(argc, argv);
+	else if (util::isEqual(argv[1], "batch"))
+		r = handle_batch(argc, argv);
+	else if (util::isEqual(argv[1], "romfs"))
+		r = handle_romfs(argc, argv);
 	else {
 		fprintf(stderr, "error: unrecognized format '%s'\n\n", argv[1]);
 		fprintf(stderr, "usage: %s <format> <options...>\n", argv[0]);
-		fprintf(stderr, "\tformats: yaz0, sarc, szs, bffnt, bntx, byml, bfres\n");
+		fprintf(stderr, "\tformats: yaz0, sarc, szs, zs, bffnt, bntx, byml, bfres, batch, romfs\n");
 		return 1;
 	}
 
+	// these have already been explained by the handler
 	if (r == hk::ResultInvalidArgument() || r == ResultUnimplementedVersion()) return 1;
 
-	if (r.failed()) fprintf(stderr, "error: %s\n", hk::diag::getResultName(r));
+	if (r.failed()) {
+		fprintf(stderr, "error: %s\n", hk::diag::getResultName(r));
+		return 1;
+	}
 
 	return 0;
 }
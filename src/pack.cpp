@@ -0,0 +1,269 @@
+#include "pack.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <hk/ValueOrResult.h>
+#include <mutex>
+#include <thread>
+
+#include "mizuna/results.h"
+
+#ifdef __linux__
+#include "fileio.h"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace sarc {
+
+namespace {
+
+constexpr size_t cStreamChunkSize = 0x40000;
+// chunks the reader thread may get ahead of the sink by
+constexpr size_t cMaxQueuedChunks = 4;
+
+// hands chunks from the reader thread to the sink, making the reader wait while the queue is full
+class ChunkQueue {
+public:
+	// false if the consumer has given up
+	bool push(std::vector<u8>&& chunk) {
+		std::unique_lock lock(mMutex);
+		mNotFull.wait(lock, [this] { return mChunks.size() < cMaxQueuedChunks || mIsCancelled; });
+		if (mIsCancelled) return false;
+
+		mChunks.push_back(std::move(chunk));
+		mNotEmpty.notify_one();
+		return true;
+	}
+
+	// false once the producer has finished and everything has been taken
+	bool pop(std::vector<u8>& chunk) {
+		std::unique_lock lock(mMutex);
+		mNotEmpty.wait(lock, [this] { return !mChunks.empty() || mIsFinished; });
+		if (mChunks.empty()) return false;
+
+		chunk = std::move(mChunks.front());
+		mChunks.pop_front();
+		mNotFull.notify_one();
+		return true;
+	}
+
+	void finish(hk::Result result) {
+		std::lock_guard lock(mMutex);
+		mResult = result;
+		mIsFinished = true;
+		mNotEmpty.notify_one();
+	}
+
+	void cancel() {
+		std::lock_guard lock(mMutex);
+		mIsCancelled = true;
+		mNotFull.notify_one();
+	}
+
+	hk::Result getResult() {
+		std::lock_guard lock(mMutex);
+		return mResult;
+	}
+
+private:
+	std::deque<std::vector<u8>> mChunks;
+	std::mutex mMutex;
+	std::condition_variable mNotEmpty;
+	std::condition_variable mNotFull;
+	hk::Result mResult = hk::ResultSuccess();
+	bool mIsFinished = false;
+	bool mIsCancelled = false;
+};
+
+// reads the archive in order into chunks: metadata, then each file and the padding before it. everything before
+// `start` is skipped, without opening files that end before it
+hk::Result produceChunks(ChunkQueue& queue, const PackSource& source, const Layout& layout, u64 start) {
+	std::vector<size_t> order(source.files.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = i;
+	// empty files share their offset with the file after them, so they have to come first
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		if (layout.offsets[a] != layout.offsets[b]) return layout.offsets[a] < layout.offsets[b];
+		return source.files[a].size < source.files[b].size;
+	});
+
+	std::vector<u8> chunk;
+	chunk.reserve(cStreamChunkSize);
+	auto flushIfFull = [&]() {
+		if (chunk.size() < cStreamChunkSize) return true;
+
+		bool isAccepted = queue.push(std::move(chunk));
+		chunk.clear();
+		chunk.reserve(cStreamChunkSize);
+		return isAccepted;
+	};
+
+	u64 pos = start;
+	if (start < layout.metadata.size()) {
+		chunk.assign(layout.metadata.begin() + start, layout.metadata.end());
+		pos = layout.metadata.size();
+	}
+
+	for (size_t i : order) {
+		const u64 fileEnd = layout.offsets[i] + source.files[i].size;
+		if (fileEnd <= pos) continue;
+
+		if (layout.offsets[i] > pos) {
+			chunk.resize(chunk.size() + (layout.offsets[i] - pos), 0);
+			pos = layout.offsets[i];
+		}
+
+		std::ifstream file(source.paths[i], std::ios::in | std::ios::binary);
+		if (!file) return ResultFileError();
+		file.seekg(pos - layout.offsets[i]);
+
+		u64 left = fileEnd - pos;
+		while (left > 0) {
+			if (!flushIfFull()) return hk::ResultSuccess();
+
+			size_t size = std::min<u64>(left, cStreamChunkSize - std::min(chunk.size(), cStreamChunkSize));
+			size_t start = chunk.size();
+			chunk.resize(start + size);
+			file.read(reinterpret_cast<char*>(chunk.data() + start), size);
+			// the file got shorter since it was listed
+			if (size_t(file.gcount()) != size) return ResultFileError();
+
+			left -= size;
+		}
+		pos = fileEnd;
+	}
+
+	if (!chunk.empty()) queue.push(std::move(chunk));
+
+	return hk::ResultSuccess();
+}
+
+// runs `func(i)` for every file, on `pool` if there is one, and returns the first failure
+hk::Result forEachFile(size_t count, ThreadPool* pool, const std::function<hk::Result(size_t)>& func) {
+	std::vector<hk::Result> results(count);
+	auto run = [&](size_t i) { results[i] = func(i); };
+
+	if (pool)
+		pool->forEach(count, run);
+	else
+		for (size_t i = 0; i < count; i++)
+			run(i);
+
+	for (const hk::Result& result : results)
+		HK_TRY(result);
+
+	return hk::ResultSuccess();
+}
+
+// fails if the file is shorter than when it was listed
+hk::Result readFileInto(u8* out, size_t size, const fs::path& path) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file) return ResultFileError();
+
+	file.read(reinterpret_cast<char*>(out), size);
+	if (size_t(file.gcount()) != size) return ResultFileError();
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result collectPackSource(PackSource& out, const fs::path& inDir) {
+	if (!fs::is_directory(inDir)) return ResultDirNotFound();
+
+	std::vector<fs::path> paths;
+	for (const auto& entry : fs::recursive_directory_iterator(inDir))
+		if (entry.is_regular_file()) paths.push_back(entry.path());
+
+	// keeps the output the same from run to run, whatever order the directory lists in
+	std::sort(paths.begin(), paths.end());
+
+	out.files.clear();
+	out.files.reserve(paths.size());
+	for (const fs::path& path : paths) {
+		std::error_code ec;
+		u64 size = fs::file_size(path, ec);
+		if (ec) return ResultFileError();
+
+		out.files.push_back({ fs::relative(path, inDir).generic_string(), size });
+	}
+	out.paths = std::move(paths);
+
+	return hk::ResultSuccess();
+}
+
+hk::Result packDirectory(
+	const fs::path& inDir, const fs::path& outPath, util::ByteOrder byteOrder, u32 alignment, ThreadPool* pool
+) {
+#ifdef __linux__
+	PackSource source;
+	HK_TRY(collectPackSource(source, inDir));
+
+	Layout layout;
+	HK_TRY(buildLayout(layout, source.files, byteOrder, alignment));
+
+	fileio::FileDescriptor outFd = fileio::openWrite(outPath);
+	if (!outFd.isValid()) return ResultFileError();
+
+	HK_TRY(fileio::preallocate(outFd.get(), layout.archiveSize));
+	HK_TRY(fileio::writeAll(outFd.get(), layout.metadata.data(), layout.metadata.size(), 0));
+
+	return forEachFile(source.files.size(), pool, [&](size_t i) -> hk::Result {
+		fileio::FileDescriptor inFd = fileio::openRead(source.paths[i]);
+		if (!inFd.isValid()) return ResultFileError();
+
+		return fileio::copyRange(inFd.get(), 0, outFd.get(), layout.offsets[i], source.files[i].size);
+	});
+#else
+	std::vector<u8> archive;
+	HK_TRY(packDirectoryToBuffer(archive, inDir, byteOrder, alignment, pool));
+
+	util::writeFile(outPath, archive);
+
+	return hk::ResultSuccess();
+#endif
+}
+
+hk::Result streamArchive(const PackSource& source, const Layout& layout, const Sink& sink, u64 start) {
+	ChunkQueue queue;
+	std::thread reader([&] { queue.finish(produceChunks(queue, source, layout, start)); });
+
+	hk::Result result = hk::ResultSuccess();
+	std::vector<u8> chunk;
+	while (queue.pop(chunk)) {
+		result = sink(chunk);
+		if (result.failed()) {
+			queue.cancel();
+			break;
+		}
+	}
+
+	reader.join();
+	HK_TRY(result);
+
+	return queue.getResult();
+}
+
+hk::Result packDirectoryToBuffer(
+	std::vector<u8>& out, const fs::path& inDir, util::ByteOrder byteOrder, u32 alignment, ThreadPool* pool
+) {
+	PackSource source;
+	HK_TRY(collectPackSource(source, inDir));
+
+	Layout layout;
+	HK_TRY(buildLayout(layout, source.files, byteOrder, alignment));
+
+	// zero-filled, which also takes care of the padding between files
+	out.assign(layout.archiveSize, 0);
+	std::copy(layout.metadata.begin(), layout.metadata.end(), out.begin());
+
+	return forEachFile(source.files.size(), pool, [&](size_t i) {
+		return readFileInto(out.data() + layout.offsets[i], source.files[i].size, source.paths[i]);
+	});
+}
+
+} // namespace sarc
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <vector>
+
+#include "mizuna/util.h"
+#include "pool.h"
+#include "sarc.h"
+#include "stream.h"
+
+namespace sarc {
+
+struct PackSource {
+	std::vector<LayoutFile> files; // names relative to the input directory, with '/' separators
+	std::vector<std::filesystem::path> paths;
+};
+
+// lists the regular files below `inDir` and their sizes without reading them
+hk::Result collectPackSource(PackSource& out, const std::filesystem::path& inDir);
+
+// writes an archive of the files below `inDir` to `outPath`. the layout is worked out from file sizes first, then each
+// file is copied straight to its final offset (kernel-side with copy_file_range where available), on `pool` if given
+hk::Result packDirectory(
+	const std::filesystem::path& inDir, const std::filesystem::path& outPath, util::ByteOrder byteOrder, u32 alignment,
+	ThreadPool* pool
+);
+
+// the same, but into `out`, which is allocated once at the final size and filled in place
+hk::Result packDirectoryToBuffer(
+	std::vector<u8>& out, const std::filesystem::path& inDir, util::ByteOrder byteOrder, u32 alignment, ThreadPool* pool
+);
+
+// passes the archive laid out by `layout` to `sink` from start to end, padding included. files are read ahead on a
+// separate thread, so whatever `sink` does with the data overlaps with the reading. only a few chunks are buffered at
+// a time. with `start`, only the archive from that offset on is passed
+hk::Result streamArchive(const PackSource& source, const Layout& layout, const Sink& sink, u64 start = 0);
+
+} // namespace sarc
@@ -0,0 +1,630 @@
+#include "patch.h"
+
+#include <algorithm>
+#include <charconv>
+#include <set>
+#include <sstream>
+#include <unordered_map>
+
+#include "binary.h"
+#include "byml.h"
+#include "json.h"
+#include "results.h"
+
+namespace patch {
+
+namespace {
+
+// documents nested deeper than this (or with cycles) are taken to be malformed
+constexpr u32 cMaxDepth = 1024;
+
+class ValueBuilder : public json::Handler {
+public:
+	hk::Result beginArray() override { return begin(Value::Kind::Array); }
+	hk::Result endArray() override { return end(); }
+	hk::Result beginObject() override { return begin(Value::Kind::Object); }
+	hk::Result endObject() override { return end(); }
+
+	hk::Result key(std::string_view key) override {
+		mKey = key;
+		return hk::ResultSuccess();
+	}
+
+	hk::Result string(std::string_view value) override {
+		Value& out = next();
+		out.kind = Value::Kind::String;
+		out.text = value;
+		return hk::ResultSuccess();
+	}
+
+	hk::Result number(std::string_view text) override {
+		Value& out = next();
+		out.kind = Value::Kind::Number;
+		out.text = text;
+		return hk::ResultSuccess();
+	}
+
+	hk::Result boolean(bool value) override {
+		Value& out = next();
+		out.kind = Value::Kind::Bool;
+		out.boolean = value;
+		return hk::ResultSuccess();
+	}
+
+	hk::Result null() override {
+		next();
+		return hk::ResultSuccess();
+	}
+
+	Value mRoot;
+
+private:
+	// the next value in the innermost container. only that container grows, so the ones around it never move
+	Value& next() {
+		if (mStack.empty()) return mRoot;
+
+		Value& parent = *mStack.back();
+		if (parent.kind == Value::Kind::Array) return parent.items.emplace_back();
+		return parent.members.emplace_back(mKey, Value()).second;
+	}
+
+	hk::Result begin(Value::Kind kind) {
+		if (mStack.size() >= cMaxDepth) return utils::ResultJsonInvalidSyntax();
+
+		Value& value = next();
+		value.kind = kind;
+		mStack.push_back(&value);
+		return hk::ResultSuccess();
+	}
+
+	hk::Result end() {
+		mStack.pop_back();
+		return hk::ResultSuccess();
+	}
+
+	std::vector<Value*> mStack;
+	std::string mKey;
+};
+
+std::vector<std::string> splitPath(std::string_view path) {
+	std::vector<std::string> out;
+	if (path.starts_with('/')) path.remove_prefix(1);
+	if (path.empty()) return out;
+
+	while (true) {
+		const size_t slash = path.find('/');
+		const std::string_view token = path.substr(0, slash);
+
+		std::string& component = out.emplace_back();
+		for (size_t i = 0; i < token.size(); i++) {
+			if (token[i] == '~' && i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1'))
+				component += token[++i] == '0' ? '~' : '/';
+			else
+				component += token[i];
+		}
+
+		if (slash == std::string_view::npos) break;
+		path.remove_prefix(slash + 1);
+	}
+
+	return out;
+}
+
+bool parseIndex(u32& out, std::string_view token) {
+	const char* end = token.data() + token.size();
+	auto [ptr, ec] = std::from_chars(token.data(), end, out);
+	return !token.empty() && ec == std::errc() && ptr == end;
+}
+
+// patching in place
+
+struct Write {
+	u32 offset;
+	u32 size; // 4, or 8 for 64-bit values
+	u64 bits;
+};
+
+// how many parents point at each container and 64-bit value, counted in one walk over the document
+hk::Result countReferences(std::unordered_map<u32, u32>& out, const byml::Document& document) {
+	const byml::Node root = document.getRoot();
+	if (!byml::isContainer(root.type)) return hk::ResultSuccess();
+
+	out[root.value] = 1;
+	std::vector<byml::Node> stack = { root };
+	while (!stack.empty()) {
+		const byml::Node container = stack.back();
+		stack.pop_back();
+
+		const u32 size = HK_TRY(document.getSize(container));
+		for (u32 i = 0; i < size; i++) {
+			const byml::Node entry = HK_TRY(document.getEntry(container, i));
+			if (!byml::isContainer(entry.type) && !byml::is64(entry.type)) continue;
+
+			// each container is walked the first time it's seen
+			if (++out[entry.value] == 1 && byml::isContainer(entry.type)) stack.push_back(entry);
+		}
+	}
+
+	return hk::ResultSuccess();
+}
+
+// the index of the entry `token` names in a container, or -1
+hk::ValueOrResult<s32> findIndex(const byml::Document& document, byml::Node container, const std::string& token) {
+	if (container.type == byml::NodeType::Hash) {
+		const s32 key = HK_TRY(document.findKey(token));
+		return key < 0 ? -1 : HK_TRY(document.findEntry(container, key));
+	}
+
+	u32 index;
+	if (!parseIndex(index, token) || index >= HK_TRY(document.getSize(container))) return -1;
+	return s32(index);
+}
+
+// what to overwrite to apply `operation` in place, if that's possible
+hk::ValueOrResult<bool> planWrite(
+	Write& out, const byml::Document& document, const std::unordered_map<u32, u32>& references,
+	const Operation& operation
+) {
+	if (operation.type != Operation::Type::Replace || operation.path.empty()) return false;
+
+	auto isShared = [&](u32 offset) {
+		auto it = references.find(offset);
+		return it == references.end() || it->second != 1;
+	};
+
+	byml::Node node = document.getRoot();
+	u32 slot = 0;
+	for (const std::string& token : operation.path) {
+		if (!byml::isContainer(node.type) || isShared(node.value)) return false;
+
+		const s32 index = HK_TRY(findIndex(document, node, token));
+		if (index < 0) return false;
+
+		slot = HK_TRY(document.getEntryOffset(node, index));
+		node = HK_TRY(document.getEntry(node, index));
+	}
+
+	const Value& value = operation.value;
+	switch (node.type) {
+	case byml::NodeType::Bool:
+		if (value.kind != Value::Kind::Bool) return false;
+		out = { slot, 4, value.boolean };
+		return true;
+	case byml::NodeType::Null:
+		if (value.kind != Value::Kind::Null) return false;
+		out = { slot, 4, 0 };
+		return true;
+	case byml::NodeType::String: {
+		if (value.kind != Value::Kind::String) return false;
+
+		// only strings that are in the table already, since adding one moves everything after it
+		const s32 index = HK_TRY(document.findString(value.text));
+		if (index < 0) return false;
+
+		out = { slot, 4, u32(index) };
+		return true;
+	}
+	case byml::NodeType::S32:
+	case byml::NodeType::U32:
+	case byml::NodeType::F32:
+	case byml::NodeType::S64:
+	case byml::NodeType::U64:
+	case byml::NodeType::F64: {
+		if (value.kind != Value::Kind::Number) return false;
+
+		const byml::Number number = HK_TRY(byml::parseNumber(value.text, node.type));
+		if (number.type != node.type) return false;
+		if (!byml::is64(node.type)) {
+			out = { slot, 4, number.bits };
+			return true;
+		}
+
+		// the 8 bytes are elsewhere, and may be pointed to from more than one place
+		HK_TRY(document.get64(node));
+		if (isShared(node.value)) return false;
+
+		out = { node.value, 8, number.bits };
+		return true;
+	}
+	default: return false;
+	}
+}
+
+// rebuilding
+
+// a node of a document being rebuilt. shared containers are copied wherever they're used, and shared again when the
+// document is encoded
+struct TreeNode {
+	byml::NodeType type = byml::NodeType::Null;
+	u64 bits = 0;
+	std::string string;
+	std::vector<u8> binary;
+	std::vector<TreeNode> items;
+	std::vector<std::pair<std::string, TreeNode>> members;
+};
+
+hk::Result decodeScalar(TreeNode& out, const byml::Document& document, byml::Node node) {
+	switch (node.type) {
+	case byml::NodeType::String: out.string = HK_TRY(document.getString(node.value)); break;
+	case byml::NodeType::Binary: {
+		const std::span<const u8> data = HK_TRY(document.getBinary(node));
+		out.binary.assign(data.begin(), data.end());
+		break;
+	}
+	case byml::NodeType::S64:
+	case byml::NodeType::U64:
+	case byml::NodeType::F64: out.bits = HK_TRY(document.get64(node)); break;
+	case byml::NodeType::Bool:
+	case byml::NodeType::S32:
+	case byml::NodeType::U32:
+	case byml::NodeType::F32:
+	case byml::NodeType::Null: out.bits = node.value; break;
+	default: return utils::ResultBymlInvalidData();
+	}
+
+	return hk::ResultSuccess();
+}
+
+// containers are filled in one entry at a time with an explicit stack, as are all the walks over a tree below, so
+// however deep the document is, nothing recurses
+hk::Result decode(TreeNode& out, const byml::Document& document, byml::Node root) {
+	struct Frame {
+		TreeNode* node;
+		byml::Node container;
+		u32 index;
+		u32 size;
+	};
+
+	std::vector<Frame> stack;
+	auto visit = [&](TreeNode& node, byml::Node value) -> hk::Result {
+		node.type = value.type;
+		if (!byml::isContainer(value.type)) return decodeScalar(node, document, value);
+		if (stack.size() >= cMaxDepth) return utils::ResultBymlInvalidData();
+
+		const u32 size = HK_TRY(document.getSize(value));
+		stack.push_back({ &node, value, 0, size });
+		return hk::ResultSuccess();
+	};
+
+	HK_TRY(visit(out, root));
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		if (frame.index == frame.size) {
+			stack.pop_back();
+			continue;
+		}
+
+		// only the innermost container grows, so the nodes further down the stack stay where they are
+		u32 key;
+		const byml::Node entry = HK_TRY(document.getEntry(frame.container, frame.index++, &key));
+		if (frame.container.type == byml::NodeType::Array) {
+			HK_TRY(visit(frame.node->items.emplace_back(), entry));
+		} else {
+			const std::string_view name = HK_TRY(document.getKey(key));
+			HK_TRY(visit(frame.node->members.emplace_back(name, TreeNode()).second, entry));
+		}
+	}
+
+	return hk::ResultSuccess();
+}
+
+// numbers become `preferred` where they fit, as the value they replace was
+hk::Result convert(TreeNode& out, const Value& value, byml::NodeType preferred) {
+	struct Frame {
+		TreeNode* node;
+		const Value* value;
+		size_t index;
+	};
+
+	std::vector<Frame> stack;
+	auto visit = [&](TreeNode& node, const Value& from, byml::NodeType type) -> hk::Result {
+		node = TreeNode();
+		switch (from.kind) {
+		case Value::Kind::Null: return hk::ResultSuccess();
+		case Value::Kind::Bool:
+			node.type = byml::NodeType::Bool;
+			node.bits = from.boolean;
+			return hk::ResultSuccess();
+		case Value::Kind::Number: {
+			const byml::Number number = HK_TRY(byml::parseNumber(from.text, type));
+			node.type = number.type;
+			node.bits = number.bits;
+			return hk::ResultSuccess();
+		}
+		case Value::Kind::String:
+			node.type = byml::NodeType::String;
+			node.string = from.text;
+			return hk::ResultSuccess();
+		case Value::Kind::Array:
+		case Value::Kind::Object:
+			if (stack.size() >= cMaxDepth) return utils::ResultBymlInvalidValue();
+
+			node.type = from.kind == Value::Kind::Array ? byml::NodeType::Array : byml::NodeType::Hash;
+			stack.push_back({ &node, &from, 0 });
+			return hk::ResultSuccess();
+		}
+
+		return utils::ResultBymlInvalidValue();
+	};
+
+	HK_TRY(visit(out, value, preferred));
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		const Value& container = *frame.value;
+		const bool isArray = container.kind == Value::Kind::Array;
+		if (frame.index == (isArray ? container.items.size() : container.members.size())) {
+			stack.pop_back();
+			continue;
+		}
+
+		const size_t i = frame.index++;
+		if (isArray) {
+			HK_TRY(visit(frame.node->items.emplace_back(), container.items[i], byml::NodeType::Null));
+		} else {
+			const auto& [name, member] = container.members[i];
+			HK_TRY(visit(frame.node->members.emplace_back(name, TreeNode()).second, member, byml::NodeType::Null));
+		}
+	}
+
+	return hk::ResultSuccess();
+}
+
+// the index of the entry `token` names in a container's items or members, or -1
+s64 findChild(const TreeNode& container, const std::string& token) {
+	if (container.type == byml::NodeType::Hash) {
+		for (size_t i = 0; i < container.members.size(); i++)
+			if (container.members[i].first == token) return i;
+		return -1;
+	}
+
+	u32 index;
+	if (container.type != byml::NodeType::Array || !parseIndex(index, token) || index >= container.items.size())
+		return -1;
+	return index;
+}
+
+hk::Result apply(TreeNode& root, const Operation& operation) {
+	const std::vector<std::string>& path = operation.path;
+
+	if (path.empty()) {
+		if (operation.type == Operation::Type::Remove) return utils::ResultInvalidArgument();
+		TreeNode value;
+		HK_TRY(convert(value, operation.value, root.type));
+		root = std::move(value);
+		return hk::ResultSuccess();
+	}
+
+	TreeNode* parent = &root;
+	for (size_t i = 0; i + 1 < path.size(); i++) {
+		const s64 index = findChild(*parent, path[i]);
+		if (index < 0) return utils::ResultBymlKeyNotFound();
+		parent = parent->type == byml::NodeType::Hash ? &parent->members[index].second : &parent->items[index];
+	}
+
+	const std::string& last = path.back();
+	const bool isHash = parent->type == byml::NodeType::Hash;
+	const s64 index = findChild(*parent, last);
+	TreeNode* target = index < 0 ? nullptr : isHash ? &parent->members[index].second : &parent->items[index];
+
+	if (operation.type == Operation::Type::Remove) {
+		if (!target) return utils::ResultBymlKeyNotFound();
+
+		if (isHash)
+			parent->members.erase(parent->members.begin() + index);
+		else
+			parent->items.erase(parent->items.begin() + index);
+		return hk::ResultSuccess();
+	}
+
+	TreeNode value;
+	HK_TRY(convert(value, operation.value, target ? target->type : byml::NodeType::Null));
+
+	// adding to a hash replaces the key if it's there already, and adding to an array inserts before the index
+	if (operation.type == Operation::Type::Replace || isHash) {
+		if (target)
+			*target = std::move(value);
+		else if (operation.type == Operation::Type::Add)
+			parent->members.emplace_back(last, std::move(value));
+		else
+			return utils::ResultBymlKeyNotFound();
+		return hk::ResultSuccess();
+	}
+
+	u32 position = parent->items.size();
+	if (parent->type != byml::NodeType::Array || (last != "-" && !parseIndex(position, last)) ||
+	    position > parent->items.size())
+		return utils::ResultBymlKeyNotFound();
+
+	parent->items.insert(parent->items.begin() + position, std::move(value));
+	return hk::ResultSuccess();
+}
+
+void collectStrings(
+	const TreeNode& root, std::set<std::string, std::less<>>& keys, std::set<std::string, std::less<>>& strings
+) {
+	std::vector<const TreeNode*> stack = { &root };
+	while (!stack.empty()) {
+		const TreeNode& node = *stack.back();
+		stack.pop_back();
+
+		if (node.type == byml::NodeType::String) strings.insert(node.string);
+
+		for (const TreeNode& item : node.items)
+			stack.push_back(&item);
+		for (const auto& [name, member] : node.members) {
+			keys.insert(name);
+			stack.push_back(&member);
+		}
+	}
+}
+
+hk::Result encode(byml::Encoder& encoder, const TreeNode& root) {
+	struct Frame {
+		const TreeNode* node;
+		size_t index;
+	};
+
+	std::vector<Frame> stack;
+	auto visit = [&](const TreeNode& node) -> hk::Result {
+		switch (node.type) {
+		case byml::NodeType::Array:
+			HK_TRY(encoder.beginArray());
+			stack.push_back({ &node, 0 });
+			return hk::ResultSuccess();
+		case byml::NodeType::Hash:
+			HK_TRY(encoder.beginHash());
+			stack.push_back({ &node, 0 });
+			return hk::ResultSuccess();
+		case byml::NodeType::String: return encoder.addString(node.string);
+		case byml::NodeType::Binary: return encoder.addBinary(node.binary);
+		default: return encoder.addValue(node.type, node.bits);
+		}
+	};
+
+	HK_TRY(visit(root));
+	while (!stack.empty()) {
+		Frame& frame = stack.back();
+		const TreeNode& node = *frame.node;
+		const bool isArray = node.type == byml::NodeType::Array;
+		if (frame.index == (isArray ? node.items.size() : node.members.size())) {
+			stack.pop_back();
+			HK_TRY(encoder.end());
+			continue;
+		}
+
+		const size_t i = frame.index++;
+		if (isArray) {
+			HK_TRY(visit(node.items[i]));
+		} else {
+			HK_TRY(encoder.setKey(node.members[i].first));
+			HK_TRY(visit(node.members[i].second));
+		}
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result rebuild(std::vector<u8>& data, const byml::Document& document, std::span<const Operation> operations) {
+	TreeNode root;
+	HK_TRY(decode(root, document, document.getRoot()));
+	for (const Operation& operation : operations)
+		HK_TRY(apply(root, operation));
+
+	// the root has to be a container
+	if (!byml::isContainer(root.type)) return utils::ResultBymlInvalidValue();
+
+	std::set<std::string, std::less<>> keys;
+	std::set<std::string, std::less<>> strings;
+	collectStrings(root, keys, strings);
+
+	const byml::EncodeOptions options = {
+		.byteOrder = document.getByteOrder(),
+		.version = document.getVersion(),
+	};
+
+	std::stringstream out(std::ios::in | std::ios::out | std::ios::binary);
+	byml::Encoder encoder(
+		out, options, std::vector<std::string>(keys.begin(), keys.end()),
+		std::vector<std::string>(strings.begin(), strings.end())
+	);
+	HK_TRY(encode(encoder, root));
+	HK_TRY(encoder.finish());
+
+	const std::string bytes = std::move(out).str();
+	data.assign(bytes.begin(), bytes.end());
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result parseValue(Value& out, std::istream& in) {
+	ValueBuilder builder;
+	HK_TRY(json::parse(in, builder));
+
+	out = std::move(builder.mRoot);
+	return hk::ResultSuccess();
+}
+
+const Value* findMember(const Value& object, std::string_view key) {
+	for (const auto& [name, value] : object.members)
+		if (name == key) return &value;
+	return nullptr;
+}
+
+hk::Result parseOperation(Operation& out, const Value& item) {
+	if (item.kind != Value::Kind::Object) return utils::ResultInvalidArgument();
+
+	const Value* op = findMember(item, "op");
+	const Value* path = findMember(item, "path");
+	const Value* value = findMember(item, "value");
+	if (!op || op->kind != Value::Kind::String || !path || path->kind != Value::Kind::String)
+		return utils::ResultInvalidArgument();
+
+	if (op->text == "add")
+		out.type = Operation::Type::Add;
+	else if (op->text == "remove")
+		out.type = Operation::Type::Remove;
+	else if (op->text == "replace")
+		out.type = Operation::Type::Replace;
+	else
+		return utils::ResultInvalidArgument();
+
+	out.value = {};
+	if (out.type != Operation::Type::Remove) {
+		if (!value) return utils::ResultInvalidArgument();
+		out.value = *value;
+	}
+	out.path = splitPath(path->text);
+
+	return hk::ResultSuccess();
+}
+
+hk::Result parseOperations(std::vector<Operation>& out, std::istream& in) {
+	Value root;
+	HK_TRY(parseValue(root, in));
+	if (root.kind != Value::Kind::Array) return utils::ResultInvalidArgument();
+
+	out.clear();
+	for (const Value& item : root.items)
+		HK_TRY(parseOperation(out.emplace_back(), item));
+
+	return hk::ResultSuccess();
+}
+
+hk::Result patchByml(std::vector<u8>& data, std::span<const Operation> operations, Stats& stats) {
+	stats = {};
+
+	byml::Document document;
+	HK_TRY(document.init(data));
+
+	auto isReplace = [](const Operation& operation) { return operation.type == Operation::Type::Replace; };
+	if (std::ranges::all_of(operations, isReplace)) {
+		std::unordered_map<u32, u32> references;
+		HK_TRY(countReferences(references, document));
+
+		std::vector<Write> writes;
+		bool isInPlace = true;
+		for (const Operation& operation : operations) {
+			if (HK_TRY(planWrite(writes.emplace_back(), document, references, operation))) continue;
+			isInPlace = false;
+			break;
+		}
+
+		if (isInPlace) {
+			for (const Write& write : writes) {
+				if (write.size == 8)
+					bin::write<u64>(&data[write.offset], write.bits, document.getByteOrder());
+				else
+					bin::write<u32>(&data[write.offset], write.bits, document.getByteOrder());
+			}
+
+			stats.numInPlace = writes.size();
+			return hk::ResultSuccess();
+		}
+	}
+
+	stats.isRebuilt = true;
+	return rebuild(data, document, operations);
+}
+
+} // namespace patch
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <hk/Result.h>
+#include <hk/types.h>
+#include <istream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace patch {
+
+// a JSON value from an operation list. numbers are kept as their text until the node they go into is known
+struct Value {
+	enum class Kind {
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Kind kind = Kind::Null;
+	bool boolean = false;
+	std::string text; // strings, and numbers as written
+	std::vector<Value> items;
+	std::vector<std::pair<std::string, Value>> members;
+};
+
+struct Operation {
+	enum class Type {
+		Add,
+		Remove,
+		Replace,
+	};
+
+	Type type;
+	std::vector<std::string> path; // from the root, with `~0` and `~1` unescaped
+	Value value;
+};
+
+// reads any JSON document
+hk::Result parseValue(Value& out, std::istream& in);
+
+// the member of `object` named `key`, or nullptr
+const Value* findMember(const Value& object, std::string_view key);
+
+// reads a single operation, e.g. `{"op": "replace", "path": "/0/Id", "value": "obj1"}`
+hk::Result parseOperation(Operation& out, const Value& item);
+
+// reads a list of operations like JSON Patch's (RFC 6902), e.g.
+//   [{"op": "replace", "path": "/0/ObjectList/3/Translate/X", "value": 1.5}, {"op": "remove", "path": "/1/Id"}]
+// supports `add`, `remove` and `replace`. `-` adds to the end of an array, and the leading slash is optional
+hk::Result parseOperations(std::vector<Operation>& out, std::istream& in);
+
+struct Stats {
+	u32 numInPlace = 0; // values overwritten where they were
+	bool isRebuilt = false;
+};
+
+// applies `operations` to the BYML in `data`, in order. if every one of them replaces a bool, number or string with a
+// value of the same type (for strings, one already in the string table), the values are overwritten in place and
+// nothing else in `data` changes. values in containers (or 64-bit values) that are shared by several parents are
+// left alone, since changing them would change every parent. anything else rebuilds the whole document, keeping its
+// byte order, version and types: numbers keep the type of the value they replace wherever they fit it
+hk::Result patchByml(std::vector<u8>& data, std::span<const Operation> operations, Stats& stats);
+
+} // namespace patch
@@ -0,0 +1,74 @@
+#include "pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(u32 numThreads) {
+	if (numThreads == 0) numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	mThreads.reserve(numThreads);
+	for (u32 i = 0; i < numThreads; i++)
+		mThreads.emplace_back(&ThreadPool::workerMain, this);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard lock(mMutex);
+		mIsStopping = true;
+	}
+	mJobAvailable.notify_all();
+
+	for (std::thread& thread : mThreads)
+		thread.join();
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+	{
+		std::lock_guard lock(mMutex);
+		mJobs.push_back(std::move(job));
+		mNumUnfinished++;
+	}
+	mJobAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+	std::unique_lock lock(mMutex);
+	mAllDone.wait(lock, [this] { return mNumUnfinished == 0; });
+}
+
+void ThreadPool::forEach(size_t count, const std::function<void(size_t)>& func) {
+	// one job per thread pulling indices, rather than one job per index
+	std::atomic<size_t> next = 0;
+	size_t numJobs = std::min<size_t>(count, mThreads.size());
+	for (size_t i = 0; i < numJobs; i++) {
+		submit([&] {
+			for (size_t idx = next++; idx < count; idx = next++)
+				func(idx);
+		});
+	}
+
+	wait();
+}
+
+void ThreadPool::workerMain() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock lock(mMutex);
+			mJobAvailable.wait(lock, [this] { return mIsStopping || !mJobs.empty(); });
+			if (mJobs.empty()) return;
+
+			job = std::move(mJobs.front());
+			mJobs.pop_front();
+		}
+
+		job();
+
+		bool isAllDone;
+		{
+			std::lock_guard lock(mMutex);
+			isAllDone = --mNumUnfinished == 0;
+		}
+		if (isAllDone) mAllDone.notify_all();
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <hk/types.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads taking jobs from a shared queue. jobs must not wait on the pool they run on
+class ThreadPool {
+public:
+	// 0 uses one thread per hardware thread
+	explicit ThreadPool(u32 numThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+	// blocks until every submitted job has finished
+	void wait();
+
+	// runs `func(i)` for every i in [0, count) across the pool and waits for all of them
+	void forEach(size_t count, const std::function<void(size_t)>& func);
+
+	u32 getNumThreads() const { return mThreads.size(); }
+
+private:
+	void workerMain();
+
+	std::vector<std::thread> mThreads;
+	std::deque<std::function<void()>> mJobs;
+	std::mutex mMutex;
+	std::condition_variable mJobAvailable;
+	std::condition_variable mAllDone;
+	size_t mNumUnfinished = 0;
+	bool mIsStopping = false;
+};
@@ -0,0 +1,159 @@
+#include "query.h"
+
+#include <algorithm>
+#include <charconv>
+
+#include "results.h"
+#include "sarc.h"
+
+namespace query {
+
+namespace {
+
+// archives nested deeper than this are taken to be malformed
+constexpr u32 cMaxArchiveDepth = 8;
+
+std::string joinPath(const std::string& path, std::string_view component) {
+	if (path.empty()) return std::string(component);
+	return path + '/' + std::string(component);
+}
+
+hk::Result queryData(
+	u64& numMatches, json::Writer& out, const archive::File& file, const std::string& path,
+	std::span<const Step> steps, const zs::DictionarySet* dictionaries, u32 depth
+) {
+	if (file.getFormat() == archive::Format::Byml) {
+		byml::Document document;
+		HK_TRY(document.init(file.getData()));
+		return queryByml(numMatches, out, document, steps, path);
+	}
+
+	if (file.getFormat() != archive::Format::Sarc) return hk::ResultSuccess();
+	if (depth >= cMaxArchiveDepth) return utils::ResultUnexpectedFormat();
+
+	const std::span<const u8> data = file.getData();
+	sarc::EntryTable table;
+	HK_TRY(table.init(data));
+
+	for (const sarc::EntryInfo& entry : table.getEntries()) {
+		if (entry.end > data.size()) return utils::ResultSarcInvalidHeader();
+		const std::span<const u8> entryData = data.subspan(entry.start, entry.end - entry.start);
+
+		// anything that can't hold a BYML isn't decoded at all
+		const archive::Format format = archive::detectFormat(entryData);
+		if (format != archive::Format::Byml && format != archive::Format::Sarc && !archive::isCompression(format))
+			continue;
+
+		archive::File inner;
+		HK_TRY(inner.open({ entryData.begin(), entryData.end() }, dictionaries));
+		HK_TRY(queryData(numMatches, out, inner, joinPath(path, table.getName(entry)), steps, dictionaries, depth + 1));
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result parsePath(std::vector<Step>& out, std::string_view path) {
+	out.clear();
+
+	while (!path.empty()) {
+		const size_t slash = path.find('/');
+		const std::string_view text = path.substr(0, slash);
+		path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+
+		if (text.empty()) continue;
+
+		Step& step = out.emplace_back();
+		step.key = text;
+		if (text == "*") {
+			step.kind = Step::Kind::Wildcard;
+			continue;
+		}
+
+		const char* end = text.data() + text.size();
+		auto [ptr, ec] = std::from_chars(text.data(), end, step.index);
+		step.kind = ec == std::errc() && ptr == end ? Step::Kind::Index : Step::Kind::Key;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result queryByml(
+	u64& numMatches, json::Writer& out, const byml::Document& document, std::span<const Step> steps,
+	std::string_view file
+) {
+	struct Item {
+		byml::Node node;
+		u32 depth; // the number of steps taken
+		std::string path;
+	};
+
+	// keys are looked up in the key table once, rather than at every hash
+	std::vector<s32> keyIndices;
+	for (const Step& step : steps)
+		keyIndices.push_back(step.kind == Step::Kind::Wildcard ? -1 : HK_TRY(document.findKey(step.key)));
+
+	// depth first, with children pushed in reverse so matches come out in document order
+	std::vector<Item> stack;
+	stack.push_back({ document.getRoot(), 0, "" });
+
+	while (!stack.empty()) {
+		const Item item = std::move(stack.back());
+		stack.pop_back();
+
+		if (item.depth == steps.size()) {
+			out.beginObject();
+			out.key("file");
+			out.string(file);
+			out.key("path");
+			out.string(item.path);
+			out.key("value");
+			HK_TRY(json::writeNode(out, document, item.node));
+			out.endObject();
+			out.newline();
+			HK_TRY(out.getResult());
+
+			numMatches++;
+			continue;
+		}
+
+		if (!byml::isContainer(item.node.type)) continue;
+
+		const Step& step = steps[item.depth];
+		const bool isHash = item.node.type == byml::NodeType::Hash;
+
+		if (step.kind == Step::Kind::Wildcard) {
+			const u32 size = HK_TRY(document.getSize(item.node));
+			for (u32 i = size; i-- > 0;) {
+				u32 key;
+				const byml::Node entry = HK_TRY(document.getEntry(item.node, i, &key));
+				const std::string component = isHash ? std::string(HK_TRY(document.getKey(key))) : std::to_string(i);
+				stack.push_back({ entry, item.depth + 1, joinPath(item.path, component) });
+			}
+			continue;
+		}
+
+		s32 index = -1;
+		if (isHash) {
+			if (keyIndices[item.depth] >= 0) index = HK_TRY(document.findEntry(item.node, keyIndices[item.depth]));
+		} else if (step.kind == Step::Kind::Index && step.index < HK_TRY(document.getSize(item.node))) {
+			index = step.index;
+		}
+
+		if (index < 0) continue;
+		const byml::Node entry = HK_TRY(document.getEntry(item.node, index));
+		stack.push_back({ entry, item.depth + 1, joinPath(item.path, step.key) });
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result queryFile(
+	u64& numMatches, json::Writer& out, const archive::File& file, const std::string& path,
+	std::span<const Step> steps, const zs::DictionarySet* dictionaries
+) {
+	return queryData(numMatches, out, file, path, steps, dictionaries, 0);
+}
+
+} // namespace query
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <hk/Result.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "archive.h"
+#include "byml.h"
+#include "json.h"
+#include "zs.h"
+
+namespace query {
+
+struct Step {
+	enum class Kind {
+		Key,
+		Index,
+		Wildcard,
+	};
+
+	Kind kind;
+	std::string key; // also set for indices, which match hash keys of the same text
+	u32 index = 0;
+};
+
+// parses a path such as `0/ObjectList/*/UnitConfigName`. steps are separated by slashes: `*` matches every entry of a
+// container, a number an array index (or a hash key of the same text), and anything else a hash key
+hk::Result parsePath(std::vector<Step>& out, std::string_view path);
+
+// writes every node that `steps` lead to from the root of `document` as a line of NDJSON:
+//   {"file":<file>,"path":<path of the match>,"value":<value>}
+// only the containers along the way are looked at, so the rest of the document is never read
+hk::Result queryByml(
+	u64& numMatches, json::Writer& out, const byml::Document& document, std::span<const Step> steps,
+	std::string_view file
+);
+
+// the same for every BYML in `file`, which may be an archive (nested ones included). other files are skipped
+hk::Result queryFile(
+	u64& numMatches, json::Writer& out, const archive::File& file, const std::string& path,
+	std::span<const Step> steps, const zs::DictionarySet* dictionaries = nullptr
+);
+
+} // namespace query
@@ -0,0 +1,173 @@
+#include "repack.h"
+
+#include <algorithm>
+#include <functional>
+#include <hk/ValueOrResult.h>
+#include <iterator>
+#include <vector>
+
+#include "binary.h"
+#include "mizuna/util.h"
+#include "pack.h"
+#include "results.h"
+#include "sarc.h"
+#include "yaz0.h"
+
+namespace fs = std::filesystem;
+
+namespace szs {
+
+namespace {
+
+// passes the new archive from `start` on to `sink`
+using ArchiveStream = std::function<hk::Result(const Sink& sink, u32 start)>;
+
+// the first offset from `start` on where the new archive differs from `base`, or where the shorter of the two ends
+hk::ValueOrResult<u32> findFirstDifference(const ArchiveStream& stream, std::span<const u8> base, u32 start) {
+	u32 pos = start;
+	bool isDifferent = false;
+	hk::Result result = stream(
+		[&](std::span<const u8> chunk) -> hk::Result {
+			const size_t size = std::min(chunk.size(), base.size() - pos);
+			const auto changed = std::mismatch(chunk.begin(), chunk.begin() + size, base.begin() + pos).first;
+			const size_t same = changed - chunk.begin();
+			pos += same;
+			if (same == chunk.size()) return hk::ResultSuccess();
+
+			// failing stops the stream, since nothing past here is needed
+			isDifferent = true;
+			return utils::ResultInvalidArgument();
+		},
+		start
+	);
+	if (!isDifferent) HK_TRY(result);
+
+	return pos;
+}
+
+// compresses the new archive, which starts with `metadata`, to `sink`. `base` is `baseSzs` decompressed
+hk::Result repackTo(
+	const Sink& sink, std::span<const u8> baseSzs, std::vector<u8>& base, std::span<const u8> metadata, u32 archiveSize,
+	const ArchiveStream& stream, RepackStats& stats
+) {
+	sarc::EntryTable baseTable;
+	HK_TRY(baseTable.init(base));
+
+	std::vector<yaz0::GroupBoundary> boundaries;
+	HK_TRY(yaz0::findGroupBoundaries(boundaries, baseSzs));
+
+	const u32 dataOffset = metadata.size();
+
+	// [copyFrom, copyTo) of the base's token stream can be taken over. if the files moved, nothing can
+	u32 copyFrom = 0;
+	u32 copyTo = 0;
+	if (baseTable.getDataOffset() == dataOffset) {
+		auto changed = std::mismatch(
+			metadata.rbegin(), metadata.rend(), std::make_reverse_iterator(base.begin() + dataOffset)
+		);
+		const u32 changedEnd = metadata.rend() - changed.first;
+		// copied back-references may reach a window back from where copying starts
+		copyFrom = changedEnd == 0 ? 0 : changedEnd + yaz0::cWindowSize;
+		copyTo = HK_TRY(findFirstDifference(stream, base, dataOffset));
+
+		// `base` now holds the new archive up to `copyTo`
+		std::copy(metadata.begin(), metadata.end(), base.begin());
+	}
+
+	auto first = std::lower_bound(
+		boundaries.begin(), boundaries.end(), copyFrom,
+		[](const yaz0::GroupBoundary& boundary, u32 offset) { return boundary.outOffset < offset; }
+	);
+	auto last = std::upper_bound(
+		boundaries.begin(), boundaries.end(), copyTo,
+		[](u32 offset, const yaz0::GroupBoundary& boundary) { return offset < boundary.outOffset; }
+	) - 1;
+
+	stats.compressedSize = 0;
+	yaz0::Encoder encoder(
+		[&](std::span<const u8> chunk) {
+			stats.compressedSize += chunk.size();
+			return sink(chunk);
+		},
+		archiveSize, bin::readBE<u32>(baseSzs.data() + 8)
+	);
+
+	// how much of the new archive the encoder has been given
+	u32 pos = 0;
+	stats.reusedSize = 0;
+
+	if (first < last) {
+		// the new stream has to end a group exactly where the copied tokens start
+		bool isSynced = true;
+		if (copyFrom != 0) {
+			std::vector<u32> targets;
+			for (auto it = first; it <= last; it++)
+				targets.push_back(it->outOffset);
+
+			const u32 syncEnd = std::min<u32>(last->outOffset, copyFrom + yaz0::cMaxSyncSize);
+			HK_TRY(encoder.write({ base.data(), copyFrom }));
+			isSynced = HK_TRY(encoder.syncTo({ base.data() + copyFrom, syncEnd - copyFrom }, targets));
+			pos = isSynced ? encoder.getPosition() : syncEnd;
+		}
+
+		if (isSynced) {
+			while (first->outOffset < pos)
+				first++;
+
+			HK_TRY(encoder.writeTokens(
+				{ baseSzs.data() + first->inOffset, baseSzs.data() + last->inOffset },
+				{ base.data() + pos, base.data() + last->outOffset }
+			));
+			stats.reusedSize = last->inOffset - first->inOffset;
+			pos = last->outOffset;
+		}
+	}
+
+	HK_TRY(stream([&](std::span<const u8> data) { return encoder.write(data); }, pos));
+	return encoder.finish();
+}
+
+} // namespace
+
+hk::Result repack(const fs::path& basePath, const fs::path& inDir, const fs::path& outPath, RepackStats& stats) {
+	std::vector<u8> baseSzs;
+	HK_TRY(util::readFile(baseSzs, basePath));
+
+	std::vector<u8> base;
+	HK_TRY(yaz0::decompressFast(base, baseSzs));
+
+	sarc::EntryTable baseTable;
+	HK_TRY(baseTable.init(base));
+
+	sarc::PackSource source;
+	HK_TRY(sarc::collectPackSource(source, inDir));
+
+	sarc::Layout layout;
+	// laid out like the base, so that unchanged files stay where they were
+	HK_TRY(sarc::buildLayout(layout, source.files, baseTable.getByteOrder(), baseTable.inferAlignment()));
+
+	return writeFileReplacing(outPath, [&](const Sink& out) {
+		return repackTo(
+			out, baseSzs, base, layout.metadata, layout.archiveSize,
+			[&](const Sink& sink, u32 start) { return sarc::streamArchive(source, layout, sink, start); }, stats
+		);
+	});
+}
+
+hk::Result repackArchive(
+	const Sink& sink, std::span<const u8> baseSzs, std::span<const u8> archive, RepackStats& stats
+) {
+	std::vector<u8> base;
+	HK_TRY(yaz0::decompressFast(base, baseSzs));
+
+	sarc::EntryTable table;
+	HK_TRY(table.init(archive));
+	if (table.getDataOffset() > archive.size()) return utils::ResultSarcInvalidHeader();
+
+	return repackTo(
+		sink, baseSzs, base, archive.first(table.getDataOffset()), archive.size(),
+		[&](const Sink& out, u32 start) { return out(archive.subspan(start)); }, stats
+	);
+}
+
+} // namespace szs
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <span>
+
+#include "stream.h"
+
+namespace szs {
+
+struct RepackStats {
+	u32 compressedSize = 0;
+	u32 reusedSize = 0; // compressed bytes copied over from the base archive rather than encoded again
+};
+
+// writes an SZS of the files below `inDir` to `outPath` like `szs w`, but aligned like `basePath`, an earlier SZS of
+// mostly the same files, whose compressed stream is copied over wherever it still decodes to the new archive. that is
+// from the first group boundary a full window past the last changed metadata byte up to the last one before the first
+// changed file byte, so an edit near the end of an archive only has the data after it compressed again. `outPath` is
+// only replaced once the new archive is complete, so it may be `basePath`
+hk::Result repack(
+	const std::filesystem::path& basePath, const std::filesystem::path& inDir, const std::filesystem::path& outPath,
+	RepackStats& stats
+);
+
+// the same for an archive that is already laid out in memory, e.g. one edited without being extracted. `baseSzs` is the
+// SZS it was made from, and the new SZS is passed to `sink`
+hk::Result repackArchive(
+	const Sink& sink, std::span<const u8> baseSzs, std::span<const u8> archive, RepackStats& stats
+);
+
+} // namespace szs
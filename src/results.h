@@ -2,6 +2,26 @@
 
 #include <hk/Result.h>
 
+namespace utils {
+
 HK_RESULT_MODULE(10)
 HK_DEFINE_RESULT_RANGE(MizunaUtils, 0, 100)
 HK_DEFINE_RESULT(InvalidArgument, 0)
+HK_DEFINE_RESULT(Yaz0InvalidMagic, 1)
+HK_DEFINE_RESULT(Yaz0Truncated, 2)
+HK_DEFINE_RESULT(Yaz0InvalidBackref, 3)
+HK_DEFINE_RESULT(Yaz0InvalidSeekIndex, 4)
+HK_DEFINE_RESULT(Yaz0RangeOutOfBounds, 5)
+HK_DEFINE_RESULT(SarcInvalidHeader, 6)
+HK_DEFINE_RESULT(SarcEntryNotFound, 7)
+HK_DEFINE_RESULT(BatchJobFailed, 8)
+HK_DEFINE_RESULT(ZstdError, 9)
+HK_DEFINE_RESULT(ZstdTruncated, 10)
+HK_DEFINE_RESULT(ZstdDictionaryNotFound, 11)
+HK_DEFINE_RESULT(UnexpectedFormat, 12)
+HK_DEFINE_RESULT(JsonInvalidSyntax, 13)
+HK_DEFINE_RESULT(BymlInvalidValue, 14)
+HK_DEFINE_RESULT(BymlInvalidData, 15)
+HK_DEFINE_RESULT(BymlKeyNotFound, 16)
+
+} // namespace utils
@@ -0,0 +1,261 @@
+#include "romfs.h"
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+
+#include "archive.h"
+#include "extract.h"
+#include "hash.h"
+#include "mizuna/results.h"
+#include "results.h"
+#include "sarc.h"
+
+namespace fs = std::filesystem;
+
+namespace romfs {
+
+namespace {
+
+// archives nested deeper than this are taken to be malformed
+constexpr u32 cMaxArchiveDepth = 8;
+
+constexpr std::array cCompressionExtensions = { ".zs", ".yaz0" };
+
+constexpr const char* cManifestName = "dedup-manifest.tsv";
+
+// whether the file at `path` holds exactly `data`
+bool hasContents(const fs::path& path, std::span<const u8> data) {
+	std::ifstream file(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file || u64(file.tellg()) != data.size()) return false;
+	file.seekg(0);
+
+	std::vector<char> buffer(std::min<size_t>(data.size(), 0x10000));
+	for (size_t pos = 0; pos < data.size(); pos += buffer.size()) {
+		const size_t size = std::min(buffer.size(), data.size() - pos);
+		if (!file.read(buffer.data(), size) || std::memcmp(buffer.data(), data.data() + pos, size) != 0) return false;
+	}
+
+	return true;
+}
+
+// stores each distinct content once, however many files have it
+class LeafStore {
+public:
+	LeafStore(const fs::path& outDir, bool isWriteManifest, ExtractStats& stats)
+		: mOutDir(outDir), mIsWriteManifest(isWriteManifest), mStats(stats) {}
+
+	// writes `data` to `path`, unless the same contents were stored before. then `path` is hardlinked to that copy
+	// once it has been written, or only listed in the manifest
+	hk::Result put(const fs::path& path, std::span<const u8> data);
+
+	void addFailure(const fs::path& path, hk::Result result);
+
+	hk::Result writeManifest();
+
+private:
+	enum class State {
+		Writing,
+		Written,
+		Failed,
+	};
+
+	struct Payload {
+		fs::path path;
+		State state = State::Writing;
+	};
+
+	// the digest and the size
+	using Key = std::pair<hash::Digest128, u64>;
+
+	hk::Result write(const fs::path& path, std::span<const u8> data);
+
+	const fs::path mOutDir;
+	const bool mIsWriteManifest;
+	ExtractStats& mStats;
+
+	std::mutex mMutex;
+	std::condition_variable mWritten;
+	std::map<Key, Payload> mPayloads;
+	std::vector<std::pair<fs::path, fs::path>> mManifest; // duplicate and original, relative to the output
+};
+
+hk::Result LeafStore::put(const fs::path& path, std::span<const u8> data) {
+	const Key key = { hash::key(data), data.size() };
+
+	std::unique_lock lock(mMutex);
+	mStats.numFiles++;
+	mStats.totalSize += data.size();
+
+	auto [it, isNew] = mPayloads.try_emplace(key);
+	Payload& payload = it->second;
+	if (isNew) {
+		payload.path = path;
+		mStats.numUnique++;
+		lock.unlock();
+
+		hk::Result result = write(path, data);
+
+		lock.lock();
+		payload.state = result.succeeded() ? State::Written : State::Failed;
+		mWritten.notify_all();
+		return result;
+	}
+
+	// the first copy is written outside the lock, so it may not be there yet
+	mWritten.wait(lock, [&] { return payload.state != State::Writing; });
+	const fs::path original = payload.path;
+	const bool isOriginalWritten = payload.state == State::Written;
+	lock.unlock();
+
+	// the copy on disk is read back, so that contents which only share a digest are never taken for each other
+	const bool isDuplicate = isOriginalWritten && hasContents(original, data);
+
+	if (isDuplicate && mIsWriteManifest) {
+		lock.lock();
+		mManifest.emplace_back(path.lexically_relative(mOutDir), original.lexically_relative(mOutDir));
+		return hk::ResultSuccess();
+	}
+
+	if (isDuplicate) {
+		// an earlier run may have left a file here
+		std::error_code ec;
+		fs::remove(path, ec);
+		fs::create_hard_link(original, path, ec);
+		if (!ec) return hk::ResultSuccess();
+	}
+
+	// contents the original failed to write count too, since each of these goes to disk on its own
+	if (!isDuplicate) {
+		lock.lock();
+		mStats.numUnique++;
+		lock.unlock();
+	}
+
+	// different contents after all, no hardlinks on this filesystem, or too many to one file
+	return write(path, data);
+}
+
+hk::Result LeafStore::write(const fs::path& path, std::span<const u8> data) {
+	// an earlier run may have left a hardlink here, which writing through would change every copy of
+	std::error_code ec;
+	fs::remove(path, ec);
+	HK_TRY(sarc::writeEntryData(path, data));
+
+	std::lock_guard lock(mMutex);
+	mStats.writtenSize += data.size();
+	return hk::ResultSuccess();
+}
+
+void LeafStore::addFailure(const fs::path& path, hk::Result result) {
+	std::lock_guard lock(mMutex);
+	mStats.failures.push_back({ path.lexically_relative(mOutDir), result });
+}
+
+hk::Result LeafStore::writeManifest() {
+	std::sort(mManifest.begin(), mManifest.end());
+
+	std::ofstream file(mOutDir / cManifestName, std::ios::out);
+	for (const auto& [duplicate, original] : mManifest)
+		file << duplicate.generic_string() << '\t' << original.generic_string() << '\n';
+
+	return file ? hk::ResultSuccess() : ResultFileError();
+}
+
+// decompressed files lose the extension of their compression, e.g. `Foo.bntx.zs` becomes `Foo.bntx`
+fs::path getLeafPath(const fs::path& path, const archive::File& file) {
+	fs::path out = path;
+	if (file.getLayers().empty()) return out;
+
+	while (std::find(cCompressionExtensions.begin(), cCompressionExtensions.end(), out.extension()) !=
+	       cCompressionExtensions.end())
+		out.replace_extension();
+
+	return out;
+}
+
+// archives become a directory at `outPath`, anything else a file. entries that fail are recorded and skipped
+hk::Result extractFile(
+	LeafStore& store, const ExtractOptions& options, const archive::File& file, const fs::path& outPath, u32 depth
+) {
+	if (file.getFormat() != archive::Format::Sarc) return store.put(getLeafPath(outPath, file), file.getData());
+	if (depth >= cMaxArchiveDepth) return utils::ResultUnexpectedFormat();
+
+	const std::span<const u8> data = file.getData();
+	sarc::EntryTable table;
+	HK_TRY(table.init(data));
+
+	for (const sarc::EntryInfo& entry : table.getEntries()) {
+		if (entry.end > data.size()) return utils::ResultSarcInvalidHeader();
+
+		fs::path entryPath;
+		hk::Result result = sarc::getEntryPath(entryPath, table, entry, outPath);
+		if (result.failed()) {
+			store.addFailure(outPath / table.getName(entry), result);
+			continue;
+		}
+
+		std::error_code ec;
+		fs::create_directories(entryPath.parent_path(), ec);
+		if (ec) return ResultFileError();
+
+		archive::File inner;
+		result = inner.open({ data.begin() + entry.start, data.begin() + entry.end }, options.dictionaries);
+		if (result.succeeded()) result = extractFile(store, options, inner, entryPath, depth + 1);
+		if (result.failed()) store.addFailure(entryPath, result);
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result extractAll(
+	const fs::path& romfsDir, const fs::path& outDir, const ExtractOptions& options, ThreadPool& pool,
+	ExtractStats& stats
+) {
+	if (!fs::is_directory(romfsDir)) return ResultDirNotFound();
+
+	std::vector<fs::path> relPaths;
+	for (const auto& entry : fs::recursive_directory_iterator(romfsDir))
+		if (entry.is_regular_file()) relPaths.push_back(fs::relative(entry.path(), romfsDir));
+	std::sort(relPaths.begin(), relPaths.end());
+
+	// the jobs below only create directories inside their own archives, so they never race over shared parents
+	std::set<fs::path> dirs;
+	for (const fs::path& relPath : relPaths)
+		dirs.insert((outDir / relPath).parent_path());
+	for (const fs::path& dir : dirs) {
+		std::error_code ec;
+		fs::create_directories(dir, ec);
+		if (ec) return ResultFileError();
+	}
+
+	stats = {};
+	LeafStore store(outDir, options.isWriteManifest, stats);
+
+	pool.forEach(relPaths.size(), [&](size_t i) {
+		const fs::path outPath = outDir / relPaths[i];
+
+		archive::File file;
+		hk::Result result = file.open(romfsDir / relPaths[i], options.dictionaries);
+		if (result.succeeded()) result = extractFile(store, options, file, outPath, 0);
+		if (result.failed()) store.addFailure(outPath, result);
+	});
+
+	std::sort(stats.failures.begin(), stats.failures.end(), [](const ExtractFailure& a, const ExtractFailure& b) {
+		return a.path < b.path;
+	});
+
+	if (options.isWriteManifest) HK_TRY(store.writeManifest());
+
+	return hk::ResultSuccess();
+}
+
+} // namespace romfs
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/Result.h>
+#include <vector>
+
+#include "pool.h"
+#include "zs.h"
+
+namespace romfs {
+
+struct ExtractOptions {
+	const zs::DictionarySet* dictionaries = nullptr;
+	// list duplicates in `dedup-manifest.tsv` instead of hardlinking them
+	bool isWriteManifest = false;
+};
+
+struct ExtractFailure {
+	std::filesystem::path path;
+	hk::Result result;
+};
+
+struct ExtractStats {
+	u64 numFiles = 0;  // every file in the output, after unpacking archives
+	u64 numUnique = 0; // files written with their own contents rather than as a copy of another
+	u64 totalSize = 0;
+	u64 writtenSize = 0; // what actually went to disk, i.e. unique contents plus any copies hardlinking failed for
+	std::vector<ExtractFailure> failures;
+};
+
+// extracts everything below `romfsDir` into the same layout below `outDir`. compression is removed, and every SARC
+// becomes a directory of the same name holding its files, however deeply nested. contents are hashed as they are
+// written, so each distinct file is stored once: later copies are hardlinked to the first, or only listed in a
+// manifest. romfs files are unpacked in parallel on `pool`, and any that fail are listed in `stats`
+hk::Result extractAll(
+	const std::filesystem::path& romfsDir, const std::filesystem::path& outDir, const ExtractOptions& options,
+	ThreadPool& pool, ExtractStats& stats
+);
+
+} // namespace romfs
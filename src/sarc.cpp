@@ -0,0 +1,280 @@
+#include "sarc.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "binary.h"
+#include "results.h"
+
+namespace sarc {
+
+namespace {
+
+constexpr size_t cSfatHeaderSize = 0xc;
+constexpr size_t cSfatNodeSize = 0x10;
+constexpr size_t cSfntHeaderSize = 0x8;
+constexpr u16 cVersion = 0x100;
+constexpr u32 cMaxInferredAlignment = 0x2000;
+
+u32 calcHash(std::string_view name, u32 key) {
+	u32 hash = 0;
+	for (char c : name)
+		hash = hash * key + s8(c);
+	return hash;
+}
+
+u64 alignUp(u64 value, u32 alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+hk::ValueOrResult<util::ByteOrder> readByteOrder(std::span<const u8> header) {
+	if (header.size() < cArchiveHeaderSize || std::memcmp(header.data(), "SARC", 4) != 0)
+		return utils::ResultSarcInvalidHeader();
+
+	if (header[6] == 0xfe && header[7] == 0xff) return util::ByteOrder::Big;
+	if (header[6] == 0xff && header[7] == 0xfe) return util::ByteOrder::Little;
+
+	return utils::ResultSarcInvalidHeader();
+}
+
+// where the SFAT nodes and the name table are, checked to lie within the metadata
+struct Tables {
+	u32 dataOffset;
+	u32 hashKey;
+	u32 nodeCount;
+	const u8* nodes;
+	std::span<const char> names;
+};
+
+hk::ValueOrResult<Tables> readTables(std::span<const u8> archive, util::ByteOrder order) {
+	Tables tables;
+	tables.dataOffset = bin::read<u32>(archive.data() + 0xc, order);
+	if (tables.dataOffset > archive.size()) return utils::ResultSarcInvalidHeader();
+
+	const u8* sfat = archive.data() + bin::read<u16>(archive.data() + 4, order);
+	const u8* metaEnd = archive.data() + tables.dataOffset;
+	if (sfat + cSfatHeaderSize > metaEnd || std::memcmp(sfat, "SFAT", 4) != 0) return utils::ResultSarcInvalidHeader();
+
+	tables.nodeCount = bin::read<u16>(sfat + 6, order);
+	tables.hashKey = bin::read<u32>(sfat + 8, order);
+
+	tables.nodes = sfat + cSfatHeaderSize;
+	const u8* sfnt = tables.nodes + tables.nodeCount * cSfatNodeSize;
+	if (sfnt + cSfntHeaderSize > metaEnd || std::memcmp(sfnt, "SFNT", 4) != 0) return utils::ResultSarcInvalidHeader();
+
+	const u8* names = sfnt + cSfntHeaderSize;
+	tables.names = { reinterpret_cast<const char*>(names), size_t(metaEnd - names) };
+
+	return tables;
+}
+
+EntryInfo readNode(const u8* nodes, u32 index, u32 dataOffset, util::ByteOrder order) {
+	const u8* node = nodes + index * cSfatNodeSize;
+	u32 attributes = bin::read<u32>(node + 4, order);
+
+	EntryInfo entry;
+	entry.hash = bin::read<u32>(node, order);
+	entry.nameOffset = (attributes & 0xff000000) != 0 ? s32((attributes & 0xffff) * 4) : -1;
+	entry.start = dataOffset + bin::read<u32>(node + 8, order);
+	entry.end = dataOffset + bin::read<u32>(node + 12, order);
+
+	return entry;
+}
+
+} // namespace
+
+hk::ValueOrResult<u32> EntryTable::readDataOffset(std::span<const u8> header) {
+	util::ByteOrder order = HK_TRY(readByteOrder(header));
+
+	return bin::read<u32>(header.data() + 0xc, order);
+}
+
+hk::Result EntryTable::init(std::span<const u8> archive) {
+	mByteOrder = HK_TRY(readByteOrder(archive));
+	const Tables tables = HK_TRY(readTables(archive, mByteOrder));
+	mDataOffset = tables.dataOffset;
+	mHashKey = tables.hashKey;
+
+	mNameTable.assign(tables.names.begin(), tables.names.end());
+	// guarantee that every name is terminated, even for a malformed table
+	mNameTable.push_back('\0');
+
+	mEntries.clear();
+	mEntries.reserve(tables.nodeCount);
+	for (u32 i = 0; i < tables.nodeCount; i++) {
+		EntryInfo entry = readNode(tables.nodes, i, mDataOffset, mByteOrder);
+		if (entry.nameOffset >= s32(mNameTable.size()) || entry.end < entry.start)
+			return utils::ResultSarcInvalidHeader();
+
+		mEntries.push_back(entry);
+	}
+
+	return hk::ResultSuccess();
+}
+
+u32 EntryTable::calcHash(std::string_view name) const {
+	return sarc::calcHash(name, mHashKey);
+}
+
+const EntryInfo* EntryTable::find(std::string_view name) const {
+	u32 hash = calcHash(name);
+
+	// SFAT nodes are sorted by hash. colliding names sit next to each other
+	auto it = std::lower_bound(mEntries.begin(), mEntries.end(), hash, [](const EntryInfo& entry, u32 value) {
+		return entry.hash < value;
+	});
+
+	for (; it != mEntries.end() && it->hash == hash; ++it)
+		if (it->nameOffset < 0 || getName(*it) == name) return &*it;
+
+	return nullptr;
+}
+
+std::string_view EntryTable::getName(const EntryInfo& entry) const {
+	if (entry.nameOffset < 0) return {};
+
+	return mNameTable.data() + entry.nameOffset;
+}
+
+u32 EntryTable::inferAlignment() const {
+	u32 offsets = cMaxInferredAlignment | mDataOffset;
+	for (const EntryInfo& entry : mEntries)
+		offsets |= entry.start;
+
+	// the lowest set bit
+	return offsets & (~offsets + 1);
+}
+
+hk::Result ArchiveView::init(std::span<const u8> archive) {
+	mByteOrder = HK_TRY(readByteOrder(archive));
+	const Tables tables = HK_TRY(readTables(archive, mByteOrder));
+
+	mArchive = archive;
+	mNodes = tables.nodes;
+	mNames = tables.names;
+	mNodeCount = tables.nodeCount;
+	mHashKey = tables.hashKey;
+	mDataOffset = tables.dataOffset;
+
+	return hk::ResultSuccess();
+}
+
+bool ArchiveView::hasFile(std::string_view name) const {
+	return findNode(name) >= 0;
+}
+
+hk::ValueOrResult<std::span<const u8>> ArchiveView::getFileData(std::string_view name) const {
+	s32 index = findNode(name);
+	if (index < 0) return utils::ResultSarcEntryNotFound();
+
+	const EntryInfo entry = readNode(mNodes, index, mDataOffset, mByteOrder);
+	if (entry.end < entry.start || entry.end > mArchive.size()) return utils::ResultSarcInvalidHeader();
+
+	return mArchive.subspan(entry.start, entry.end - entry.start);
+}
+
+s32 ArchiveView::findNode(std::string_view name) const {
+	const u32 hash = sarc::calcHash(name, mHashKey);
+	auto readHash = [&](u32 index) { return bin::read<u32>(mNodes + index * cSfatNodeSize, mByteOrder); };
+
+	// SFAT nodes are sorted by hash. colliding names sit next to each other
+	u32 low = 0;
+	u32 high = mNodeCount;
+	while (low < high) {
+		u32 mid = low + (high - low) / 2;
+		if (readHash(mid) < hash)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (u32 i = low; i < mNodeCount && readHash(i) == hash; i++) {
+		u32 attributes = bin::read<u32>(mNodes + i * cSfatNodeSize + 4, mByteOrder);
+		if ((attributes & 0xff000000) == 0) return i;
+
+		size_t nameOffset = (attributes & 0xffff) * 4;
+		if (nameOffset >= mNames.size()) continue;
+
+		const char* storedName = mNames.data() + nameOffset;
+		if (std::string_view(storedName, strnlen(storedName, mNames.size() - nameOffset)) == name) return i;
+	}
+
+	return -1;
+}
+
+hk::Result buildLayout(Layout& out, std::span<const LayoutFile> files, util::ByteOrder byteOrder, u32 alignment) {
+	if (alignment == 0 || files.size() > 0xffff) return utils::ResultInvalidArgument();
+
+	std::vector<u32> hashes(files.size());
+	std::vector<size_t> order(files.size());
+	for (size_t i = 0; i < files.size(); i++) {
+		hashes[i] = calcHash(files[i].name, cDefaultHashKey);
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return hashes[a] != hashes[b] ? hashes[a] < hashes[b] : files[a].name < files[b].name;
+	});
+
+	std::vector<u32> nameOffsets(files.size());
+	u64 namesSize = 0;
+	for (size_t i : order) {
+		// stored in units of 4 bytes, in the low 16 bits of the attributes
+		if (namesSize / 4 > 0xffff) return utils::ResultInvalidArgument();
+
+		nameOffsets[i] = namesSize;
+		namesSize = alignUp(namesSize + files[i].name.size() + 1, 4);
+	}
+
+	const u64 sfatOffset = cArchiveHeaderSize;
+	const u64 sfntOffset = sfatOffset + cSfatHeaderSize + files.size() * cSfatNodeSize;
+	const u64 dataOffset = alignUp(sfntOffset + cSfntHeaderSize + namesSize, alignment);
+
+	out.offsets.resize(files.size());
+	u64 dataEnd = dataOffset;
+	for (size_t i : order) {
+		out.offsets[i] = alignUp(dataEnd, alignment);
+		dataEnd = out.offsets[i] + files[i].size;
+		if (dataEnd > UINT32_MAX) return utils::ResultInvalidArgument();
+	}
+	out.archiveSize = dataEnd;
+
+	out.metadata.assign(dataOffset, 0);
+	u8* header = out.metadata.data();
+	std::memcpy(header, "SARC", 4);
+	bin::write<u16>(header + 4, cArchiveHeaderSize, byteOrder);
+	bin::write<u16>(header + 6, 0xfeff, byteOrder);
+	bin::write<u32>(header + 8, out.archiveSize, byteOrder);
+	bin::write<u32>(header + 0xc, dataOffset, byteOrder);
+	bin::write<u16>(header + 0x10, cVersion, byteOrder);
+
+	u8* sfat = header + sfatOffset;
+	std::memcpy(sfat, "SFAT", 4);
+	bin::write<u16>(sfat + 4, cSfatHeaderSize, byteOrder);
+	bin::write<u16>(sfat + 6, files.size(), byteOrder);
+	bin::write<u32>(sfat + 8, cDefaultHashKey, byteOrder);
+
+	u8* sfnt = header + sfntOffset;
+	std::memcpy(sfnt, "SFNT", 4);
+	bin::write<u16>(sfnt + 4, cSfntHeaderSize, byteOrder);
+
+	u8* node = sfat + cSfatHeaderSize;
+	u32 collisionCount = 0;
+	for (size_t n = 0; n < order.size(); n++) {
+		size_t i = order[n];
+		// the top byte of the attributes counts up through names sharing a hash
+		collisionCount = n > 0 && hashes[order[n - 1]] == hashes[i] ? collisionCount + 1 : 1;
+
+		bin::write<u32>(node, hashes[i], byteOrder);
+		bin::write<u32>(node + 4, collisionCount << 24 | nameOffsets[i] / 4, byteOrder);
+		bin::write<u32>(node + 8, out.offsets[i] - dataOffset, byteOrder);
+		bin::write<u32>(node + 12, out.offsets[i] + files[i].size - dataOffset, byteOrder);
+		node += cSfatNodeSize;
+
+		std::memcpy(sfnt + cSfntHeaderSize + nameOffsets[i], files[i].name.data(), files[i].name.size());
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace sarc
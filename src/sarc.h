@@ -0,0 +1,96 @@
+#pragma once
+
+#include <hk/ValueOrResult.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "mizuna/util.h"
+
+namespace sarc {
+
+constexpr size_t cArchiveHeaderSize = 0x14;
+constexpr u32 cDefaultHashKey = 0x65;
+
+struct EntryInfo {
+	u32 hash;
+	s32 nameOffset; // offset into the name table, or -1 for entries only identified by hash
+	u32 start;      // absolute offset of the file data in the archive
+	u32 end;
+};
+
+// the header, SFAT and SFNT of an archive, parsed without touching any file data
+class EntryTable {
+public:
+	// reads the offset of the file data from the archive header, i.e. how much of the archive `init` needs
+	static hk::ValueOrResult<u32> readDataOffset(std::span<const u8> header);
+
+	// `archive` only needs to cover the first `readDataOffset` bytes. the name table is copied
+	hk::Result init(std::span<const u8> archive);
+
+	u32 calcHash(std::string_view name) const;
+	const EntryInfo* find(std::string_view name) const;
+	std::string_view getName(const EntryInfo& entry) const;
+
+	const std::vector<EntryInfo>& getEntries() const { return mEntries; }
+
+	u32 getDataOffset() const { return mDataOffset; }
+
+	util::ByteOrder getByteOrder() const { return mByteOrder; }
+
+	// the alignment the archive was most likely built with, which isn't stored anywhere: the largest power of two (up
+	// to 0x2000) that the file data and every file start on a multiple of
+	u32 inferAlignment() const;
+
+private:
+	std::vector<EntryInfo> mEntries;
+	std::vector<char> mNameTable;
+	util::ByteOrder mByteOrder = util::ByteOrder::Little;
+	u32 mHashKey = 0;
+	u32 mDataOffset = 0;
+};
+
+// an archive read in place. only the header is parsed up front, and lookups binary-search the SFAT by name hash,
+// reading the name table just to tell colliding names apart, so nothing is allocated per entry
+class ArchiveView {
+public:
+	// `archive` has to outlive the view
+	hk::Result init(std::span<const u8> archive);
+
+	bool hasFile(std::string_view name) const;
+
+	// points into the archive rather than copying
+	hk::ValueOrResult<std::span<const u8>> getFileData(std::string_view name) const;
+
+	u32 getFileCount() const { return mNodeCount; }
+
+private:
+	// index of the SFAT node for `name`, or -1
+	s32 findNode(std::string_view name) const;
+
+	std::span<const u8> mArchive;
+	const u8* mNodes = nullptr;
+	std::span<const char> mNames;
+	util::ByteOrder mByteOrder = util::ByteOrder::Little;
+	u32 mNodeCount = 0;
+	u32 mHashKey = 0;
+	u32 mDataOffset = 0;
+};
+
+struct LayoutFile {
+	std::string name;
+	u64 size;
+};
+
+// where everything goes in an archive, worked out from names and sizes alone
+struct Layout {
+	std::vector<u8> metadata; // header, SFAT and SFNT, ready to be written at the start of the archive
+	std::vector<u32> offsets; // absolute offset of each file's data, in the order the files were given
+	u32 archiveSize = 0;
+};
+
+// files are sorted by name hash as SFAT requires, and each one starts on a multiple of `alignment`
+hk::Result buildLayout(Layout& out, std::span<const LayoutFile> files, util::ByteOrder byteOrder, u32 alignment);
+
+} // namespace sarc
@@ -0,0 +1,76 @@
+#include "stage.h"
+
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace stage {
+
+void KeyIds::init(const byml::FlatDocument& document) {
+	for (size_t i = 0; i < cKeyNames.size(); i++)
+		mIds[i] = document.findKey(cKeyNames[i]);
+}
+
+hk::Result FieldView::bind(const byml::FlatDocument& document, const KeyIds& keys, u32 hash) {
+	if (document.getType(hash) != byml::NodeType::Hash) return byml::ResultInvalidNodeType();
+
+	mDocument = &document;
+	mNodes.fill(cNone);
+
+	// both the entries and the keys' ids are sorted, so neither side is ever gone back over
+	const u32 size = document.getSize(hash);
+	u32 entry = 0;
+	for (size_t i = 0; i < cKeyNames.size() && entry < size; i++) {
+		const s32 id = keys.get(Key(i));
+		if (id < 0) continue;
+
+		while (entry < size && document.getEntryKey(hash, entry) < u32(id))
+			entry++;
+		if (entry < size && document.getEntryKey(hash, entry) == u32(id)) mNodes[i] = document.getEntry(hash, entry);
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<u32> FieldView::get(Key key) const {
+	if (!has(key)) return utils::ResultBymlKeyNotFound();
+	return mNodes[size_t(key)];
+}
+
+hk::ValueOrResult<std::string_view> FieldView::getString(Key key) const {
+	return mDocument->getString(HK_TRY(get(key)));
+}
+
+hk::ValueOrResult<f32> FieldView::getF32(Key key) const {
+	return mDocument->getF32(HK_TRY(get(key)));
+}
+
+hk::Result StageObjectView::bind(const byml::FlatDocument& document, const KeyIds& keys, u32 object) {
+	mDocument = &document;
+	mKeys = &keys;
+	mNode = object;
+	return mFields.bind(document, keys, object);
+}
+
+hk::ValueOrResult<std::string_view> StageObjectView::getParameterConfigName() const {
+	FieldView unitConfig;
+	HK_TRY(unitConfig.bind(*mDocument, *mKeys, HK_TRY(mFields.get(Key::UnitConfig))));
+	return unitConfig.getString(Key::ParameterConfigName);
+}
+
+hk::ValueOrResult<bool> StageObjectView::matchesName(std::string_view name) const {
+	if (HK_TRY(getUnitConfigName()) == name || HK_TRY(getParameterConfigName()) == name) return true;
+	return hasModelName() && HK_TRY(getModelName()) == name;
+}
+
+hk::ValueOrResult<hk::util::Vector3f> StageObjectView::getVec3f(Key key) const {
+	FieldView vec;
+	HK_TRY(vec.bind(*mDocument, *mKeys, HK_TRY(mFields.get(key))));
+
+	hk::util::Vector3f out;
+	out.x = HK_TRY(vec.getF32(Key::X));
+	out.y = HK_TRY(vec.getF32(Key::Y));
+	out.z = HK_TRY(vec.getF32(Key::Z));
+	return out;
+}
+
+} // namespace stage
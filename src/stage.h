@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <hk/ValueOrResult.h>
+#include <hk/util/Math.h>
+#include <string_view>
+
+#include "byml.h"
+
+namespace stage {
+
+// every key a placement object is read by. the names are sorted like a BYML key table, so their ids in any document
+// come in the same order and all of a hash's fields can be found in one merge with its entries, which are sorted by id
+enum class Key : u8 {
+	Id,
+	Links,
+	ModelName,
+	ParameterConfigName,
+	Rotate,
+	Scale,
+	Translate,
+	UnitConfig,
+	UnitConfigName,
+	X,
+	Y,
+	Z,
+};
+
+constexpr std::array<std::string_view, 12> cKeyNames = {
+	"Id",        "Links",      "ModelName",      "ParameterConfigName", "Rotate", "Scale",
+	"Translate", "UnitConfig", "UnitConfigName", "X",                   "Y",      "Z",
+};
+
+static_assert(std::ranges::is_sorted(cKeyNames), "key names have to be in key table order");
+static_assert(std::ranges::adjacent_find(cKeyNames) == cKeyNames.end(), "key names have to be unique");
+
+// the ids of `cKeyNames` in one document, looked up once per document rather than once per object
+class KeyIds {
+public:
+	void init(const byml::FlatDocument& document);
+
+	// -1 if no hash in the document has this key
+	s32 get(Key key) const { return mIds[size_t(key)]; }
+
+private:
+	std::array<s32, cKeyNames.size()> mIds;
+};
+
+// the entries of a hash for every key in `cKeyNames`, found in one pass
+class FieldView {
+public:
+	hk::Result bind(const byml::FlatDocument& document, const KeyIds& keys, u32 hash);
+
+	bool has(Key key) const { return mNodes[size_t(key)] != cNone; }
+
+	// null if the hash has no such key
+	byml::NodeType getType(Key key) const {
+		return has(key) ? mDocument->getType(mNodes[size_t(key)]) : byml::NodeType::Null;
+	}
+
+	// fails if the hash has no such key
+	hk::ValueOrResult<u32> get(Key key) const;
+	hk::ValueOrResult<std::string_view> getString(Key key) const;
+	hk::ValueOrResult<f32> getF32(Key key) const;
+
+private:
+	static constexpr u32 cNone = 0xffffffff;
+
+	const byml::FlatDocument* mDocument = nullptr;
+	std::array<u32, cKeyNames.size()> mNodes;
+};
+
+// a placement object, e.g. an entry of a stage's ObjectList or of one of its Links groups. binding it reads each of its
+// fields' positions at once, so the accessors below are all direct
+class StageObjectView {
+public:
+	hk::Result bind(const byml::FlatDocument& document, const KeyIds& keys, u32 object);
+
+	hk::ValueOrResult<std::string_view> getUnitConfigName() const { return mFields.getString(Key::UnitConfigName); }
+	hk::ValueOrResult<std::string_view> getParameterConfigName() const;
+	hk::ValueOrResult<std::string_view> getId() const { return mFields.getString(Key::Id); }
+
+	// ModelName is optional, and only counts if it's a string
+	bool hasModelName() const { return mFields.getType(Key::ModelName) == byml::NodeType::String; }
+	hk::ValueOrResult<std::string_view> getModelName() const { return mFields.getString(Key::ModelName); }
+
+	hk::ValueOrResult<hk::util::Vector3f> getTranslate() const { return getVec3f(Key::Translate); }
+	hk::ValueOrResult<hk::util::Vector3f> getRotate() const { return getVec3f(Key::Rotate); }
+	hk::ValueOrResult<hk::util::Vector3f> getScale() const { return getVec3f(Key::Scale); }
+
+	// al-search's query: whether the UnitConfigName, ParameterConfigName or ModelName is `name`
+	hk::ValueOrResult<bool> matchesName(std::string_view name) const;
+
+	// a hash of link names to arrays of objects
+	hk::ValueOrResult<u32> getLinks() const { return mFields.get(Key::Links); }
+
+	u32 getNode() const { return mNode; }
+
+private:
+	hk::ValueOrResult<hk::util::Vector3f> getVec3f(Key key) const;
+
+	const byml::FlatDocument* mDocument = nullptr;
+	const KeyIds* mKeys = nullptr;
+	u32 mNode = 0;
+	FieldView mFields;
+};
+
+} // namespace stage
@@ -0,0 +1,55 @@
+#include "stream.h"
+
+#include <fstream>
+
+#include "mizuna/results.h"
+
+Sink makeVectorSink(std::vector<u8>& out) {
+	return [&out](std::span<const u8> chunk) {
+		out.insert(out.end(), chunk.begin(), chunk.end());
+		return hk::ResultSuccess();
+	};
+}
+
+Sink makeStreamSink(std::ostream& out) {
+	return [&out](std::span<const u8> chunk) -> hk::Result {
+		out.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		if (!out) return ResultFileError();
+		return hk::ResultSuccess();
+	};
+}
+
+Sink makeFileSink(std::FILE* out) {
+	return [out](std::span<const u8> chunk) -> hk::Result {
+		if (std::fwrite(chunk.data(), 1, chunk.size(), out) != chunk.size()) return ResultFileError();
+		return hk::ResultSuccess();
+	};
+}
+
+hk::Result writeFileReplacing(
+	const std::filesystem::path& path, const std::function<hk::Result(const Sink& sink)>& write
+) {
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+
+	std::ofstream outfile(tempPath, std::ios::out | std::ios::binary);
+	if (!outfile) return ResultFileError();
+
+	const hk::Result result = write(makeStreamSink(outfile));
+	outfile.close();
+
+	std::error_code error;
+	if (result.failed() || !outfile) {
+		std::filesystem::remove(tempPath, error);
+		if (result.failed()) return result;
+		return ResultFileError();
+	}
+
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return ResultFileError();
+	}
+
+	return hk::ResultSuccess();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <hk/Result.h>
+#include <ostream>
+#include <span>
+#include <vector>
+
+// receives output in order, one chunk at a time
+using Sink = std::function<hk::Result(std::span<const u8> chunk)>;
+
+// appends every chunk to `out`
+Sink makeVectorSink(std::vector<u8>& out);
+
+// writes every chunk to `out`, failing as soon as a write does
+Sink makeStreamSink(std::ostream& out);
+
+// the same for a C stream, e.g. `stdout`
+Sink makeFileSink(std::FILE* out);
+
+// passes `write` a sink for `path`, by way of a temporary file next to it that only replaces `path` once `write` has
+// succeeded. so `path` may be a file that is still being read from, and a failure leaves it as it was
+hk::Result writeFileReplacing(
+	const std::filesystem::path& path, const std::function<hk::Result(const Sink& sink)>& write
+);
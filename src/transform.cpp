@@ -0,0 +1,382 @@
+#include "transform.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <mutex>
+
+#include "archive.h"
+#include "byml.h"
+#include "mizuna/results.h"
+#include "mizuna/util.h"
+#include "repack.h"
+#include "results.h"
+#include "sarc.h"
+#include "stage.h"
+
+namespace fs = std::filesystem;
+
+namespace transform {
+
+namespace {
+
+// chains of links deeper than this (or cyclic ones) are taken to be malformed
+constexpr u32 cMaxLinkDepth = 64;
+
+bool parseIndex(u32& out, std::string_view token) {
+	const char* end = token.data() + token.size();
+	auto [ptr, ec] = std::from_chars(token.data(), end, out);
+	return !token.empty() && ec == std::errc() && ptr == end;
+}
+
+// the node at `path` below `node`
+hk::ValueOrResult<u32> findNode(const byml::FlatDocument& document, u32 node, std::span<const std::string> path) {
+	for (const std::string& component : path) {
+		s32 index = -1;
+		u32 arrayIndex;
+		if (document.getType(node) == byml::NodeType::Hash)
+			index = document.findEntry(node, component);
+		else if (document.getType(node) == byml::NodeType::Array && parseIndex(arrayIndex, component))
+			index = arrayIndex < document.getSize(node) ? s32(arrayIndex) : -1;
+
+		if (index < 0) return utils::ResultBymlKeyNotFound();
+		node = document.getEntry(node, index);
+	}
+
+	return node;
+}
+
+// `value` rounded to the nearest T. one that doesn't fit fails rather than being written out as a wider type
+template <typename T>
+hk::ValueOrResult<T> roundTo(f64 value) {
+	const f64 rounded = std::round(value);
+	// the upper bound is a power of two, so unlike the type's maximum, it's exact as an f64
+	if (!(rounded >= f64(std::numeric_limits<T>::min()) && rounded < std::ldexp(1.0, std::numeric_limits<T>::digits)))
+		return utils::ResultBymlInvalidValue();
+
+	return T(rounded);
+}
+
+// the number at `node` times `factor`, written out so `byml::parseNumber` reads it back as the same type. integers are
+// rounded to the nearest one, and fail if that is out of the type's range
+hk::ValueOrResult<std::string> scaleNumber(const byml::FlatDocument& document, u32 node, f64 factor) {
+	char buffer[32];
+	std::to_chars_result result;
+	switch (document.getType(node)) {
+	case byml::NodeType::F32:
+		result = std::to_chars(buffer, std::end(buffer), f32(HK_TRY(document.getF32(node)) * factor));
+		break;
+	case byml::NodeType::F64:
+		result = std::to_chars(buffer, std::end(buffer), HK_TRY(document.getF64(node)) * factor);
+		break;
+	case byml::NodeType::S32:
+		result = std::to_chars(buffer, std::end(buffer), HK_TRY(roundTo<s32>(HK_TRY(document.getS32(node)) * factor)));
+		break;
+	case byml::NodeType::U32:
+		result = std::to_chars(buffer, std::end(buffer), HK_TRY(roundTo<u32>(HK_TRY(document.getU32(node)) * factor)));
+		break;
+	case byml::NodeType::S64:
+		result = std::to_chars(buffer, std::end(buffer), HK_TRY(roundTo<s64>(HK_TRY(document.getS64(node)) * factor)));
+		break;
+	case byml::NodeType::U64:
+		result = std::to_chars(buffer, std::end(buffer), HK_TRY(roundTo<u64>(HK_TRY(document.getU64(node)) * factor)));
+		break;
+	default:
+		return byml::ResultInvalidNodeType();
+	}
+
+	return std::string(buffer, result.ptr);
+}
+
+// walks a stage like al-search, collecting `spec`'s edits for every object it matches with paths from the root
+class Transformer {
+public:
+	Transformer(const byml::FlatDocument& document, const Spec& spec) : mDocument(document), mSpec(spec) {
+		mKeys.init(document);
+	}
+
+	hk::Result transformScenario(u32 scenario);
+
+	std::vector<std::string> mPath;
+	std::vector<patch::Operation> mOperations;
+	u32 mNumObjects = 0;
+
+private:
+	hk::Result transformObject(u32 object, u32 depth);
+	hk::Result addEdits(u32 object);
+
+	const byml::FlatDocument& mDocument;
+	const Spec& mSpec;
+	stage::KeyIds mKeys;
+};
+
+hk::Result Transformer::transformScenario(u32 scenario) {
+	if (mDocument.getType(scenario) != byml::NodeType::Hash) return hk::ResultSuccess();
+
+	for (u32 listIdx = 0; listIdx < mDocument.getSize(scenario); listIdx++) {
+		const std::string_view listName = mDocument.getKey(mDocument.getEntryKey(scenario, listIdx));
+		if (listName == "FilePath" || listName == "Objs") continue;
+
+		const u32 itemList = mDocument.getEntry(scenario, listIdx);
+		if (mDocument.getType(itemList) != byml::NodeType::Array) continue;
+
+		mPath.emplace_back(listName);
+		for (u32 itemIdx = 0; itemIdx < mDocument.getSize(itemList); itemIdx++) {
+			mPath.push_back(std::to_string(itemIdx));
+			HK_TRY(transformObject(mDocument.getEntry(itemList, itemIdx), 0));
+			mPath.pop_back();
+		}
+		mPath.pop_back();
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Transformer::transformObject(u32 object, u32 depth) {
+	if (depth >= cMaxLinkDepth) return utils::ResultUnexpectedFormat();
+
+	stage::StageObjectView view;
+	HK_TRY(view.bind(mDocument, mKeys, object));
+
+	if (HK_TRY(view.matchesName(mSpec.name))) return addEdits(object);
+	if (!mSpec.isRecurse) return hk::ResultSuccess();
+
+	// an object reached through several links is edited at each of them, so every copy a rebuild makes agrees
+	const u32 linkGroups = HK_TRY(view.getLinks());
+	if (mDocument.getType(linkGroups) != byml::NodeType::Hash) return hk::ResultSuccess();
+
+	mPath.push_back("Links");
+	for (u32 groupIdx = 0; groupIdx < mDocument.getSize(linkGroups); groupIdx++) {
+		const u32 group = mDocument.getEntry(linkGroups, groupIdx);
+		if (mDocument.getType(group) != byml::NodeType::Array) continue;
+
+		mPath.emplace_back(mDocument.getKey(mDocument.getEntryKey(linkGroups, groupIdx)));
+
+		for (u32 linkIdx = 0; linkIdx < mDocument.getSize(group); linkIdx++) {
+			mPath.push_back(std::to_string(linkIdx));
+			HK_TRY(transformObject(mDocument.getEntry(group, linkIdx), depth + 1));
+			mPath.pop_back();
+		}
+		mPath.pop_back();
+	}
+	mPath.pop_back();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Transformer::addEdits(u32 object) {
+	mNumObjects++;
+
+	for (const Edit& edit : mSpec.edits) {
+		patch::Operation& operation = mOperations.emplace_back(edit.operation);
+		operation.path = mPath;
+		operation.path.insert(operation.path.end(), edit.operation.path.begin(), edit.operation.path.end());
+
+		if (!edit.isScale) continue;
+
+		// scaled values are worked out from the original document, so reaching one twice doesn't scale it twice
+		const u32 node = HK_TRY(findNode(mDocument, object, edit.operation.path));
+		operation.value.text = HK_TRY(scaleNumber(mDocument, node, edit.factor));
+	}
+
+	return hk::ResultSuccess();
+}
+
+// compresses `data` the way the archive at `inPath` was, i.e. with `layers` (outermost first)
+hk::Result writeArchive(
+	Stats& stats, const fs::path& inPath, const fs::path& outPath, std::vector<u8>&& data,
+	const std::vector<archive::Layer>& layers, zs::DictionarySet* dictionaries
+) {
+	// `outPath` may be `inPath`, which is only replaced once the new archive is complete
+	if (layers.size() == 1 && layers[0].format == archive::Format::Yaz0) {
+		std::vector<u8> baseSzs;
+		HK_TRY(util::readFile(baseSzs, inPath));
+
+		szs::RepackStats repackStats;
+		HK_TRY(writeFileReplacing(outPath, [&](const Sink& sink) {
+			return szs::repackArchive(sink, baseSzs, data, repackStats);
+		}));
+		stats.compressedSize += repackStats.compressedSize;
+		stats.reusedSize += repackStats.reusedSize;
+		return hk::ResultSuccess();
+	}
+
+	HK_TRY(archive::compressLayers(data, layers, outPath.filename().string(), dictionaries));
+	stats.compressedSize += data.size();
+	return writeFileReplacing(outPath, [&](const Sink& sink) { return sink(data); });
+}
+
+// counts into `stats`, which only holds this archive's numbers
+hk::Result transformArchive(
+	Stats& stats, const fs::path& inPath, const fs::path& outPath, const Spec& spec, zs::DictionarySet* dictionaries
+) {
+	archive::File file;
+	HK_TRY(file.open(inPath, dictionaries));
+	if (file.getFormat() != archive::Format::Sarc) return hk::ResultSuccess();
+	stats.numArchives++;
+
+	const std::span<const u8> data = file.getData();
+	sarc::EntryTable table;
+	HK_TRY(table.init(data));
+
+	const std::vector<sarc::EntryInfo>& entries = table.getEntries();
+	std::vector<sarc::LayoutFile> files;
+	std::vector<std::vector<u8>> edited(entries.size()); // empty for entries left as they were
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (entries[i].end > data.size()) return utils::ResultSarcInvalidHeader();
+		const std::span<const u8> entryData = data.subspan(entries[i].start, entries[i].end - entries[i].start);
+		files.push_back({ std::string(table.getName(entries[i])), entryData.size() });
+
+		if (archive::detectFormat(entryData) != archive::Format::Byml) continue;
+
+		patch::Stats patchStats;
+		const u32 numObjects = HK_TRY(transformByml(edited[i], entryData, spec, patchStats));
+		if (numObjects == 0) continue;
+
+		files.back().size = edited[i].size();
+		stats.numObjects += numObjects;
+		if (!patchStats.isRebuilt) stats.numInPlace++;
+	}
+
+	if (stats.numObjects == 0) return hk::ResultSuccess();
+	stats.numChanged++;
+
+	sarc::Layout layout;
+	// laid out like the original, so that unchanged files stay where they were and a repack can reuse the most
+	HK_TRY(sarc::buildLayout(layout, files, table.getByteOrder(), table.inferAlignment()));
+
+	std::vector<u8> archiveData = std::move(layout.metadata);
+	archiveData.resize(layout.archiveSize);
+	for (size_t i = 0; i < entries.size(); i++) {
+		const std::span<const u8> entryData =
+			edited[i].empty() ? data.subspan(entries[i].start, entries[i].end - entries[i].start) : edited[i];
+		std::memcpy(archiveData.data() + layout.offsets[i], entryData.data(), entryData.size());
+	}
+
+	return writeArchive(stats, inPath, outPath, std::move(archiveData), file.getLayers(), dictionaries);
+}
+
+} // namespace
+
+hk::Result parseSpec(Spec& out, std::istream& in) {
+	patch::Value root;
+	HK_TRY(patch::parseValue(root, in));
+	if (root.kind != patch::Value::Kind::Object) return utils::ResultInvalidArgument();
+
+	const patch::Value* name = patch::findMember(root, "name");
+	const patch::Value* recurse = patch::findMember(root, "recurse");
+	const patch::Value* edits = patch::findMember(root, "edits");
+	if (!name || name->kind != patch::Value::Kind::String || !edits || edits->kind != patch::Value::Kind::Array)
+		return utils::ResultInvalidArgument();
+	if (recurse && recurse->kind != patch::Value::Kind::Bool) return utils::ResultInvalidArgument();
+
+	out.name = name->text;
+	out.isRecurse = recurse && recurse->boolean;
+	out.edits.clear();
+
+	for (const patch::Value& item : edits->items) {
+		Edit& edit = out.edits.emplace_back();
+
+		// a scale is a replace whose value is only known once the object is
+		const patch::Value* op = patch::findMember(item, "op");
+		if (!op || op->kind != patch::Value::Kind::String || op->text != "scale") {
+			HK_TRY(patch::parseOperation(edit.operation, item));
+			continue;
+		}
+
+		patch::Value replace = item;
+		for (auto& [key, value] : replace.members)
+			if (key == "op") value.text = "replace";
+		HK_TRY(patch::parseOperation(edit.operation, replace));
+
+		const std::string& factor = edit.operation.value.text;
+		if (edit.operation.value.kind != patch::Value::Kind::Number) return utils::ResultInvalidArgument();
+		auto [ptr, ec] = std::from_chars(factor.data(), factor.data() + factor.size(), edit.factor);
+		if (ec != std::errc() || ptr != factor.data() + factor.size()) return utils::ResultInvalidArgument();
+		edit.isScale = true;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<u32> transformByml(
+	std::vector<u8>& out, std::span<const u8> data, const Spec& spec, patch::Stats& patchStats
+) {
+	byml::Document document;
+	HK_TRY(document.init(data));
+
+	// most stages don't mention the object at all, and those aren't decoded
+	if (HK_TRY(document.findString(spec.name)) < 0) return 0;
+
+	byml::FlatDocument flat;
+	HK_TRY(flat.init(document));
+	const u32 root = byml::FlatDocument::cRoot;
+
+	// SMO stages are an array of scenarios, and 3D World ones a single scenario
+	Transformer transformer(flat, spec);
+	if (flat.getType(root) == byml::NodeType::Array) {
+		for (u32 scenarioIdx = 0; scenarioIdx < flat.getSize(root); scenarioIdx++) {
+			transformer.mPath = { std::to_string(scenarioIdx) };
+			HK_TRY(transformer.transformScenario(flat.getEntry(root, scenarioIdx)));
+		}
+	} else {
+		HK_TRY(transformer.transformScenario(root));
+	}
+
+	if (transformer.mNumObjects == 0) return 0;
+
+	out.assign(data.begin(), data.end());
+	HK_TRY(patch::patchByml(out, transformer.mOperations, patchStats));
+	return transformer.mNumObjects;
+}
+
+hk::Result transformAll(
+	const fs::path& romfsDir, const fs::path& outDir, const Spec& spec, zs::DictionarySet* dictionaries,
+	ThreadPool& pool, Stats& stats
+) {
+	const fs::path stageDir = romfsDir / "StageData";
+	if (!fs::is_directory(stageDir)) return ResultDirNotFound();
+
+	std::vector<fs::path> filenames;
+	for (const auto& entry : fs::directory_iterator(stageDir))
+		if (entry.is_regular_file()) filenames.push_back(entry.path().filename());
+	std::sort(filenames.begin(), filenames.end());
+
+	const fs::path outStageDir = outDir / "StageData";
+	std::error_code ec;
+	fs::create_directories(outStageDir, ec);
+	if (ec) return ResultFileError();
+
+	stats = {};
+	std::mutex mutex;
+
+	pool.forEach(filenames.size(), [&](size_t i) {
+		Stats archiveStats;
+		const hk::Result result =
+			transformArchive(archiveStats, stageDir / filenames[i], outStageDir / filenames[i], spec, dictionaries);
+
+		std::scoped_lock lock(mutex);
+		if (result.failed()) {
+			stats.failures.push_back({ fs::path("StageData") / filenames[i], result });
+			return;
+		}
+
+		stats.numArchives += archiveStats.numArchives;
+		stats.numChanged += archiveStats.numChanged;
+		stats.numObjects += archiveStats.numObjects;
+		stats.numInPlace += archiveStats.numInPlace;
+		stats.compressedSize += archiveStats.compressedSize;
+		stats.reusedSize += archiveStats.reusedSize;
+	});
+
+	std::sort(stats.failures.begin(), stats.failures.end(), [](const Failure& a, const Failure& b) {
+		return a.path < b.path;
+	});
+
+	return hk::ResultSuccess();
+}
+
+} // namespace transform
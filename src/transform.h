@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <istream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "patch.h"
+#include "pool.h"
+#include "zs.h"
+
+namespace transform {
+
+struct Edit {
+	patch::Operation operation; // with a path from the matched object
+	bool isScale = false;       // replaces the number at the path with itself times `factor`
+	f64 factor = 1.0;
+};
+
+// which placement objects to change and how, read from e.g.
+//   {"name": "Kuribo", "recurse": true, "edits": [{"op": "replace", "path": "ModelName", "value": "KuriboGold"},
+//    {"op": "scale", "path": "Scale/Y", "value": 2}]}
+// objects are matched by name as in al-search, `recurse` also looks through the Links of objects that don't match, and
+// edits are patch operations (see `patch::parseOperations`) plus `scale`
+struct Spec {
+	std::string name;
+	bool isRecurse = false;
+	std::vector<Edit> edits;
+};
+
+hk::Result parseSpec(Spec& out, std::istream& in);
+
+// edits every object in the stage BYML `data` that `spec` matches through `patch::patchByml`, and returns how many
+// there were. the edited BYML goes to `out`, which is only written if something matched. BYMLs that don't hold the
+// name as a string at all aren't decoded any further
+hk::ValueOrResult<u32> transformByml(
+	std::vector<u8>& out, std::span<const u8> data, const Spec& spec, patch::Stats& patchStats
+);
+
+struct Failure {
+	std::filesystem::path path;
+	hk::Result result;
+};
+
+struct Stats {
+	u64 numArchives = 0;
+	u64 numChanged = 0; // archives with at least one matching object, which are the only ones written
+	u64 numObjects = 0;
+	u64 numInPlace = 0; // BYMLs whose values were all overwritten where they were, rather than rebuilt
+	u64 compressedSize = 0;
+	u64 reusedSize = 0; // compressed bytes of SZS archives copied over rather than encoded again
+	std::vector<Failure> failures;
+};
+
+// applies `spec` to every archive in `romfsDir/StageData` on `pool`, in memory. archives where nothing matched are left
+// out, and the rest are written to `outDir/StageData` with the compression they had. SZS archives are repacked like
+// `szs u`, so only the data from the first changed file on is compressed again
+hk::Result transformAll(
+	const std::filesystem::path& romfsDir, const std::filesystem::path& outDir, const Spec& spec,
+	zs::DictionarySet* dictionaries, ThreadPool& pool, Stats& stats
+);
+
+} // namespace transform
@@ -0,0 +1,160 @@
+#include "vfs.h"
+
+#include <vector>
+
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace fs = std::filesystem;
+
+namespace vfs {
+
+namespace {
+
+// splits `path` on slashes, dropping empty and `.` components. `..` is refused, so paths stay below the root
+hk::Result splitPath(std::vector<std::string>& out, std::string_view path) {
+	out.clear();
+	while (!path.empty()) {
+		const size_t slash = path.find('/');
+		const std::string_view component = path.substr(0, slash);
+		path = slash == std::string_view::npos ? std::string_view() : path.substr(slash + 1);
+
+		if (component.empty() || component == ".") continue;
+		if (component == "..") return utils::ResultInvalidArgument();
+		out.emplace_back(component);
+	}
+
+	return out.empty() ? utils::ResultInvalidArgument() : hk::ResultSuccess();
+}
+
+} // namespace
+
+FileSystem::FileSystem(const fs::path& root, size_t cacheBudget, const zs::DictionarySet* dictionaries)
+	: mRoot(root), mCacheBudget(cacheBudget), mDictionaries(dictionaries) {}
+
+hk::Result FileSystem::open(FileHandle& out, std::string_view path) {
+	FileHandle handle;
+	HK_TRY(resolve(handle, path));
+	if (!handle.mOwner) return ResultFileError();
+
+	out = std::move(handle);
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<bool> FileSystem::exists(std::string_view path) {
+	FileHandle handle;
+	HK_TRY(resolve(handle, path));
+	return handle.mOwner != nullptr;
+}
+
+size_t FileSystem::getCacheSize() const {
+	std::lock_guard lock(mMutex);
+	return mCacheSize;
+}
+
+hk::Result FileSystem::resolve(FileHandle& out, std::string_view path) {
+	std::vector<std::string> components;
+	HK_TRY(splitPath(components, path));
+
+	// real directories first, up to the first file
+	fs::path diskPath = mRoot;
+	size_t i = 0;
+	while (i < components.size()) {
+		diskPath /= components[i++];
+		if (!fs::is_directory(diskPath)) break;
+	}
+	if (!fs::is_regular_file(diskPath)) return hk::ResultSuccess();
+
+	if (i == components.size()) {
+		auto file = std::make_shared<archive::File>();
+		HK_TRY(file->open(diskPath, mDictionaries));
+		out.mData = file->getData();
+		out.mOwner = std::move(file);
+		return hk::ResultSuccess();
+	}
+
+	// the rest of the path is inside the archive, and maybe inside archives within it
+	std::string key = diskPath.lexically_relative(mRoot).generic_string();
+	std::shared_ptr<const CachedArchive> archive =
+		HK_TRY(getArchive(key, [&](archive::File& file) { return file.open(diskPath, mDictionaries); }));
+
+	while (archive) {
+		// entry names have slashes of their own, so the shortest run of components naming an entry is taken
+		std::string name;
+		bool isFound = false;
+		while (i < components.size() && !isFound) {
+			if (!name.empty()) name += '/';
+			name += components[i++];
+			isFound = archive->view.hasFile(name);
+		}
+		if (!isFound) return hk::ResultSuccess();
+
+		const std::span<const u8> data = HK_TRY(archive->view.getFileData(name));
+		key += '/';
+		key += name;
+
+		if (i == components.size()) {
+			if (!archive::isCompression(archive::detectFormat(data))) {
+				// the handle shares ownership of the cached archive, which keeps it alive past eviction
+				out.mData = data;
+				out.mOwner = archive;
+				return hk::ResultSuccess();
+			}
+
+			auto file = std::make_shared<archive::File>();
+			HK_TRY(file->open({ data.begin(), data.end() }, mDictionaries));
+			out.mData = file->getData();
+			out.mOwner = std::move(file);
+			return hk::ResultSuccess();
+		}
+
+		archive = HK_TRY(getArchive(key, [&](archive::File& file) {
+			return file.open({ data.begin(), data.end() }, mDictionaries);
+		}));
+	}
+
+	// a file on the way that isn't an archive
+	return hk::ResultSuccess();
+}
+
+hk::ValueOrResult<std::shared_ptr<const FileSystem::CachedArchive>>
+FileSystem::getArchive(const std::string& key, const LoadFunc& load) {
+	{
+		std::lock_guard lock(mMutex);
+		auto it = mCache.find(key);
+		if (it != mCache.end()) {
+			mLru.splice(mLru.begin(), mLru, it->second.lruPos);
+			return it->second.archive;
+		}
+	}
+
+	// loaded outside the lock, so threads reading different archives don't wait on each other
+	auto archive = std::make_shared<CachedArchive>();
+	HK_TRY(load(archive->file));
+	if (archive->file.getFormat() != archive::Format::Sarc) return std::shared_ptr<const CachedArchive>();
+	HK_TRY(archive->view.init(archive->file.getData()));
+
+	std::lock_guard lock(mMutex);
+	auto [it, isNew] = mCache.try_emplace(key);
+	if (!isNew) {
+		// another thread got here first
+		mLru.splice(mLru.begin(), mLru, it->second.lruPos);
+		return it->second.archive;
+	}
+
+	mLru.push_front(key);
+	it->second = { archive, mLru.begin() };
+	mCacheSize += archive->file.getData().size();
+
+	// the archive just loaded always stays, even on its own over budget
+	while (mCacheSize > mCacheBudget && mLru.size() > 1) {
+		auto victim = mCache.find(mLru.back());
+		mCacheSize -= victim->second.archive->file.getData().size();
+		mCache.erase(victim);
+		mLru.pop_back();
+	}
+
+	return std::shared_ptr<const CachedArchive>(archive);
+}
+
+} // namespace vfs
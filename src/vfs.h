@@ -0,0 +1,81 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <hk/ValueOrResult.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "archive.h"
+#include "sarc.h"
+#include "zs.h"
+
+namespace vfs {
+
+constexpr size_t cDefaultCacheBudget = 512 * 1024 * 1024;
+
+// a file's decoded contents, which keep the archive they point into alive for as long as the handle is around
+class FileHandle {
+public:
+	std::span<const u8> getData() const { return mData; }
+
+private:
+	friend class FileSystem;
+
+	std::shared_ptr<const void> mOwner;
+	std::span<const u8> mData;
+};
+
+// paths below a romfs that carry on into archives, e.g. `StageData/FooStageMap.szs/FooStageMap.byml`, with every layer
+// of compression removed along the way. decoded archives are kept in an LRU cache of up to `cacheBudget` bytes, so
+// reading more files from the same archive never decompresses it again. safe to share between threads
+class FileSystem {
+public:
+	explicit FileSystem(
+		const std::filesystem::path& root, size_t cacheBudget = cDefaultCacheBudget,
+		const zs::DictionarySet* dictionaries = nullptr
+	);
+
+	// fails with ResultFileError if there's nothing at `path`
+	hk::Result open(FileHandle& out, std::string_view path);
+
+	// only fails if something along `path` can't be read
+	hk::ValueOrResult<bool> exists(std::string_view path);
+
+	size_t getCacheSize() const;
+
+private:
+	struct CachedArchive {
+		archive::File file;
+		sarc::ArchiveView view;
+	};
+
+	using LoadFunc = std::function<hk::Result(archive::File& file)>;
+
+	// `out` is left empty if there's nothing at `path`
+	hk::Result resolve(FileHandle& out, std::string_view path);
+
+	// the archive cached under `key`, or loaded with `load` and cached. null if it turns out not to be a SARC
+	hk::ValueOrResult<std::shared_ptr<const CachedArchive>> getArchive(const std::string& key, const LoadFunc& load);
+
+	const std::filesystem::path mRoot;
+	const size_t mCacheBudget;
+	const zs::DictionarySet* mDictionaries;
+
+	struct CacheEntry {
+		std::shared_ptr<const CachedArchive> archive;
+		std::list<std::string>::iterator lruPos;
+	};
+
+	mutable std::mutex mMutex;
+	std::unordered_map<std::string, CacheEntry> mCache;
+	std::list<std::string> mLru; // most recently used first
+	size_t mCacheSize = 0;
+};
+
+} // namespace vfs
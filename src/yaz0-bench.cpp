@@ -0,0 +1,209 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <hk/diag/diag.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "clipp/clipp.h"
+#include "mizuna/util.h"
+#include "mizuna/yaz0.h"
+#include "yaz0.h"
+
+namespace fs = std::filesystem;
+
+struct Sample {
+	std::string name;
+	std::vector<u8> compressed;
+	u32 decompressedSize = 0;
+};
+
+// incompressible data, almost every group is all literals
+std::vector<u8> generateRandom(std::mt19937& rng, size_t size) {
+	std::vector<u8> out(size);
+	for (u8& b : out)
+		b = rng();
+	return out;
+}
+
+// long runs of a single byte, exercising distance 1 back-references
+std::vector<u8> generateRuns(std::mt19937& rng, size_t size) {
+	std::vector<u8> out;
+	while (out.size() < size) {
+		u8 value = rng();
+		size_t len = 1 + rng() % 300;
+		out.insert(out.end(), std::min(len, size - out.size()), value);
+	}
+	return out;
+}
+
+// words from a small vocabulary, giving medium-length matches at varied distances
+std::vector<u8> generateText(std::mt19937& rng, size_t size) {
+	static const char* words[] = { "Translate", "Rotate",     "Scale",      "UnitConfigName", "ParameterConfigName",
+		                           "ModelName", "Links",      "Id",         "obj",            "LayerConfigName",
+		                           "Common",    "PlacementId", "IsLinkDest", "X",              "Y",
+		                           "Z" };
+	std::vector<u8> out;
+	while (out.size() < size) {
+		const char* word = words[rng() % std::size(words)];
+		out.insert(out.end(), word, word + strlen(word));
+		out.push_back(rng() % 4 == 0 ? '\n' : ' ');
+	}
+	out.resize(size);
+	return out;
+}
+
+// fixed-size records with small variations, giving short overlapping matches
+std::vector<u8> generateRecords(std::mt19937& rng, size_t size) {
+	std::vector<u8> out;
+	u32 recordSize = 3;
+	while (out.size() < size) {
+		if (rng() % 64 == 0) recordSize = 2 + rng() % 14;
+		for (u32 i = 0; i < recordSize; i++)
+			out.push_back(i == 0 && rng() % 8 == 0 ? rng() : i);
+	}
+	out.resize(size);
+	return out;
+}
+
+hk::Result addSample(std::vector<Sample>& corpus, const std::string& name, const std::vector<u8>& contents) {
+	Sample sample;
+	sample.name = name;
+
+	if (contents.size() >= yaz0::cHeaderSize && memcmp(contents.data(), "Yaz0", 4) == 0)
+		sample.compressed = contents;
+	else
+		yaz0::compress(sample.compressed, contents, 0x80);
+
+	sample.decompressedSize = HK_TRY(yaz0::readDecompressedSize(sample.compressed));
+	corpus.push_back(std::move(sample));
+
+	return hk::ResultSuccess();
+}
+
+template <typename Func>
+f64 timeDecoder(const Sample& sample, u32 iterations, Func&& decode) {
+	auto start = std::chrono::steady_clock::now();
+	for (u32 i = 0; i < iterations; i++)
+		decode();
+	std::chrono::duration<f64> elapsed = std::chrono::steady_clock::now() - start;
+
+	return f64(sample.decompressedSize) * iterations / elapsed.count() / (1024 * 1024);
+}
+
+hk::Result runBenchmark(const std::vector<Sample>& corpus, u32 iterations) {
+	printf("%-32s %10s %12s %12s %8s\n", "sample", "size", "ref MiB/s", "fast MiB/s", "speedup");
+
+	f64 totalRef = 0;
+	f64 totalFast = 0;
+	u64 totalSize = 0;
+
+	for (const Sample& sample : corpus) {
+		std::vector<u8> expected;
+		HK_TRY(yaz0::decompress(expected, sample.compressed));
+
+		std::vector<u8> actual;
+		HK_TRY(yaz0::decompressFast(actual, sample.compressed));
+
+		if (actual != expected) {
+			fprintf(stderr, "error: fast decoder output differs from reference for %s\n", sample.name.c_str());
+			return hk::ResultInvalidArgument();
+		}
+
+		hk::Result r = hk::ResultSuccess();
+		f64 refSpeed = timeDecoder(sample, iterations, [&] { r = yaz0::decompress(expected, sample.compressed); });
+		HK_TRY(r);
+		f64 fastSpeed = timeDecoder(sample, iterations, [&] { r = yaz0::decompressFast(actual, sample.compressed); });
+		HK_TRY(r);
+
+		printf(
+			"%-32s %10u %12.1f %12.1f %7.2fx\n", sample.name.c_str(), sample.decompressedSize, refSpeed, fastSpeed,
+			fastSpeed / refSpeed
+		);
+
+		// accumulate time per byte so large samples weigh more
+		totalRef += sample.decompressedSize / refSpeed;
+		totalFast += sample.decompressedSize / fastSpeed;
+		totalSize += sample.decompressedSize;
+	}
+
+	if (totalSize != 0) {
+		printf(
+			"%-32s %10llu %12.1f %12.1f %7.2fx\n", "total", (unsigned long long)totalSize, totalSize / totalRef,
+			totalSize / totalFast, totalRef / totalFast
+		);
+	}
+
+	return hk::ResultSuccess();
+}
+
+s32 main(s32 argc, char** argv) {
+	using namespace clipp;
+
+	std::vector<std::string> paths;
+	u32 iterations = 10;
+	u32 syntheticSize = 0x40000;
+
+	// clang-format off
+
+	bool isShowHelp = false;
+	auto cli = (
+		option("-n", "--iterations").doc("decode passes per sample (default: 10)") & value("count", iterations),
+		option("-s", "--synthetic-size").doc("synthetic sample size (default: 262144)") & value("bytes", syntheticSize),
+	    option("-h", "--help").set(isShowHelp).doc("show this screen"),
+		opt_values("paths", paths).doc("Yaz0 files, raw files to compress first, or directories of either")
+	);
+
+	// clang-format on
+
+	if (!parse(argc, argv, cli) || isShowHelp) {
+		auto fmt = doc_formatting {}.first_column(2).doc_column(24);
+
+		std::string programName = "./" + fs::path(argv[0]).filename().string();
+
+		std::cout << "usage:\n"
+				  << usage_lines(cli, programName, fmt) << "\n\noptions:\n"
+				  << documentation(cli, fmt) << std::endl;
+		return 1;
+	}
+
+	std::vector<Sample> corpus;
+	hk::Result r = hk::ResultSuccess();
+
+	std::mt19937 rng(0x59617a30);
+	if (syntheticSize != 0) {
+		r = addSample(corpus, "synthetic/random", generateRandom(rng, syntheticSize));
+		if (r.succeeded()) r = addSample(corpus, "synthetic/runs", generateRuns(rng, syntheticSize));
+		if (r.succeeded()) r = addSample(corpus, "synthetic/text", generateText(rng, syntheticSize));
+		if (r.succeeded()) r = addSample(corpus, "synthetic/records", generateRecords(rng, syntheticSize));
+	}
+
+	for (const std::string& path : paths) {
+		if (r.failed()) break;
+
+		std::vector<fs::path> files;
+		if (fs::is_directory(path)) {
+			for (const auto& entry : fs::recursive_directory_iterator(path))
+				if (entry.is_regular_file()) files.push_back(entry.path());
+		} else {
+			files.push_back(path);
+		}
+
+		for (const fs::path& file : files) {
+			std::vector<u8> contents;
+			r = util::readFile(contents, file);
+			if (r.succeeded()) r = addSample(corpus, file.filename().string(), contents);
+			if (r.failed()) break;
+		}
+	}
+
+	if (r.succeeded()) r = runBenchmark(corpus, iterations);
+
+	if (r.failed()) {
+		if (r != hk::ResultInvalidArgument()) fprintf(stderr, "error: %s\n", hk::diag::getResultName(r));
+		return 1;
+	}
+}
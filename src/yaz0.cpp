@@ -0,0 +1,808 @@
+#include "yaz0.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+#include "binary.h"
+#include "hash.h"
+#include "mizuna/results.h"
+#include "results.h"
+
+namespace yaz0 {
+
+namespace {
+
+// a group is one flag byte followed by at most eight 3-byte back-references
+constexpr size_t cMaxGroupIn = 1 + 8 * 3;
+// eight back-references of the maximum length (0xff + 0x12)
+constexpr size_t cMaxGroupOut = 8 * 0x111;
+// literal runs read 8 bytes at a time, so the input needs that much slack past a group
+constexpr size_t cInputSlack = 8;
+// wide copies round the copy length up and may write this far past the end of a run
+constexpr size_t cOutputSlack = 32;
+
+// output bytes passed to the sink at once by decompressStream, and compressed bytes read at once
+constexpr size_t cStreamChunkSize = 0x10000;
+
+// extra room given to in-place decoding, as a fraction of the output size
+constexpr u32 cInPlaceMarginRatio = 32;
+
+constexpr u32 cMinMatchLength = 3;
+constexpr u32 cMaxShortMatchLength = 0x11; // longest match that fits in a 2-byte token
+constexpr u32 cMaxMatchLength = 0x111;
+
+// input held by the encoder past the window, so it isn't shifting its buffer after every write
+constexpr size_t cEncodeChunkSize = 0x40000;
+constexpr u32 cHashBits = 15;
+// candidates tried per position. more finds slightly better matches, much more slowly
+constexpr u32 cMaxChainLength = 128;
+// matches at least this long are taken without checking whether the next position has a better one
+constexpr u32 cLazyMatchLength = 0x20;
+
+constexpr u32 cSeekIndexVersion = 2;
+constexpr size_t cSeekIndexHeaderSize = 0x20;
+constexpr size_t cSeekCheckpointHeaderSize = 0xc;
+
+struct Cursor {
+	const u8* src;
+	const u8* srcEnd;
+	const u8* history; // earliest output a back-reference may read from
+	u8* dst;
+	u8* dstEnd;
+	u32 flags = 0;
+	u32 flagsLeft = 0;
+};
+
+void copy16(u8* dst, const u8* src) {
+	std::memcpy(dst, src, 16);
+}
+
+void copy32(u8* dst, const u8* src) {
+	std::memcpy(dst, src, 32);
+}
+
+// copies `len` bytes from `dist` bytes behind `dst`. may write up to cOutputSlack bytes past the end
+void copyMatch(u8* dst, u32 dist, u32 len) {
+	const u8* src = dst - dist;
+
+	if (dist >= 32) {
+		for (u32 i = 0; i < len; i += 32)
+			copy32(dst + i, src + i);
+	} else if (dist >= 16) {
+		for (u32 i = 0; i < len; i += 16)
+			copy16(dst + i, src + i);
+	} else if (dist == 1) {
+		std::memset(dst, *src, len);
+	} else {
+		// the output repeats with period `dist`, so it also repeats with any multiple of it. write bytes one at a
+		// time until a multiple of at least 16 is backed by data, then continue with wide copies at that distance
+		u32 period = dist;
+		while (period < 16)
+			period += dist;
+
+		u32 i = 0;
+		for (; i < period - dist && i < len; i++)
+			dst[i] = src[i];
+		for (; i < len; i += 16)
+			copy16(dst + i, dst + i - period);
+	}
+}
+
+// decodes one token at a time with full bounds checks until the output is full, or the current group ends if
+// `isStopAtGroupEnd` is set. a back-reference running past the end of the output is cut short
+hk::Result decodeChecked(Cursor& c, bool isStopAtGroupEnd) {
+	while (c.dst < c.dstEnd) {
+		if (c.flagsLeft == 0) {
+			if (isStopAtGroupEnd) break;
+			if (c.src >= c.srcEnd) return utils::ResultYaz0Truncated();
+			c.flags = *c.src++;
+			c.flagsLeft = 8;
+		}
+
+		if (c.flags & 0x80) {
+			if (c.src >= c.srcEnd) return utils::ResultYaz0Truncated();
+			*c.dst++ = *c.src++;
+		} else {
+			if (c.srcEnd - c.src < 2) return utils::ResultYaz0Truncated();
+			u32 b1 = c.src[0];
+			u32 b2 = c.src[1];
+			c.src += 2;
+
+			u32 dist = ((b1 & 0xf) << 8 | b2) + 1;
+			u32 len = b1 >> 4;
+			if (len == 0) {
+				if (c.src >= c.srcEnd) return utils::ResultYaz0Truncated();
+				len = *c.src++ + 0x12;
+			} else {
+				len += 2;
+			}
+
+			if (dist > size_t(c.dst - c.history)) return utils::ResultYaz0InvalidBackref();
+
+			len = std::min<size_t>(len, c.dstEnd - c.dst);
+			const u8* from = c.dst - dist;
+			for (u32 i = 0; i < len; i++)
+				c.dst[i] = from[i];
+			c.dst += len;
+		}
+
+		c.flags = (c.flags << 1) & 0xff;
+		c.flagsLeft--;
+	}
+
+	return hk::ResultSuccess();
+}
+
+// decodes whole groups for as long as one (plus copy slack) fits in both buffers, so only back-reference distances
+// are checked. must start at a group boundary
+hk::Result decodeFast(Cursor& c) {
+	const u8* src = c.src;
+	u8* dst = c.dst;
+
+	while (size_t(c.srcEnd - src) >= cMaxGroupIn + cInputSlack &&
+	       size_t(c.dstEnd - dst) >= cMaxGroupOut + cOutputSlack) {
+		u32 flags = u32(*src++) << 24;
+		u32 remaining = 8;
+
+		while (remaining != 0) {
+			u32 run = std::countl_one(flags);
+			if (run != 0) {
+				std::memcpy(dst, src, 8);
+				dst += run;
+				src += run;
+				flags <<= run;
+				remaining -= run;
+				continue;
+			}
+
+			u32 b1 = src[0];
+			u32 b2 = src[1];
+			src += 2;
+
+			u32 dist = ((b1 & 0xf) << 8 | b2) + 1;
+			u32 len = b1 >> 4;
+			if (len == 0)
+				len = *src++ + 0x12;
+			else
+				len += 2;
+
+			if (dist > size_t(dst - c.history)) return utils::ResultYaz0InvalidBackref();
+
+			copyMatch(dst, dist, len);
+			dst += len;
+			flags <<= 1;
+			remaining--;
+		}
+	}
+
+	c.src = src;
+	c.dst = dst;
+
+	return hk::ResultSuccess();
+}
+
+hk::Result decode(Cursor& c) {
+	if (c.flagsLeft != 0) HK_TRY(decodeChecked(c, true));
+	HK_TRY(decodeFast(c));
+	return decodeChecked(c, false);
+}
+
+// hash of the 3 bytes at `p`, the shortest possible match
+u32 hashPrefix(const u8* p) {
+	return ((p[0] << 16 | p[1] << 8 | p[2]) * 0x9e3779b1) >> (32 - cHashBits);
+}
+
+// visits every token boundary (and the end of the stream) with the output position and the decoder state there,
+// without producing any output
+template <typename Func>
+hk::Result walkTokens(std::span<const u8> in, u32 decompressedSize, Func&& visit) {
+	const u8* src = in.data() + cHeaderSize;
+	const u8* srcEnd = in.data() + in.size();
+	u32 pos = 0;
+	u32 flags = 0;
+	u32 flagsLeft = 0;
+
+	while (pos < decompressedSize) {
+		visit(pos, u32(src - in.data()), flags, flagsLeft);
+
+		if (flagsLeft == 0) {
+			if (src >= srcEnd) return utils::ResultYaz0Truncated();
+			flags = *src++;
+			flagsLeft = 8;
+		}
+
+		if (flags & 0x80) {
+			if (src >= srcEnd) return utils::ResultYaz0Truncated();
+			src++;
+			pos++;
+		} else {
+			if (srcEnd - src < 2) return utils::ResultYaz0Truncated();
+			u32 len = src[0] >> 4;
+			src += 2;
+			if (len == 0) {
+				if (src >= srcEnd) return utils::ResultYaz0Truncated();
+				len = *src++ + 0x12;
+			} else {
+				len += 2;
+			}
+			pos = std::min(pos + len, decompressedSize);
+		}
+
+		flags = (flags << 1) & 0xff;
+		flagsLeft--;
+	}
+
+	visit(pos, u32(src - in.data()), flags, flagsLeft);
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::ValueOrResult<u32> readDecompressedSize(std::span<const u8> in) {
+	if (in.size() < cHeaderSize || std::memcmp(in.data(), "Yaz0", 4) != 0) return utils::ResultYaz0InvalidMagic();
+
+	return bin::readBE<u32>(in.data() + 4);
+}
+
+hk::ValueOrResult<u32> readAlignment(std::span<const u8> in) {
+	if (in.size() < cHeaderSize || std::memcmp(in.data(), "Yaz0", 4) != 0) return utils::ResultYaz0InvalidMagic();
+
+	return bin::readBE<u32>(in.data() + 8);
+}
+
+hk::Result decompressInto(std::span<u8> out, std::span<const u8> in) {
+	if (in.size() < cHeaderSize || std::memcmp(in.data(), "Yaz0", 4) != 0) return utils::ResultYaz0InvalidMagic();
+
+	Cursor c = { .src = in.data() + cHeaderSize,
+		         .srcEnd = in.data() + in.size(),
+		         .history = out.data(),
+		         .dst = out.data(),
+		         .dstEnd = out.data() + out.size() };
+
+	return decode(c);
+}
+
+hk::Result decompressFast(std::vector<u8>& out, std::span<const u8> in) {
+	u32 size = HK_TRY(readDecompressedSize(in));
+	out.resize(size);
+
+	return decompressInto(out, in);
+}
+
+hk::Result decompressInPlace(std::vector<u8>& buffer, size_t inOffset) {
+	std::span<const u8> in(buffer.begin() + inOffset, buffer.end());
+	u32 decompressedSize = HK_TRY(readDecompressedSize(in));
+
+	// the output may never catch up with the input still to be read, including the slack of wide copies
+	bool isSafe = buffer.size() >= decompressedSize;
+	if (isSafe) {
+		HK_TRY(walkTokens(in, decompressedSize, [&](u32 pos, u32 inOffsetInStream, u32, u32) {
+			if (pos + cOutputSlack > inOffset + inOffsetInStream) isSafe = false;
+		}));
+	}
+
+	if (!isSafe) {
+		std::vector<u8> compressed(in.begin(), in.end());
+		buffer.resize(decompressedSize);
+		return decompressInto(buffer, compressed);
+	}
+
+	Cursor c = { .src = in.data() + cHeaderSize,
+		         .srcEnd = in.data() + in.size(),
+		         .history = buffer.data(),
+		         .dst = buffer.data(),
+		         .dstEnd = buffer.data() + decompressedSize };
+	HK_TRY(decode(c));
+
+	buffer.resize(decompressedSize);
+
+	return hk::ResultSuccess();
+}
+
+hk::Result decompressFileInPlace(std::vector<u8>& out, const std::filesystem::path& path, u32* alignment) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file) return ResultFileError();
+
+	u8 header[cHeaderSize];
+	if (!file.read(reinterpret_cast<char*>(header), cHeaderSize)) return utils::ResultYaz0InvalidMagic();
+	u32 decompressedSize = HK_TRY(readDecompressedSize(header));
+	if (alignment) *alignment = HK_TRY(readAlignment(header));
+
+	size_t compressedSize = std::filesystem::file_size(path);
+	size_t bufferSize = std::max<size_t>(decompressedSize + decompressedSize / cInPlaceMarginRatio, compressedSize);
+
+	out.clear();
+	out.resize(bufferSize);
+	size_t inOffset = bufferSize - compressedSize;
+	std::memcpy(out.data() + inOffset, header, cHeaderSize);
+	file.read(reinterpret_cast<char*>(out.data() + inOffset + cHeaderSize), compressedSize - cHeaderSize);
+	if (size_t(file.gcount()) != compressedSize - cHeaderSize) return ResultFileError();
+
+	return decompressInPlace(out, inOffset);
+}
+
+hk::Result decompressStream(std::istream& in, const Sink& sink) {
+	u8 header[cHeaderSize];
+	if (!in.read(reinterpret_cast<char*>(header), cHeaderSize)) return utils::ResultYaz0InvalidMagic();
+	const u32 decompressedSize = HK_TRY(readDecompressedSize(header));
+
+	std::vector<u8> input(cStreamChunkSize);
+	size_t inputSize = 0;
+	bool isInputEnd = false;
+
+	// the window is kept at the front of the output buffer, followed by output that hasn't been passed on yet
+	std::vector<u8> output(cWindowSize + cStreamChunkSize + cMaxGroupOut + cOutputSlack);
+	u64 produced = 0;
+	u8* flushed = output.data();
+
+	Cursor c = { .src = input.data(),
+		         .srcEnd = input.data(),
+		         .history = output.data(),
+		         .dst = output.data(),
+		         .dstEnd = output.data() };
+
+	auto refill = [&] {
+		size_t left = c.srcEnd - c.src;
+		std::memmove(input.data(), c.src, left);
+		in.read(reinterpret_cast<char*>(input.data() + left), input.size() - left);
+		inputSize = left + in.gcount();
+		isInputEnd = inputSize < input.size();
+		c.src = input.data();
+		c.srcEnd = input.data() + inputSize;
+	};
+
+	auto flush = [&]() -> hk::Result {
+		produced += c.dst - flushed;
+		if (c.dst != flushed) HK_TRY(sink({ flushed, c.dst }));
+
+		size_t keep = std::min<size_t>(c.dst - output.data(), cWindowSize);
+		std::memmove(output.data(), c.dst - keep, keep);
+		c.dst = output.data() + keep;
+		flushed = c.dst;
+		return hk::ResultSuccess();
+	};
+
+	// as far as the buffer allows, but never past the end of the decompressed data
+	auto getOutputEnd = [&] {
+		u64 remaining = decompressedSize - produced - (c.dst - flushed);
+		return c.dst + std::min<u64>(remaining, output.data() + output.size() - c.dst);
+	};
+
+	// whole groups go through the fast decoder, refilling the input and flushing the output between batches
+	while (true) {
+		if (!isInputEnd && size_t(c.srcEnd - c.src) < cMaxGroupIn + cInputSlack) refill();
+		if (size_t(output.data() + output.size() - c.dst) < cMaxGroupOut + cOutputSlack) HK_TRY(flush());
+
+		c.dstEnd = getOutputEnd();
+		const u8* before = c.src;
+		HK_TRY(decodeFast(c));
+		if (c.src == before) break;
+	}
+
+	// the rest is close to the end of the input or of the output and fits in the buffer after a flush
+	HK_TRY(flush());
+	if (!isInputEnd) refill();
+	c.dstEnd = getOutputEnd();
+	if (produced + (c.dstEnd - c.dst) != decompressedSize) return utils::ResultYaz0Truncated();
+	HK_TRY(decodeChecked(c, false));
+
+	return flush();
+}
+
+hk::Result findGroupBoundaries(std::vector<GroupBoundary>& out, std::span<const u8> in) {
+	u32 decompressedSize = HK_TRY(readDecompressedSize(in));
+
+	out.clear();
+	return walkTokens(in, decompressedSize, [&](u32 pos, u32 inOffset, u32, u32 flagsLeft) {
+		if (flagsLeft == 0) out.push_back({ .outOffset = pos, .inOffset = inOffset });
+	});
+}
+
+hk::Result buildSeekIndex(SeekIndex& out, std::span<const u8> in, std::span<const u8> decompressed, u32 interval) {
+	if (interval == 0) return hk::ResultInvalidArgument();
+
+	u32 decompressedSize = HK_TRY(readDecompressedSize(in));
+	if (decompressedSize != decompressed.size()) return utils::ResultYaz0InvalidSeekIndex();
+
+	out.interval = interval;
+	out.compressedSize = in.size();
+	out.decompressedSize = decompressedSize;
+	out.compressedHash = hash::xxh64(in);
+	out.checkpoints.clear();
+
+	u32 nextCheckpoint = 0;
+	return walkTokens(in, decompressedSize, [&](u32 pos, u32 inOffset, u32 flags, u32 flagsLeft) {
+		if (pos < nextCheckpoint || pos == decompressedSize) return;
+
+		u32 windowStart = pos > cWindowSize ? pos - cWindowSize : 0;
+		out.checkpoints.push_back({ .outOffset = pos,
+		                            .inOffset = inOffset,
+		                            .flags = u8(flags),
+		                            .flagsLeft = u8(flagsLeft),
+		                            .window = { decompressed.begin() + windowStart, decompressed.begin() + pos } });
+		nextCheckpoint = pos - pos % interval + interval;
+	});
+}
+
+hk::Result buildSeekIndex(SeekIndex& out, std::span<const u8> in, u32 interval) {
+	std::vector<u8> decompressed;
+	HK_TRY(decompressFast(decompressed, in));
+
+	return buildSeekIndex(out, in, decompressed, interval);
+}
+
+hk::Result decompressRange(
+	std::vector<u8>& out, std::span<const u8> in, const SeekIndex& index, u32 offset, u32 size
+) {
+	if (in.size() != index.compressedSize || index.checkpoints.empty()) return utils::ResultYaz0InvalidSeekIndex();
+	if (u64(offset) + size > index.decompressedSize) return utils::ResultYaz0RangeOutOfBounds();
+
+	// last checkpoint at or before `offset`
+	auto it = std::upper_bound(
+		index.checkpoints.begin(), index.checkpoints.end(), offset,
+		[](u32 value, const SeekCheckpoint& checkpoint) { return value < checkpoint.outOffset; }
+	);
+	if (it == index.checkpoints.begin()) return utils::ResultYaz0InvalidSeekIndex();
+	const SeekCheckpoint& checkpoint = *(it - 1);
+	if (checkpoint.inOffset > in.size()) return utils::ResultYaz0InvalidSeekIndex();
+
+	// the window goes in front of the decoded range so back-references into it resolve normally
+	const size_t windowSize = checkpoint.window.size();
+	std::vector<u8> buffer(windowSize + (offset + size - checkpoint.outOffset));
+	std::copy(checkpoint.window.begin(), checkpoint.window.end(), buffer.begin());
+
+	Cursor c = { .src = in.data() + checkpoint.inOffset,
+		         .srcEnd = in.data() + in.size(),
+		         .history = buffer.data(),
+		         .dst = buffer.data() + windowSize,
+		         .dstEnd = buffer.data() + buffer.size(),
+		         .flags = checkpoint.flags,
+		         .flagsLeft = checkpoint.flagsLeft };
+	HK_TRY(decode(c));
+
+	out.assign(buffer.begin() + windowSize + (offset - checkpoint.outOffset), buffer.end());
+
+	return hk::ResultSuccess();
+}
+
+Encoder::Encoder(const Sink& sink, u32 decompressedSize, u32 alignment)
+	: mSink(sink), mDecompressedSize(decompressedSize), mBuffer(cWindowSize + cEncodeChunkSize + cMaxMatchLength),
+	  mHashHeads(1 << cHashBits), mHashPrev(cWindowSize) {
+	mOutput.reserve(cStreamChunkSize + cMaxGroupIn);
+	mOutput.resize(cHeaderSize);
+	std::memcpy(mOutput.data(), "Yaz0", 4);
+	bin::write<u32>(mOutput.data() + 4, decompressedSize, util::ByteOrder::Big);
+	bin::write<u32>(mOutput.data() + 8, alignment, util::ByteOrder::Big);
+}
+
+void Encoder::setSeekInterval(u32 interval) {
+	mSeekIndex.interval = interval;
+	mSeekIndex.decompressedSize = mDecompressedSize;
+}
+
+hk::Result Encoder::write(std::span<const u8> data) {
+	return append(data, InputMode::Encode);
+}
+
+hk::ValueOrResult<bool> Encoder::syncTo(std::span<const u8> data, std::span<const u32> boundaries) {
+	if (data.size() > cMaxSyncSize) return utils::ResultInvalidArgument();
+	HK_TRY(append(data, InputMode::Hold));
+	// tokens are chosen afresh below
+	mHasPendingMatch = false;
+
+	const u32 start = mPos;
+	const u32 size = mBufferEnd - start;
+	auto boundary = std::lower_bound(boundaries.begin(), boundaries.end(), start);
+
+	// fewest tokens reaching each position with each number of tokens into the group, and the length of the last one.
+	// any match can also be cut short, which together with literals gives enough freedom to land on most boundaries
+	constexpr u32 cUnreachable = ~0u;
+	std::vector<u32> costs((size + 1) * 8, cUnreachable);
+	std::vector<u16> lengths((size + 1) * 8, 0);
+	std::vector<Match> matches(size);
+	costs[mGroupTokens] = 0;
+
+	u32 end = 0;
+	for (u32 i = 0;; i++) {
+		while (boundary != boundaries.end() && *boundary < start + i)
+			boundary++;
+		if (boundary == boundaries.end()) return false;
+		if (*boundary == start + i && costs[i * 8] != cUnreachable) {
+			end = i;
+			break;
+		}
+		if (i == size) return false;
+
+		matches[i] = findMatch(start + i);
+		for (u32 tokens = 0; tokens < 8; tokens++) {
+			const u32 cost = costs[i * 8 + tokens];
+			if (cost == cUnreachable) continue;
+
+			auto reach = [&](u32 length) {
+				const u32 to = (i + length) * 8 + (tokens + 1) % 8;
+				if (cost + 1 >= costs[to]) return;
+				costs[to] = cost + 1;
+				lengths[to] = length;
+			};
+			reach(1);
+			for (u32 length = cMinMatchLength; length <= matches[i].length; length++)
+				reach(length);
+		}
+	}
+
+	std::vector<u32> path;
+	for (u32 i = end, tokens = 0; i != 0; tokens = (tokens + 7) % 8) {
+		const u32 length = lengths[i * 8 + tokens];
+		path.push_back(length);
+		i -= length;
+	}
+
+	for (auto it = path.rbegin(); it != path.rend(); it++) {
+		beginToken();
+		if (*it == 1)
+			emitLiteral(*at(mPos));
+		else
+			emitMatch({ .length = *it, .distance = matches[mPos - start].distance });
+		mPos += *it;
+
+		if (mGroupTokens == 8) HK_TRY(flushGroup());
+	}
+
+	mBufferEnd = mPos;
+	return true;
+}
+
+hk::Result Encoder::writeTokens(std::span<const u8> tokens, std::span<const u8> decoded) {
+	if (mPos != mBufferEnd || mGroupTokens != 0) return utils::ResultInvalidArgument();
+	mHasPendingMatch = false;
+
+	if (!mOutput.empty()) HK_TRY(mSink(mOutput));
+	mOutputFlushed += mOutput.size();
+	mOutput.clear();
+
+	if (!tokens.empty()) HK_TRY(mSink(tokens));
+	mOutputFlushed += tokens.size();
+
+	return append(decoded, InputMode::Encoded);
+}
+
+hk::Result Encoder::append(std::span<const u8> data, InputMode mode) {
+	if (u64(mBufferEnd) + data.size() > mDecompressedSize) return utils::ResultInvalidArgument();
+
+	while (!data.empty()) {
+		if (mBufferEnd - mBufferStart == mBuffer.size()) {
+			// only the window behind the next position is still needed
+			u32 keepFrom = mPos > cWindowSize ? mPos - cWindowSize : 0;
+			std::memmove(mBuffer.data(), at(keepFrom), mBufferEnd - keepFrom);
+			mBufferStart = keepFrom;
+			mNextInsert = std::max(mNextInsert, keepFrom);
+		}
+
+		size_t size = std::min(data.size(), mBuffer.size() - (mBufferEnd - mBufferStart));
+		std::memcpy(mBuffer.data() + (mBufferEnd - mBufferStart), data.data(), size);
+		mBufferEnd += size;
+		data = data.subspan(size);
+
+		if (mode == InputMode::Encode) HK_TRY(encode(false));
+		if (mode == InputMode::Encoded) mPos = mBufferEnd;
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::finish() {
+	if (mBufferEnd != mDecompressedSize) return utils::ResultInvalidArgument();
+
+	HK_TRY(encode(true));
+	if (mGroupTokens != 0) HK_TRY(flushGroup());
+
+	if (!mOutput.empty()) HK_TRY(mSink(mOutput));
+	mOutputFlushed += mOutput.size();
+	mOutput.clear();
+
+	mSeekIndex.compressedSize = mOutputFlushed;
+
+	return hk::ResultSuccess();
+}
+
+hk::Result Encoder::encode(bool isFinal) {
+	while (mPos < mBufferEnd) {
+		// until the end, keep a full match length of lookahead past the next two positions, so the output doesn't
+		// depend on how the input was split up
+		if (!isFinal && mBufferEnd - mPos <= cMaxMatchLength) break;
+
+		beginToken();
+
+		Match match = mHasPendingMatch ? mPendingMatch : findMatch(mPos);
+		mHasPendingMatch = false;
+
+		// a literal followed by a longer match beats a short match now
+		if (match.length >= cMinMatchLength && match.length < cLazyMatchLength && mPos + 1 < mBufferEnd) {
+			Match next = findMatch(mPos + 1);
+			if (next.length > match.length + 1) {
+				mPendingMatch = next;
+				mHasPendingMatch = true;
+				match.length = 0;
+			}
+		}
+
+		if (match.length >= cMinMatchLength) {
+			emitMatch(match);
+			mPos += match.length;
+		} else {
+			emitLiteral(*at(mPos));
+			mPos++;
+		}
+
+		if (mGroupTokens == 8) HK_TRY(flushGroup());
+	}
+
+	return hk::ResultSuccess();
+}
+
+void Encoder::insertUpTo(u32 pos) {
+	for (; mNextInsert < pos && mNextInsert + cMinMatchLength <= mBufferEnd; mNextInsert++) {
+		u32 hash = hashPrefix(at(mNextInsert));
+		mHashPrev[mNextInsert % cWindowSize] = mHashHeads[hash];
+		mHashHeads[hash] = mNextInsert + 1;
+	}
+}
+
+Encoder::Match Encoder::findMatch(u32 pos) {
+	insertUpTo(pos);
+
+	Match best;
+	const u32 maxLength = std::min<u32>(cMaxMatchLength, mBufferEnd - pos);
+	if (maxLength < cMinMatchLength) return best;
+
+	const u8* cur = at(pos);
+	u32 candidate = mHashHeads[hashPrefix(cur)];
+
+	for (u32 i = 0; i < cMaxChainLength && candidate != 0; i++) {
+		const u32 candidatePos = candidate - 1;
+		// chain entries past the window may have been reused by later positions
+		if (pos - candidatePos > cWindowSize) break;
+
+		const u8* ref = at(candidatePos);
+		if (ref[best.length] == cur[best.length]) {
+			u32 length = 0;
+			while (length < maxLength && ref[length] == cur[length])
+				length++;
+
+			if (length > best.length) {
+				best = { .length = length, .distance = pos - candidatePos };
+				if (length == maxLength) break;
+			}
+		}
+
+		candidate = mHashPrev[candidatePos % cWindowSize];
+	}
+
+	return best;
+}
+
+void Encoder::beginToken() {
+	if (mGroupTokens != 0) return;
+
+	// group boundaries are where a seek checkpoint needs the least state
+	if (mSeekIndex.interval != 0 && mPos >= mNextCheckpoint) {
+		u32 windowStart = mPos > cWindowSize ? mPos - cWindowSize : 0;
+		mSeekIndex.checkpoints.push_back({ .outOffset = mPos,
+		                                   .inOffset = u32(mOutputFlushed + mOutput.size()),
+		                                   .flags = 0,
+		                                   .flagsLeft = 0,
+		                                   .window = { at(windowStart), at(mPos) } });
+		mNextCheckpoint = mPos - mPos % mSeekIndex.interval + mSeekIndex.interval;
+	}
+
+	mGroup[0] = 0;
+	mGroupSize = 1;
+}
+
+void Encoder::emitLiteral(u8 value) {
+	mGroup[0] |= 0x80 >> mGroupTokens;
+	mGroup[mGroupSize++] = value;
+	mGroupTokens++;
+}
+
+void Encoder::emitMatch(const Match& match) {
+	u32 distance = match.distance - 1;
+	if (match.length <= cMaxShortMatchLength) {
+		mGroup[mGroupSize++] = (match.length - 2) << 4 | distance >> 8;
+		mGroup[mGroupSize++] = distance & 0xff;
+	} else {
+		mGroup[mGroupSize++] = distance >> 8;
+		mGroup[mGroupSize++] = distance & 0xff;
+		mGroup[mGroupSize++] = match.length - 0x12;
+	}
+	mGroupTokens++;
+}
+
+hk::Result Encoder::flushGroup() {
+	mOutput.insert(mOutput.end(), mGroup, mGroup + mGroupSize);
+	mGroupTokens = 0;
+
+	if (mOutput.size() >= cStreamChunkSize) {
+		HK_TRY(mSink(mOutput));
+		mOutputFlushed += mOutput.size();
+		mOutput.clear();
+	}
+
+	return hk::ResultSuccess();
+}
+
+void writeSeekIndex(std::vector<u8>& out, const SeekIndex& index) {
+	size_t size = cSeekIndexHeaderSize;
+	for (const SeekCheckpoint& checkpoint : index.checkpoints)
+		size += cSeekCheckpointHeaderSize + checkpoint.window.size();
+
+	out.resize(size);
+	u8* p = out.data();
+
+	std::memcpy(p, "Y0SI", 4);
+	bin::write<u32>(p + 0x4, cSeekIndexVersion, util::ByteOrder::Little);
+	bin::write<u32>(p + 0x8, index.interval, util::ByteOrder::Little);
+	bin::write<u32>(p + 0xc, index.compressedSize, util::ByteOrder::Little);
+	bin::write<u32>(p + 0x10, index.decompressedSize, util::ByteOrder::Little);
+	bin::write<u32>(p + 0x14, index.checkpoints.size(), util::ByteOrder::Little);
+	bin::write<u64>(p + 0x18, index.compressedHash, util::ByteOrder::Little);
+	p += cSeekIndexHeaderSize;
+
+	for (const SeekCheckpoint& checkpoint : index.checkpoints) {
+		bin::write<u32>(p + 0x0, checkpoint.outOffset, util::ByteOrder::Little);
+		bin::write<u32>(p + 0x4, checkpoint.inOffset, util::ByteOrder::Little);
+		p[0x8] = checkpoint.flags;
+		p[0x9] = checkpoint.flagsLeft;
+		bin::write<u16>(p + 0xa, checkpoint.window.size(), util::ByteOrder::Little);
+		std::copy(checkpoint.window.begin(), checkpoint.window.end(), p + cSeekCheckpointHeaderSize);
+		p += cSeekCheckpointHeaderSize + checkpoint.window.size();
+	}
+}
+
+hk::Result readSeekIndex(SeekIndex& out, std::span<const u8> data) {
+	if (data.size() < cSeekIndexHeaderSize || std::memcmp(data.data(), "Y0SI", 4) != 0 ||
+	    bin::readLE<u32>(data.data() + 4) != cSeekIndexVersion)
+		return utils::ResultYaz0InvalidSeekIndex();
+
+	out.interval = bin::readLE<u32>(data.data() + 0x8);
+	out.compressedSize = bin::readLE<u32>(data.data() + 0xc);
+	out.decompressedSize = bin::readLE<u32>(data.data() + 0x10);
+	u32 count = bin::readLE<u32>(data.data() + 0x14);
+	out.compressedHash = bin::readLE<u64>(data.data() + 0x18);
+
+	out.checkpoints.clear();
+	size_t pos = cSeekIndexHeaderSize;
+	for (u32 i = 0; i < count; i++) {
+		if (data.size() - pos < cSeekCheckpointHeaderSize) return utils::ResultYaz0InvalidSeekIndex();
+		const u8* p = data.data() + pos;
+
+		SeekCheckpoint checkpoint;
+		checkpoint.outOffset = bin::readLE<u32>(p + 0x0);
+		checkpoint.inOffset = bin::readLE<u32>(p + 0x4);
+		checkpoint.flags = p[0x8];
+		checkpoint.flagsLeft = p[0x9];
+		u16 windowSize = bin::readLE<u16>(p + 0xa);
+		pos += cSeekCheckpointHeaderSize;
+
+		if (windowSize > cWindowSize || windowSize > checkpoint.outOffset || checkpoint.flagsLeft > 8 ||
+		    data.size() - pos < windowSize)
+			return utils::ResultYaz0InvalidSeekIndex();
+
+		// `decompressRange` searches the checkpoints by output offset and decodes from them up to the range it's asked
+		// for, so they have to be in order and within the stream
+		if (checkpoint.outOffset > out.decompressedSize || checkpoint.inOffset > out.compressedSize ||
+		    (!out.checkpoints.empty() && checkpoint.outOffset <= out.checkpoints.back().outOffset))
+			return utils::ResultYaz0InvalidSeekIndex();
+
+		checkpoint.window.assign(data.begin() + pos, data.begin() + pos + windowSize);
+		pos += windowSize;
+		out.checkpoints.push_back(std::move(checkpoint));
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace yaz0
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <istream>
+#include <span>
+#include <vector>
+
+#include "stream.h"
+
+namespace yaz0 {
+
+constexpr size_t cHeaderSize = 0x10;
+// the furthest back a back-reference can reach
+constexpr size_t cWindowSize = 0x1000;
+// most input Encoder::syncTo takes at once
+constexpr size_t cMaxSyncSize = 0x4000;
+
+hk::ValueOrResult<u32> readDecompressedSize(std::span<const u8> in);
+// the alignment field of the header, which SZS archives set to the alignment of their files
+hk::ValueOrResult<u32> readAlignment(std::span<const u8> in);
+
+// decodes a full Yaz0 stream (including header) into `out`, which must be exactly the decompressed size.
+// groups that fit well inside both buffers are decoded without per-byte bounds checks using wide copies;
+// the last few groups fall back to a checked decoder
+hk::Result decompressInto(std::span<u8> out, std::span<const u8> in);
+
+// drop-in replacement for yaz0::decompress built on decompressInto
+hk::Result decompressFast(std::vector<u8>& out, std::span<const u8> in);
+
+// `buffer[inOffset, end)` holds a Yaz0 stream, which is decoded forward into the start of the same buffer. this only
+// happens if a scan of the tokens shows the output never reaches input that is still unread; otherwise the input is
+// copied out and decoded with two buffers. `buffer` ends up holding exactly the decompressed data
+hk::Result decompressInPlace(std::vector<u8>& buffer, size_t inOffset);
+
+// reads a Yaz0 file into the tail of a single allocation slightly larger than the output and decodes it in place.
+// `alignment`, if given, gets the one from the header
+hk::Result decompressFileInPlace(std::vector<u8>& out, const std::filesystem::path& path, u32* alignment = nullptr);
+
+// decodes a Yaz0 stream read from `in`, passing the output to `sink` as it is produced. only the back-reference window,
+// an output chunk and an input chunk are kept in memory, regardless of the size of the data
+hk::Result decompressStream(std::istream& in, const Sink& sink);
+
+// decoder state at a token boundary, along with the output that back-references from there can reach
+struct SeekCheckpoint {
+	u32 outOffset;
+	u32 inOffset;
+	u8 flags;     // unread flag bits of the current group, most significant first
+	u8 flagsLeft; // 0 when the next byte is a new group's flag byte
+	std::vector<u8> window;
+};
+
+// a position in the token stream where a new group starts
+struct GroupBoundary {
+	u32 outOffset;
+	u32 inOffset;
+};
+
+// every group boundary in `in`, including the end of the stream if the last group is full. a stream can be cut at any
+// of them and continued by a different encoder, since nothing before the cut depends on what comes after it
+hk::Result findGroupBoundaries(std::vector<GroupBoundary>& out, std::span<const u8> in);
+
+// checkpoints roughly every `interval` bytes of output, so ranges can be decoded without starting from the beginning
+struct SeekIndex {
+	u32 interval = 0;
+	u32 compressedSize = 0;
+	u32 decompressedSize = 0;
+	// XXH64 of the compressed stream, since a rewritten archive can easily have the same size
+	u64 compressedHash = 0;
+	std::vector<SeekCheckpoint> checkpoints;
+};
+
+// walks the token stream of `in`, taking windows from its already decompressed contents
+hk::Result buildSeekIndex(SeekIndex& out, std::span<const u8> in, std::span<const u8> decompressed, u32 interval);
+hk::Result buildSeekIndex(SeekIndex& out, std::span<const u8> in, u32 interval);
+
+// decodes only [offset, offset + size) of the output, starting from the closest checkpoint before it
+hk::Result decompressRange(
+	std::vector<u8>& out, std::span<const u8> in, const SeekIndex& index, u32 offset, u32 size
+);
+
+// compresses data that arrives in pieces, passing finished groups on to a sink as it goes. only the window, a chunk
+// of lookahead and a chunk of output are held at a time, whatever the size of the data
+class Encoder {
+public:
+	// the decompressed size is part of the header, so it has to be known before any data
+	Encoder(const Sink& sink, u32 decompressedSize, u32 alignment);
+
+	// also records a seek index, with checkpoints on group boundaries roughly every `interval` bytes of output. must be
+	// called before any data is written
+	void setSeekInterval(u32 interval);
+
+	hk::Result write(std::span<const u8> data);
+
+	// takes `data` as further input and encodes everything up to the first of `boundaries` (ascending input positions)
+	// that tokens can be arranged to end a group exactly on, then returns true. input past that boundary is dropped and
+	// has to be given again, unchanged. if no boundary within `data` works, nothing is encoded and the input is kept
+	// for later writes
+	hk::ValueOrResult<bool> syncTo(std::span<const u8> data, std::span<const u32> boundaries);
+
+	// continues with groups copied verbatim from another stream, which decode to `decoded`. all input so far must be
+	// encoded up to a group boundary, and back-references in `tokens` are trusted to resolve to the same data. no seek
+	// checkpoints are recorded inside them
+	hk::Result writeTokens(std::span<const u8> tokens, std::span<const u8> decoded);
+
+	// encodes the rest of the data and flushes the output. fails unless exactly the promised size was written
+	hk::Result finish();
+
+	// input position encoding has reached
+	u32 getPosition() const { return mPos; }
+
+	// complete once `finish` has succeeded, apart from `compressedHash`: the output has gone to the sink by then, so
+	// that is left to whoever has it
+	const SeekIndex& getSeekIndex() const { return mSeekIndex; }
+
+private:
+	struct Match {
+		u32 length = 0;
+		u32 distance = 0;
+	};
+
+	enum class InputMode {
+		Encode,
+		Hold,    // buffered without encoding yet
+		Encoded, // already covered by copied tokens
+	};
+
+	hk::Result append(std::span<const u8> data, InputMode mode);
+	hk::Result encode(bool isFinal);
+	void insertUpTo(u32 pos);
+	Match findMatch(u32 pos);
+	void beginToken();
+	void emitLiteral(u8 value);
+	void emitMatch(const Match& match);
+	hk::Result flushGroup();
+
+	const u8* at(u32 pos) const { return mBuffer.data() + (pos - mBufferStart); }
+
+	Sink mSink;
+	u32 mDecompressedSize;
+
+	std::vector<u8> mBuffer;
+	u32 mBufferStart = 0; // input position of mBuffer[0]
+	u32 mBufferEnd = 0;   // input position just past the last byte received
+	u32 mPos = 0;         // next input position to encode
+	u32 mNextInsert = 0;  // first position not yet added to the hash chains
+
+	std::vector<u32> mHashHeads; // latest position + 1 with each hash, or 0
+	std::vector<u32> mHashPrev;  // previous position + 1 with the same hash, indexed by position within the window
+
+	Match mPendingMatch; // found for mPos while deciding on a literal at the position before it
+	bool mHasPendingMatch = false;
+
+	u8 mGroup[1 + 8 * 3];
+	u32 mGroupSize = 0;
+	u32 mGroupTokens = 0;
+
+	std::vector<u8> mOutput;
+	u32 mOutputFlushed = 0;
+
+	SeekIndex mSeekIndex;
+	u32 mNextCheckpoint = 0;
+};
+
+void writeSeekIndex(std::vector<u8>& out, const SeekIndex& index);
+hk::Result readSeekIndex(SeekIndex& out, std::span<const u8> data);
+
+} // namespace yaz0
@@ -0,0 +1,310 @@
+#include "zs.h"
+
+#include <fstream>
+
+#include "binary.h"
+#include "mizuna/results.h"
+#include "mizuna/util.h"
+#include "results.h"
+#include "sarc.h"
+
+namespace zs {
+
+namespace {
+
+// don't trust frame headers asking for more than this up front
+constexpr u64 cMaxSizeHint = 0x40000000;
+
+// ZSTD_FRAMEHEADERSIZE_MAX, which zstd only defines for static linking
+constexpr size_t cMaxFrameHeaderSize = 18;
+
+constexpr std::string_view cDictionarySuffix = ".zsdic";
+constexpr std::string_view cFallbackDictionary = "zs";
+
+using DCtxPtr = std::unique_ptr<ZSTD_DCtx, decltype(&ZSTD_freeDCtx)>;
+using CCtxPtr = std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)>;
+
+// contexts are kept per thread and reused for every file, so a batch doesn't allocate them over and over
+ZSTD_DCtx* getDCtx() {
+	thread_local DCtxPtr dctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+	if (dctx) ZSTD_DCtx_reset(dctx.get(), ZSTD_reset_session_and_parameters);
+	return dctx.get();
+}
+
+ZSTD_CCtx* getCCtx() {
+	thread_local CCtxPtr cctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+	if (cctx) ZSTD_CCtx_reset(cctx.get(), ZSTD_reset_session_and_parameters);
+	return cctx.get();
+}
+
+bool isZstdFrame(std::span<const u8> data) {
+	return data.size() >= 4 && bin::readLE<u32>(data.data()) == ZSTD_MAGICNUMBER;
+}
+
+// points the decoder at the dictionary the frame starting at `frame` was compressed with. called for every frame, since
+// the decoder would otherwise keep using the previous frame's dictionary for one that doesn't name any
+hk::Result refDictionary(ZSTD_DCtx* dctx, const DictionarySet* dictionaries, std::span<const u8> frame) {
+	// 0 also comes back for frames without a dictionary, or when the header isn't all there yet
+	u32 id = ZSTD_getDictID_fromFrame(frame.data(), frame.size());
+	const ZSTD_DDict* ddict = dictionaries ? dictionaries->findDDict(id) : nullptr;
+	if (!ddict && id != 0) return utils::ResultZstdDictionaryNotFound();
+
+	// a null DDict goes back to decoding without a dictionary
+	if (ZSTD_isError(ZSTD_DCtx_refDDict(dctx, ddict))) return utils::ResultZstdError();
+
+	return hk::ResultSuccess();
+}
+
+// feeds one chunk of input to the decoder. `lastRet` ends up 0 exactly when the chunk ended on a frame boundary. the
+// dictionary a frame needs is named in its header, which can straddle two chunks, so unless `isFinal`, a frame that
+// starts too close to the end of the chunk for its whole header to fit is left in `heldBack` and decoded with the next
+hk::Result decompressChunk(
+	ZSTD_DCtx* dctx, std::span<const u8> chunk, bool isFinal, std::vector<u8>& heldBack, std::vector<u8>& output,
+	const Sink& sink, size_t& lastRet, const DictionarySet* dictionaries
+) {
+	// only ever a header's worth is held back, and only when a frame ends near the end of a chunk
+	std::vector<u8> joined;
+	if (!heldBack.empty()) {
+		joined = std::move(heldBack);
+		heldBack.clear();
+		joined.insert(joined.end(), chunk.begin(), chunk.end());
+		chunk = joined;
+	}
+
+	ZSTD_inBuffer input = { chunk.data(), chunk.size(), 0 };
+	while (input.pos < input.size) {
+		if (lastRet == 0) {
+			const std::span<const u8> frame = chunk.subspan(input.pos);
+			if (frame.size() < cMaxFrameHeaderSize && !isFinal) {
+				heldBack.assign(frame.begin(), frame.end());
+				return hk::ResultSuccess();
+			}
+
+			HK_TRY(refDictionary(dctx, dictionaries, frame));
+		}
+
+		ZSTD_outBuffer outBuf = { output.data(), output.size(), 0 };
+		size_t ret = ZSTD_decompressStream(dctx, &outBuf, &input);
+		if (ZSTD_isError(ret)) return utils::ResultZstdError();
+
+		if (outBuf.pos != 0) HK_TRY(sink({ output.data(), outBuf.pos }));
+		lastRet = ret;
+	}
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result DictionarySet::load(const std::filesystem::path& path) {
+	std::vector<u8> contents;
+	HK_TRY(util::readFile(contents, path));
+
+	if (isZstdFrame(contents)) {
+		std::vector<u8> decompressed;
+		HK_TRY(decompress(decompressed, contents));
+		contents = std::move(decompressed);
+	}
+
+	if (contents.size() < 4 || std::memcmp(contents.data(), "SARC", 4) != 0)
+		return add(path.filename().string(), contents);
+
+	sarc::EntryTable pack;
+	HK_TRY(pack.init(contents));
+
+	size_t numAdded = 0;
+	for (const sarc::EntryInfo& entry : pack.getEntries()) {
+		std::string_view name = pack.getName(entry);
+		if (!name.ends_with(cDictionarySuffix)) continue;
+		if (entry.start > entry.end || entry.end > contents.size()) return utils::ResultSarcInvalidHeader();
+
+		HK_TRY(add(std::string(name), std::span(contents).subspan(entry.start, entry.end - entry.start)));
+		numAdded++;
+	}
+
+	if (numAdded == 0) return utils::ResultZstdDictionaryNotFound();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result DictionarySet::add(const std::string& name, std::span<const u8> data) {
+	// raw content dictionaries have no id, and are used for frames that don't name one
+	u32 id = ZSTD_getDictID_fromDict(data.data(), data.size());
+
+	auto dictionary = std::make_unique<Dictionary>(Dictionary {
+		.name = name,
+		.id = id,
+		.data = std::vector<u8>(data.begin(), data.end()),
+		.ddict = { ZSTD_createDDict(data.data(), data.size()), ZSTD_freeDDict },
+		.cdicts = {},
+	});
+	if (!dictionary->ddict) return utils::ResultZstdError();
+
+	mDictionaries.push_back(std::move(dictionary));
+	return hk::ResultSuccess();
+}
+
+const ZSTD_DDict* DictionarySet::findDDict(u32 id) const {
+	for (const auto& dictionary : mDictionaries)
+		if (dictionary->id == id) return dictionary->ddict.get();
+
+	return nullptr;
+}
+
+const ZSTD_CDict* DictionarySet::findCDict(const std::string& filename, s32 level) {
+	std::string_view stem = filename;
+	if (stem.ends_with(".zs")) stem.remove_suffix(3);
+
+	// the longest matching suffix wins, so `bcett.byml.zsdic` beats `byml.zsdic`
+	Dictionary* best = nullptr;
+	size_t bestLength = 0;
+	for (const auto& dictionary : mDictionaries) {
+		std::string_view suffix = dictionary->name;
+		if (!suffix.ends_with(cDictionarySuffix)) continue;
+		suffix.remove_suffix(cDictionarySuffix.size());
+
+		bool isMatch =
+			stem.size() > suffix.size() && stem.ends_with(suffix) && stem[stem.size() - suffix.size() - 1] == '.';
+		if (isMatch && suffix.size() > bestLength) {
+			best = dictionary.get();
+			bestLength = suffix.size();
+		}
+
+		if (!best && suffix == cFallbackDictionary) best = dictionary.get();
+	}
+
+	if (!best && mDictionaries.size() == 1) best = mDictionaries[0].get();
+	if (!best) return nullptr;
+
+	std::lock_guard lock(mCDictMutex);
+	auto it = best->cdicts.find(level);
+	if (it == best->cdicts.end()) {
+		ZSTD_CDict* cdict = ZSTD_createCDict(best->data.data(), best->data.size(), level);
+		if (!cdict) return nullptr;
+		it = best->cdicts.emplace(level, std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)>(cdict, ZSTD_freeCDict))
+		         .first;
+	}
+
+	return it->second.get();
+}
+
+hk::Result decompressStream(std::istream& in, const Sink& sink, const DictionarySet* dictionaries) {
+	ZSTD_DCtx* dctx = getDCtx();
+	if (!dctx) return utils::ResultZstdError();
+
+	std::vector<u8> input(ZSTD_DStreamInSize());
+	std::vector<u8> output(ZSTD_DStreamOutSize());
+	std::vector<u8> heldBack;
+	size_t lastRet = 0;
+
+	while (in) {
+		in.read(reinterpret_cast<char*>(input.data()), input.size());
+		// a short read means the end of the input, so nothing more is coming to complete a held back header
+		const std::span<const u8> chunk(input.data(), in.gcount());
+		HK_TRY(decompressChunk(dctx, chunk, !in, heldBack, output, sink, lastRet, dictionaries));
+	}
+
+	if (lastRet != 0) return utils::ResultZstdTruncated();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result decompress(std::vector<u8>& out, std::span<const u8> in, const DictionarySet* dictionaries) {
+	ZSTD_DCtx* dctx = getDCtx();
+	if (!dctx) return utils::ResultZstdError();
+
+	out.clear();
+	u64 sizeHint = ZSTD_getFrameContentSize(in.data(), in.size());
+	if (sizeHint != ZSTD_CONTENTSIZE_UNKNOWN && sizeHint != ZSTD_CONTENTSIZE_ERROR && sizeHint <= cMaxSizeHint)
+		out.reserve(sizeHint);
+
+	std::vector<u8> output(ZSTD_DStreamOutSize());
+	std::vector<u8> heldBack;
+	size_t lastRet = 0;
+	HK_TRY(decompressChunk(dctx, in, true, heldBack, output, makeVectorSink(out), lastRet, dictionaries));
+
+	if (lastRet != 0) return utils::ResultZstdTruncated();
+
+	return hk::ResultSuccess();
+}
+
+hk::Result decompressFile(std::vector<u8>& out, const std::filesystem::path& path, const DictionarySet* dictionaries) {
+	std::ifstream file(path, std::ios::in | std::ios::binary);
+	if (!file) return ResultFileError();
+
+	out.clear();
+	return decompressStream(file, makeVectorSink(out), dictionaries);
+}
+
+namespace {
+
+// the thread's compression context, set up for `options`
+hk::ValueOrResult<ZSTD_CCtx*> setUpCCtx(const CompressOptions& options) {
+	ZSTD_CCtx* cctx = getCCtx();
+	if (!cctx) return utils::ResultZstdError();
+
+	if (ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, options.level)) ||
+	    ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1)))
+		return hk::ResultInvalidArgument();
+
+	if (options.dictionary && ZSTD_isError(ZSTD_CCtx_refCDict(cctx, options.dictionary)))
+		return utils::ResultZstdError();
+
+	if (options.numWorkers != 0 && ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, options.numWorkers)))
+		fprintf(stderr, "warning: zstd was built without multithreading, compressing on one thread\n");
+
+	if (options.pledgedSize != u64(-1)) ZSTD_CCtx_setPledgedSrcSize(cctx, options.pledgedSize);
+
+	return cctx;
+}
+
+// feeds one chunk of input to the encoder, passing whatever it produces to `sink`
+hk::Result compressChunk(
+	ZSTD_CCtx* cctx, std::span<const u8> chunk, bool isLastChunk, std::vector<u8>& output, const Sink& sink
+) {
+	const ZSTD_EndDirective mode = isLastChunk ? ZSTD_e_end : ZSTD_e_continue;
+	ZSTD_inBuffer inBuf = { chunk.data(), chunk.size(), 0 };
+
+	// with ZSTD_e_end, keep going until the frame is fully flushed; otherwise until the input is consumed
+	bool isFinished;
+	do {
+		ZSTD_outBuffer outBuf = { output.data(), output.size(), 0 };
+		size_t remaining = ZSTD_compressStream2(cctx, &outBuf, &inBuf, mode);
+		if (ZSTD_isError(remaining)) return utils::ResultZstdError();
+
+		if (outBuf.pos != 0) HK_TRY(sink({ output.data(), outBuf.pos }));
+		isFinished = isLastChunk ? remaining == 0 : inBuf.pos == inBuf.size;
+	} while (!isFinished);
+
+	return hk::ResultSuccess();
+}
+
+} // namespace
+
+hk::Result compressStream(std::istream& in, const Sink& sink, const CompressOptions& options) {
+	ZSTD_CCtx* cctx = HK_TRY(setUpCCtx(options));
+
+	std::vector<u8> input(ZSTD_CStreamInSize());
+	std::vector<u8> output(ZSTD_CStreamOutSize());
+
+	bool isLastChunk = false;
+	while (!isLastChunk) {
+		in.read(reinterpret_cast<char*>(input.data()), input.size());
+		size_t readSize = in.gcount();
+		isLastChunk = readSize < input.size();
+		if (!isLastChunk && in.peek() == std::istream::traits_type::eof()) isLastChunk = true;
+
+		HK_TRY(compressChunk(cctx, { input.data(), readSize }, isLastChunk, output, sink));
+	}
+
+	return hk::ResultSuccess();
+}
+
+hk::Result compress(std::span<const u8> in, const Sink& sink, const CompressOptions& options) {
+	ZSTD_CCtx* cctx = HK_TRY(setUpCCtx(options));
+
+	std::vector<u8> output(ZSTD_CStreamOutSize());
+	return compressChunk(cctx, in, true, output, sink);
+}
+
+} // namespace zs
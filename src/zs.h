@@ -0,0 +1,78 @@
+#pragma once
+
+#include <filesystem>
+#include <hk/ValueOrResult.h>
+#include <istream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+#include <zstd/zstd.h>
+
+#include "stream.h"
+
+namespace zs {
+
+constexpr s32 cDefaultLevel = 19;
+
+// dictionaries are digested once when loaded and then shared by every file (and thread) using them
+class DictionarySet {
+public:
+	// `path` is either a single dictionary (zstd format or raw content) or a pack: a SARC of `*.zsdic` files, which
+	// may itself be zstd-compressed
+	hk::Result load(const std::filesystem::path& path);
+
+	bool isEmpty() const { return mDictionaries.empty(); }
+
+	// the dictionary a frame was compressed with, by the id in its header. nullptr if it isn't loaded
+	const ZSTD_DDict* findDDict(u32 id) const;
+
+	// the dictionary to compress `filename` with: `<suffix>.zsdic` is used for files ending in `<suffix>.zs`, with
+	// `zs.zsdic` (or a lone dictionary) as the fallback. nullptr if nothing matches. safe to call from several threads
+	const ZSTD_CDict* findCDict(const std::string& filename, s32 level);
+
+private:
+	struct Dictionary {
+		std::string name;
+		u32 id;
+		std::vector<u8> data;
+		std::unique_ptr<ZSTD_DDict, decltype(&ZSTD_freeDDict)> ddict;
+		// built on first use, since a CDict is tied to one compression level and is expensive to make
+		std::map<s32, std::unique_ptr<ZSTD_CDict, decltype(&ZSTD_freeCDict)>> cdicts;
+	};
+
+	hk::Result add(const std::string& name, std::span<const u8> data);
+
+	std::vector<std::unique_ptr<Dictionary>> mDictionaries;
+	std::mutex mCDictMutex;
+};
+
+struct CompressOptions {
+	s32 level = cDefaultLevel;
+	u32 numWorkers = 0; // 0 compresses on the calling thread
+	// written to the frame header when known, since some readers rely on it
+	u64 pledgedSize = u64(-1);
+	const ZSTD_CDict* dictionary = nullptr; // overrides `level` with the level the dictionary was built for
+};
+
+// decodes every zstd frame read from `in`, passing the output to `sink` one block at a time. memory use is bounded by
+// the zstd window, independent of the size of the data. frames that reference a dictionary are decoded with the
+// matching one from `dictionaries`
+hk::Result decompressStream(std::istream& in, const Sink& sink, const DictionarySet* dictionaries = nullptr);
+
+// decodes `in` into `out`. the frame content size is only used as a size hint, so frames without one (or with a bogus
+// one) still decode
+hk::Result decompress(std::vector<u8>& out, std::span<const u8> in, const DictionarySet* dictionaries = nullptr);
+
+hk::Result decompressFile(
+	std::vector<u8>& out, const std::filesystem::path& path, const DictionarySet* dictionaries = nullptr
+);
+
+hk::Result compressStream(std::istream& in, const Sink& sink, const CompressOptions& options);
+
+// the same for data that is already in memory, which is compressed straight from `in`
+hk::Result compress(std::span<const u8> in, const Sink& sink, const CompressOptions& options);
+
+} // namespace zs